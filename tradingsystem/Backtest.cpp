@@ -0,0 +1,343 @@
+/**
+ * Backtest.cpp
+ * Defines a backtesting harness replaying recorded data through the algo execution and algo streaming strategies.
+ *
+ * @author Jordan Wang
+ */
+
+#include "Backtest.hpp"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+using namespace std;
+
+
+
+
+template<typename T>
+Backtest<T>::Backtest(const BacktestParameters& _parameters)
+{
+	parameters = _parameters;
+	result = BacktestResult{ 0, 0, 0, 0, 0.0, 0.0, 0, 0, 0, 0.0, 0.0 };
+	nextFeedOrderId = 0;
+	quoteSequence = 0;
+	algoExecutionService.SetMinSpread(parameters.minSpread);
+	algoExecutionService.SetAlternationPeriod(parameters.alternationPeriod);
+	algoStreamingService.SetQuoteSizes(parameters.visibleQuantities[0], parameters.visibleQuantities[1], parameters.hiddenRatio);
+
+	// The book is recorded before the execution algo decides on it
+	marketDataListener.reset(new BacktestToMarketDataListener<T>(this));
+	executionListener.reset(new BacktestToAlgoExecutionListener<T>(this));
+	streamingListener.reset(new BacktestToAlgoStreamingListener<T>(this));
+	fillListener.reset(new BacktestToMatchingSimulatorListener<T>(this));
+	marketDataService.AddListener(marketDataListener.get());
+	marketDataService.AddListener(algoExecutionService.GetListener());
+	pricingService.AddListener(algoStreamingService.GetListener());
+	algoExecutionService.AddListener(executionListener.get());
+	algoStreamingService.AddListener(streamingListener.get());
+}
+
+template<typename T>
+BacktestResult Backtest<T>::Run(const vector<vector<string>>& marketData, const vector<vector<string>>& prices, int replays)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	MarketDataConnector<T>* marketDataConnector = marketDataService.GetConnector();
+	PricingConnector<T>* pricingConnector = pricingService.GetConnector();
+
+	// Interleave the two data sets in proportion to their lengths
+	long marketDataCount = marketData.size();
+	long priceCount = prices.size();
+	for (int replay = 0; replay < replays; replay++)
+	{
+		long i = 0;
+		long j = 0;
+		while (i < marketDataCount || j < priceCount)
+		{
+			if (j >= priceCount || (i < marketDataCount && i * priceCount <= j * marketDataCount))
+			{
+				if (!marketData[i].empty()) marketDataConnector->SubscribeLine(marketData[i]);
+				i++;
+			}
+			else
+			{
+				if (!prices[j].empty())
+				{
+					pricingConnector->SubscribeLine(prices[j]);
+					result.priceCount++;
+				}
+				j++;
+			}
+		}
+	}
+
+	// Mark what both strategies hold at the last mid of each product
+	BacktestResult res = result;
+	for (vector<BacktestPosition>::iterator it = positions.begin(); it != positions.end(); it++)
+	{
+		res.executionPnL = res.executionPnL + it->executionCash + it->executionPosition * it->lastMid / 100.0;
+		res.streamingPnL = res.streamingPnL + it->streamingCash + it->streamingPosition * it->lastMid / 100.0;
+	}
+	res.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	return res;
+}
+
+template<typename T>
+const BacktestParameters& Backtest<T>::GetParameters() const
+{
+	return parameters;
+}
+
+template<typename T>
+void Backtest<T>::ProcessBook(OrderBook<T>& orderBook)
+{
+	result.bookCount++;
+	int index = GetPositionIndex(orderBook.GetProduct());
+	ReplaySide(index, 0, orderBook.GetBidStack());
+	ReplaySide(index, 1, orderBook.GetOfferStack());
+
+	BacktestPosition& position = positions[index];
+	if (!position.levels[0].empty() && !position.levels[1].empty())
+		position.lastMid = (double)(position.levels[0].rbegin()->first + position.levels[1].begin()->first) / 2.0 / MARKET_DATA_TICKS;
+}
+
+template<typename T>
+void Backtest<T>::ProcessExecution(AlgoExecution<T>& algoExecution)
+{
+	// Market orders never rest, so they fill here against the book the algo decided on
+	ExecutionOrder<T>* executionOrder = algoExecution.GetExecutionOrder();
+	int index = GetPositionIndex(executionOrder->GetProduct());
+	result.executionCount++;
+	executionSimulators[index]->SubmitOrder(*executionOrder);
+}
+
+template<typename T>
+void Backtest<T>::ProcessStream(AlgoStream<T>& algoStream)
+{
+	PriceStream<T>* priceStream = algoStream.GetPriceStream();
+	T curr_product = priceStream->GetProduct();
+	int index = GetPositionIndex(curr_product);
+	BacktestPosition& position = positions[index];
+	MatchingSimulator<T>& simulator = *streamingSimulators[index];
+	result.quoteCount++;
+
+	// The new quote goes to the back of its queues; the bid buys the offers, so it executes against them
+	simulator.CancelOrder(position.quoteBidOrderId);
+	simulator.CancelOrder(position.quoteOfferOrderId);
+	const PriceStreamOrder& bidOrder = priceStream->GetBidOrder();
+	const PriceStreamOrder& offerOrder = priceStream->GetOfferOrder();
+	position.quoteBidOrderId = "QB" + to_string(++quoteSequence);
+	position.quoteOfferOrderId = "QO" + to_string(quoteSequence);
+	ExecutionOrder<T> bidQuote(curr_product, OFFER, position.quoteBidOrderId, LIMIT, bidOrder.GetPrice(),
+		bidOrder.GetVisibleQuantity(), bidOrder.GetHiddenQuantity(), "", false);
+	ExecutionOrder<T> offerQuote(curr_product, BID, position.quoteOfferOrderId, LIMIT, offerOrder.GetPrice(),
+		offerOrder.GetVisibleQuantity(), offerOrder.GetHiddenQuantity(), "", false);
+	if (bidQuote.GetVisibleQuantity() + bidQuote.GetHiddenQuantity() > 0) simulator.SubmitOrder(bidQuote);
+	if (offerQuote.GetVisibleQuantity() + offerQuote.GetHiddenQuantity() > 0) simulator.SubmitOrder(offerQuote);
+}
+
+template<typename T>
+void Backtest<T>::ProcessFill(ExecutionOrder<T>& fill)
+{
+	BacktestPosition& position = positions[GetPositionIndex(fill.GetProduct())];
+
+	// A fill on the bid sold into the bids, a fill on the offer bought the offers
+	bool sell = fill.GetSide() == BID;
+	long quantity = (long)fill.GetVisibleQuantity();
+	double notional = quantity * fill.GetPrice() / 100.0;
+	if (fill.GetOrderId() == position.quoteBidOrderId || fill.GetOrderId() == position.quoteOfferOrderId)
+	{
+		result.quoteFillCount++;
+		result.quoteFilledQuantity += quantity;
+		position.streamingPosition += sell ? -quantity : quantity;
+		position.streamingCash += sell ? notional : -notional;
+		return;
+	}
+
+	double midNotional = quantity * position.lastMid / 100.0;
+	result.executedQuantity += quantity;
+	result.executionSlippage += sell ? midNotional - notional : notional - midNotional;
+	position.executionPosition += sell ? -quantity : quantity;
+	position.executionCash += sell ? notional : -notional;
+}
+
+template<typename T>
+int Backtest<T>::GetPositionIndex(const T& product)
+{
+	string productId = product.GetProductId();
+	unordered_map<string, int>::iterator it = positionIndices.find(productId);
+	if (it != positionIndices.end()) return it->second;
+
+	int index = positions.size();
+	positionIndices[productId] = index;
+	BacktestPosition position;
+	position.lastMid = 0.0;
+	position.executionCash = 0.0;
+	position.executionPosition = 0;
+	position.streamingCash = 0.0;
+	position.streamingPosition = 0;
+	positions.push_back(position);
+	executionSimulators.push_back(unique_ptr<MatchingSimulator<T>>(new MatchingSimulator<T>(product, BACKTEST_MIN_PRICE, BACKTEST_MAX_PRICE, BACKTEST_BOOK_CAPACITY)));
+	streamingSimulators.push_back(unique_ptr<MatchingSimulator<T>>(new MatchingSimulator<T>(product, BACKTEST_MIN_PRICE, BACKTEST_MAX_PRICE, BACKTEST_BOOK_CAPACITY)));
+	executionSimulators.back()->AddListener(fillListener.get());
+	streamingSimulators.back()->AddListener(fillListener.get());
+	return index;
+}
+
+template<typename T>
+void Backtest<T>::ReplaySide(int index, int side, const vector<Order>& stack)
+{
+	map<long, BacktestLevel>& levels = positions[index].levels[side];
+	MatchingSimulator<T>* simulators[2] = { executionSimulators[index].get(), streamingSimulators[index].get() };
+
+	// Quantity of each price of the new book, in ticks
+	map<long, long> quantities;
+	for (vector<Order>::const_iterator it = stack.begin(); it != stack.end(); it++)
+		quantities[llround(it->GetPrice() * MARKET_DATA_TICKS)] += it->GetQuantity();
+	long touch = levels.empty() ? -1 : (side == 0 ? levels.rbegin()->first : levels.begin()->first);
+
+	// Levels that shrank traded at the touch, and were cancelled from the back anywhere else; the feed orders
+	// trade in full in the replay, whatever the children already took of them in each simulator
+	for (map<long, BacktestLevel>::iterator it = levels.begin(); it != levels.end();)
+	{
+		map<long, long>::iterator q_it = quantities.find(it->first);
+		long quantity = (q_it == quantities.end()) ? 0 : q_it->second;
+		long decrease = it->second.quantity - quantity;
+		deque<pair<long, long>>& orders = it->second.orders;
+		bool executed = it->first == touch;
+		while (decrease > 0 && !orders.empty())
+		{
+			pair<long, long>& order = executed ? orders.front() : orders.back();
+			long amount = min(decrease, order.second);
+			for (int i = 0; i < 2; i++)
+			{
+				if (executed) simulators[i]->OnExecute(order.first, amount);
+				else simulators[i]->OnCancel(order.first, amount);
+			}
+			order.second -= amount;
+			decrease -= amount;
+			if (order.second > 0) break;
+			if (executed) orders.pop_front();
+			else orders.pop_back();
+		}
+		it->second.quantity = min(it->second.quantity, quantity);
+		if (quantity > 0) it++;
+		else it = levels.erase(it);
+	}
+
+	// Levels that grew, or are new, take a feed order at the back of their queue
+	for (map<long, long>::iterator q_it = quantities.begin(); q_it != quantities.end(); q_it++)
+	{
+		BacktestLevel& level = levels[q_it->first];
+		if (q_it->second <= level.quantity) continue;
+		long orderId = nextFeedOrderId++;
+		for (int i = 0; i < 2; i++)
+			simulators[i]->OnAdd(orderId, side == 0 ? BID : OFFER, (double)q_it->first / MARKET_DATA_TICKS, q_it->second - level.quantity);
+		level.orders.push_back(make_pair(orderId, q_it->second - level.quantity));
+		level.quantity = q_it->second;
+	}
+}
+
+
+
+
+template<typename T>
+BacktestToMarketDataListener<T>::BacktestToMarketDataListener(Backtest<T>* _backtest)
+{
+	backtest = _backtest;
+}
+
+template<typename T>
+void BacktestToMarketDataListener<T>::ProcessAdd(OrderBook<T>& _data)
+{
+	backtest->ProcessBook(_data);
+}
+
+template<typename T>
+void BacktestToMarketDataListener<T>::ProcessRemove(OrderBook<T>& _data)
+{
+}
+
+template<typename T>
+void BacktestToMarketDataListener<T>::ProcessUpdate(OrderBook<T>& _data)
+{
+}
+
+
+
+
+template<typename T>
+BacktestToAlgoExecutionListener<T>::BacktestToAlgoExecutionListener(Backtest<T>* _backtest)
+{
+	backtest = _backtest;
+}
+
+template<typename T>
+void BacktestToAlgoExecutionListener<T>::ProcessAdd(AlgoExecution<T>& _data)
+{
+	backtest->ProcessExecution(_data);
+}
+
+template<typename T>
+void BacktestToAlgoExecutionListener<T>::ProcessRemove(AlgoExecution<T>& _data)
+{
+}
+
+template<typename T>
+void BacktestToAlgoExecutionListener<T>::ProcessUpdate(AlgoExecution<T>& _data)
+{
+}
+
+
+
+
+template<typename T>
+BacktestToAlgoStreamingListener<T>::BacktestToAlgoStreamingListener(Backtest<T>* _backtest)
+{
+	backtest = _backtest;
+}
+
+template<typename T>
+void BacktestToAlgoStreamingListener<T>::ProcessAdd(AlgoStream<T>& _data)
+{
+	backtest->ProcessStream(_data);
+}
+
+template<typename T>
+void BacktestToAlgoStreamingListener<T>::ProcessRemove(AlgoStream<T>& _data)
+{
+}
+
+template<typename T>
+void BacktestToAlgoStreamingListener<T>::ProcessUpdate(AlgoStream<T>& _data)
+{
+}
+
+
+
+
+template<typename T>
+BacktestToMatchingSimulatorListener<T>::BacktestToMatchingSimulatorListener(Backtest<T>* _backtest)
+{
+	backtest = _backtest;
+}
+
+template<typename T>
+void BacktestToMatchingSimulatorListener<T>::ProcessAdd(ExecutionOrder<T>& _data)
+{
+	backtest->ProcessFill(_data);
+}
+
+template<typename T>
+void BacktestToMatchingSimulatorListener<T>::ProcessRemove(ExecutionOrder<T>& _data)
+{
+}
+
+template<typename T>
+void BacktestToMatchingSimulatorListener<T>::ProcessUpdate(ExecutionOrder<T>& _data)
+{
+}
@@ -0,0 +1,284 @@
+/**
+ * Backtest.hpp
+ * Defines a backtesting harness replaying recorded data through the algo execution and algo streaming strategies.
+ *
+ * @author Jordan Wang
+ */
+
+#ifndef Backtest_hpp
+#define Backtest_hpp
+#include "soa.hpp"
+#include "my functions.hpp"
+#include "BondMarketDataService.hpp"
+#include "BondPricingService.hpp"
+#include "BondExecutionService.hpp"
+#include "BondStreamingService.hpp"
+#include "MatchingSimulator.hpp"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <unordered_map>
+using namespace std;
+
+
+
+
+const double BACKTEST_MIN_PRICE = 50.0;			// lowest price on the ladder of the simulated books
+const double BACKTEST_MAX_PRICE = 150.0;		// highest price on the ladder of the simulated books
+const int BACKTEST_BOOK_CAPACITY = 1 << 16;		// # of orders a simulated book has room for
+
+
+
+
+/**
+ * Strategy parameters of one backtest run.
+ */
+struct BacktestParameters
+{
+	string name;						// name of the parameter set in the results
+	double minSpread;					// widest spread the execution algo aggresses at
+	long visibleQuantities[2];			// visible sizes the quotes alternate between
+	double hiddenRatio;					// hidden size of the quotes over the visible size
+	int alternationPeriod;				// # of orders the execution algo sends on a side before it switches sides
+};
+
+
+
+
+/**
+ * Outcome of one backtest run. P&L is in currency, marked at the last mid of each product.
+ */
+struct BacktestResult
+{
+	long bookCount;						// # of books replayed
+	long priceCount;					// # of prices replayed
+	long executionCount;				// # of orders of the execution algo
+	long executedQuantity;				// quantity filled on the orders of the execution algo
+	double executionSlippage;			// cost of the fills of the execution algo against the mid at the decision
+	double executionPnL;				// P&L of the execution algo
+	long quoteCount;					// # of two-way quotes of the streaming algo
+	long quoteFillCount;				// # of fills of the quotes
+	long quoteFilledQuantity;			// quantity filled on the quotes
+	double streamingPnL;				// P&L of the streaming algo
+	double seconds;						// wall time of the run
+};
+
+
+
+
+/**
+ * A price level of the replayed book: the quantity the recorded books show there, and the feed orders making it up.
+ */
+struct BacktestLevel
+{
+	long quantity;						// quantity of the level in the latest book
+	deque<pair<long, long>> orders;		// feed orders of the level as {identifier, quantity left}, oldest first
+};
+
+
+
+
+/**
+ * Simulated state of a product in a backtest: the replayed book, and the positions of the two strategies.
+ */
+struct BacktestPosition
+{
+	map<long, BacktestLevel> levels[2];	// levels of the replayed book by price in ticks, bids (0) and offers (1)
+	double lastMid;						// mid of the latest book (0 before the first two-sided book)
+	double executionCash;				// cash of the execution algo
+	long executionPosition;				// position of the execution algo
+	double streamingCash;				// cash of the streaming algo
+	long streamingPosition;				// position of the streaming algo
+	string quoteBidOrderId;				// order identifier of the bid of the live quote
+	string quoteOfferOrderId;			// order identifier of the offer of the live quote
+};
+
+
+
+
+/* Listener of Backtest on MarketDataService */
+template<typename T>
+class BacktestToMarketDataListener;
+
+/* Listener of Backtest on AlgoExecutionService */
+template<typename T>
+class BacktestToAlgoExecutionListener;
+
+/* Listener of Backtest on AlgoStreamingService */
+template<typename T>
+class BacktestToAlgoStreamingListener;
+
+/* Listener of Backtest on the fills of MatchingSimulator */
+template<typename T>
+class BacktestToMatchingSimulatorListener;
+
+
+
+
+/**
+ * Backtest of the algo execution and algo streaming strategies over recorded market data and prices.
+ * Each backtest owns its own market data, pricing, algo execution and algo streaming services, wired as in
+ * the trading system, so that backtests of different parameter sets share nothing and run on different threads.
+ * The lines of the two data sets are fed through the connectors in proportion, as if they had been recorded together.
+ * Each product has a MatchingSimulator per strategy, so that the two never trade with each other, and both books
+ * are replayed from the recorded books: the change of each level from one book to the next becomes feed orders
+ * added at the back of the level, cancelled from the back, or, at the touch, executed from the front.
+ * Orders of the execution algo are market orders matched in their simulator, and their slippage is taken against
+ * the mid of the book they were decided on. Quotes of the streaming algo rest in theirs as limit orders until the
+ * next quote replaces them, and fill from their queue position.
+ * Type T is the product type.
+ */
+template<typename T>
+class Backtest
+{
+
+public:
+	// ctor for a backtest of a parameter set
+	Backtest(const BacktestParameters& _parameters);
+
+	// Replay the market data and price lines a # of times through the strategies, and get the outcome
+	BacktestResult Run(const vector<vector<string>>& marketData, const vector<vector<string>>& prices, int replays);
+
+	// Get the parameter set
+	const BacktestParameters& GetParameters() const;
+
+	// Replay the change from the last book of a product into its simulator, filling the live quotes it trades with
+	void ProcessBook(OrderBook<T>& orderBook);
+
+	// Match an order of the execution algo in the simulator of its product
+	void ProcessExecution(AlgoExecution<T>& algoExecution);
+
+	// Replace the live quote of a product with a new quote of the streaming algo
+	void ProcessStream(AlgoStream<T>& algoStream);
+
+	// Book a fill of the simulator to the strategy that sent the order
+	void ProcessFill(ExecutionOrder<T>& fill);
+
+private:
+	// Get the index of the state and the simulators of a product, adding them on first sight
+	int GetPositionIndex(const T& product);
+
+	// Replay the levels of one side of a new book into the simulators of a product
+	void ReplaySide(int index, int side, const vector<Order>& stack);
+
+	BacktestParameters parameters;							// parameter set
+	MarketDataService<T> marketDataService;					// market data service of the backtest
+	PricingService<T> pricingService;						// pricing service of the backtest
+	AlgoExecutionService<T> algoExecutionService;			// execution algo under test
+	AlgoStreamingService<T> algoStreamingService;			// streaming algo under test
+	unique_ptr<BacktestToMarketDataListener<T>> marketDataListener;	// listener on MarketDataService
+	unique_ptr<BacktestToAlgoExecutionListener<T>> executionListener;	// listener on AlgoExecutionService
+	unique_ptr<BacktestToAlgoStreamingListener<T>> streamingListener;	// listener on AlgoStreamingService
+	unique_ptr<BacktestToMatchingSimulatorListener<T>> fillListener;	// listener on the simulators
+	unordered_map<string, int> positionIndices;				// a map of {product identifier -> index in positions}
+	vector<BacktestPosition> positions;						// state of each product
+	vector<unique_ptr<MatchingSimulator<T>>> executionSimulators;	// simulator of the execution algo of each product
+	vector<unique_ptr<MatchingSimulator<T>>> streamingSimulators;	// simulator of the streaming algo of each product
+	long nextFeedOrderId;									// identifier of the next feed order replayed
+	long quoteSequence;										// # of quote orders sent to the simulators
+	BacktestResult result;									// outcome so far
+};
+
+
+
+
+/* Listener of Backtest on MarketDataService */
+template<typename T>
+class BacktestToMarketDataListener : public ServiceListener<OrderBook<T>>
+{
+public:
+	// ctor
+	BacktestToMarketDataListener(Backtest<T>* _backtest);
+
+	// Listener callback to process an add event to Backtest
+	void ProcessAdd(OrderBook<T>& _data);
+
+	// Listener callback to process a remove event to Backtest
+	void ProcessRemove(OrderBook<T>& _data);
+
+	// Listener callback to process an update event to Backtest
+	void ProcessUpdate(OrderBook<T>& _data);
+
+private:
+	Backtest<T>* backtest;								// a pointer to Backtest
+};
+
+
+
+
+/* Listener of Backtest on AlgoExecutionService */
+template<typename T>
+class BacktestToAlgoExecutionListener : public ServiceListener<AlgoExecution<T>>
+{
+public:
+	// ctor
+	BacktestToAlgoExecutionListener(Backtest<T>* _backtest);
+
+	// Listener callback to process an add event to Backtest
+	void ProcessAdd(AlgoExecution<T>& _data);
+
+	// Listener callback to process a remove event to Backtest
+	void ProcessRemove(AlgoExecution<T>& _data);
+
+	// Listener callback to process an update event to Backtest
+	void ProcessUpdate(AlgoExecution<T>& _data);
+
+private:
+	Backtest<T>* backtest;								// a pointer to Backtest
+};
+
+
+
+
+/* Listener of Backtest on AlgoStreamingService */
+template<typename T>
+class BacktestToAlgoStreamingListener : public ServiceListener<AlgoStream<T>>
+{
+public:
+	// ctor
+	BacktestToAlgoStreamingListener(Backtest<T>* _backtest);
+
+	// Listener callback to process an add event to Backtest
+	void ProcessAdd(AlgoStream<T>& _data);
+
+	// Listener callback to process a remove event to Backtest
+	void ProcessRemove(AlgoStream<T>& _data);
+
+	// Listener callback to process an update event to Backtest
+	void ProcessUpdate(AlgoStream<T>& _data);
+
+private:
+	Backtest<T>* backtest;								// a pointer to Backtest
+};
+
+
+
+
+/* Listener of Backtest on the fills of MatchingSimulator */
+template<typename T>
+class BacktestToMatchingSimulatorListener : public ServiceListener<ExecutionOrder<T>>
+{
+public:
+	// ctor
+	BacktestToMatchingSimulatorListener(Backtest<T>* _backtest);
+
+	// Listener callback to process an add event to Backtest
+	void ProcessAdd(ExecutionOrder<T>& _data);
+
+	// Listener callback to process a remove event to Backtest
+	void ProcessRemove(ExecutionOrder<T>& _data);
+
+	// Listener callback to process an update event to Backtest
+	void ProcessUpdate(ExecutionOrder<T>& _data);
+
+private:
+	Backtest<T>* backtest;								// a pointer to Backtest
+};
+
+
+
+
+#endif
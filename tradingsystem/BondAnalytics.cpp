@@ -0,0 +1,187 @@
+/**
+ * BondAnalytics.cpp
+ * Defines the analytics engine for fixed coupon bonds.
+ *
+ * @author Jordan Wang
+ */
+ 
+#include "BondAnalytics.hpp"
+#include "boost/date_time/gregorian/gregorian.hpp"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <unordered_map>
+using namespace std;
+using namespace boost::gregorian;
+
+
+
+
+BondAnalytics::BondAnalytics(const Bond &_bond, const date &_settlementDate)
+{
+	settlementDate = _settlementDate;
+	accruedInterest = 0.0;
+	cleanPrice = 0.0;
+	yield = 0.0;
+	modifiedDuration = 0.0;
+	pv01 = 0.0;
+	convexity = 0.0;
+	
+	// Semi-annual coupon per 100 face (the bond coupon is quoted in percent)
+	coupon = _bond.GetCoupon() / 2.0;
+	date maturityDate = _bond.GetMaturityDate();
+	
+	// Walk back from maturity to find the coupon dates after settlement
+	int periodCount = 0;
+	date couponDate = maturityDate;
+	while (couponDate > settlementDate)
+	{
+		periodCount++;
+		couponDate = maturityDate - months(6 * periodCount);
+	}
+	if (periodCount == 0) return;		// matured bond
+	
+	// Fraction of the current coupon period left until the next coupon (Act/Act)
+	date previousCouponDate = couponDate;
+	date nextCouponDate = maturityDate - months(6 * (periodCount - 1));
+	double periodDays = (nextCouponDate - previousCouponDate).days();
+	double periodFraction = (nextCouponDate - settlementDate).days() / periodDays;
+	accruedInterest = coupon * (1.0 - periodFraction);
+	
+	times = vector<double>(periodCount);
+	cashFlows = vector<double>(periodCount, coupon);
+	for (int i = 0; i < periodCount; i++)
+		times[i] = periodFraction + i;
+	cashFlows[periodCount - 1] += 100.0;
+}
+
+const date& BondAnalytics::GetSettlementDate() const
+{
+	return settlementDate;
+}
+
+double BondAnalytics::GetAccruedInterest() const
+{
+	return accruedInterest;
+}
+
+const vector<double>& BondAnalytics::GetCashFlowTimes() const
+{
+	return times;
+}
+
+const vector<double>& BondAnalytics::GetCashFlows() const
+{
+	return cashFlows;
+}
+
+void BondAnalytics::Discount(double _yield, double &_dirtyPrice, double &_firstDerivative, double &_secondDerivative) const
+{
+	double growth = 1.0 + _yield / 2.0;
+	double logGrowth = log(growth);
+	int cashFlowCount = times.size();
+	const double* t = times.data();
+	const double* cf = cashFlows.data();
+	
+	// One pass over the cash flows for the price and both derivatives
+	double pv = 0.0, tpv = 0.0, ttpv = 0.0;
+	for (int i = 0; i < cashFlowCount; i++)
+	{
+		double discounted = cf[i] * exp(-t[i] * logGrowth);
+		pv += discounted;
+		tpv += t[i] * discounted;
+		ttpv += t[i] * (t[i] + 1.0) * discounted;
+	}
+	
+	_dirtyPrice = pv;
+	_firstDerivative = -tpv / (2.0 * growth);
+	_secondDerivative = ttpv / (4.0 * growth * growth);
+}
+
+double BondAnalytics::GetPrice(double _yield) const
+{
+	double dirtyPrice, firstDerivative, secondDerivative;
+	Discount(_yield, dirtyPrice, firstDerivative, secondDerivative);
+	return dirtyPrice - accruedInterest;
+}
+
+double BondAnalytics::GetYield(double _cleanPrice) const
+{
+	if (times.empty()) return 0.0;
+	
+	double targetPrice = _cleanPrice + accruedInterest;
+	double currYield = coupon / 50.0;		// start from the coupon rate
+	double dirtyPrice, firstDerivative, secondDerivative;
+	for (int iteration = 0; iteration < 50; iteration++)
+	{
+		Discount(currYield, dirtyPrice, firstDerivative, secondDerivative);
+		double error = dirtyPrice - targetPrice;
+		if (fabs(error) < 1e-10 || firstDerivative == 0.0) break;
+		currYield -= error / firstDerivative;
+	}
+	return currYield;
+}
+
+double BondAnalytics::GetModifiedDuration(double _yield) const
+{
+	double dirtyPrice, firstDerivative, secondDerivative;
+	Discount(_yield, dirtyPrice, firstDerivative, secondDerivative);
+	return (dirtyPrice == 0.0) ? 0.0 : -firstDerivative / dirtyPrice;
+}
+
+double BondAnalytics::GetPV01(double _yield) const
+{
+	double dirtyPrice, firstDerivative, secondDerivative;
+	Discount(_yield, dirtyPrice, firstDerivative, secondDerivative);
+	return -firstDerivative * 0.01;
+}
+
+double BondAnalytics::GetConvexity(double _yield) const
+{
+	double dirtyPrice, firstDerivative, secondDerivative;
+	Discount(_yield, dirtyPrice, firstDerivative, secondDerivative);
+	return (dirtyPrice == 0.0) ? 0.0 : secondDerivative / dirtyPrice;
+}
+
+void BondAnalytics::Reprice(double _cleanPrice)
+{
+	cleanPrice = _cleanPrice;
+	yield = GetYield(_cleanPrice);
+	
+	double dirtyPrice, firstDerivative, secondDerivative;
+	Discount(yield, dirtyPrice, firstDerivative, secondDerivative);
+	modifiedDuration = (dirtyPrice == 0.0) ? 0.0 : -firstDerivative / dirtyPrice;
+	pv01 = -firstDerivative * 0.01;
+	convexity = (dirtyPrice == 0.0) ? 0.0 : secondDerivative / dirtyPrice;
+}
+
+double BondAnalytics::GetCleanPrice() const
+{
+	return cleanPrice;
+}
+
+double BondAnalytics::GetYield() const
+{
+	return yield;
+}
+
+double BondAnalytics::GetModifiedDuration() const
+{
+	return modifiedDuration;
+}
+
+double BondAnalytics::GetPV01() const
+{
+	return pv01;
+}
+
+double BondAnalytics::GetConvexity() const
+{
+	return convexity;
+}
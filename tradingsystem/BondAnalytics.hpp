@@ -0,0 +1,101 @@
+/**
+ * BondAnalytics.hpp
+ * Defines the analytics engine for fixed coupon bonds (price, yield, duration, PV01 and convexity).
+ *
+ * @author Jordan Wang
+ */
+
+#ifndef BondAnalytics_hpp
+#define BondAnalytics_hpp
+#include "boost/date_time/gregorian/gregorian.hpp"
+#include "soa.hpp"
+#include "products.hpp"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <unordered_map>
+using namespace std;
+using namespace boost::gregorian;
+
+
+
+
+/**
+ * Bond analytics for a fixed coupon bond paying semi-annual coupons.
+ * The coupon schedule is built once from the coupon and maturity date of the bond,
+ * with cash flow times measured in coupon periods from the settlement date.
+ * Prices are quoted per 100 face and yields are semi-annual bond equivalent yields.
+ */
+class BondAnalytics
+{
+
+public:
+	// default ctor
+	BondAnalytics() = default;
+
+	// ctor for the analytics of a bond settling on a given date
+	BondAnalytics(const Bond &_bond, const date &_settlementDate);
+
+	// Get the settlement date
+	const date& GetSettlementDate() const;
+
+	// Get the accrued interest per 100 face
+	double GetAccruedInterest() const;
+
+	// Get the cash flow times in coupon periods from settlement
+	const vector<double>& GetCashFlowTimes() const;
+
+	// Get the cash flow amounts per 100 face
+	const vector<double>& GetCashFlows() const;
+
+	// Get the clean price per 100 face given a yield
+	double GetPrice(double _yield) const;
+
+	// Get the yield given a clean price per 100 face (Newton solver)
+	double GetYield(double _cleanPrice) const;
+
+	// Get the modified duration given a yield
+	double GetModifiedDuration(double _yield) const;
+
+	// Get the PV01 given a yield, on the same scale as GetPV01 (price change of 1bp per 10,000 face)
+	double GetPV01(double _yield) const;
+
+	// Get the convexity given a yield
+	double GetConvexity(double _yield) const;
+
+	// Solve the yield from a clean price and compute all analytics in one go
+	void Reprice(double _cleanPrice);
+
+	// Get the results of the last Reprice
+	double GetCleanPrice() const;
+	double GetYield() const;
+	double GetModifiedDuration() const;
+	double GetPV01() const;
+	double GetConvexity() const;
+
+private:
+	// Discount the cash flows at a yield, returning the dirty price and its first two derivatives in the yield
+	void Discount(double _yield, double &_dirtyPrice, double &_firstDerivative, double &_secondDerivative) const;
+
+	date settlementDate;
+	double coupon;					// semi-annual coupon per 100 face
+	double accruedInterest;
+	vector<double> times;			// cash flow times in coupon periods from settlement
+	vector<double> cashFlows;		// cash flow amounts per 100 face
+	double cleanPrice;
+	double yield;
+	double modifiedDuration;
+	double pv01;
+	double convexity;
+};
+
+
+
+
+#endif
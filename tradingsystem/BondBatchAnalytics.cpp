@@ -0,0 +1,242 @@
+/**
+ * BondBatchAnalytics.cpp
+ * Defines the batch analytics to reprice a whole universe of bonds off a discount curve.
+ *
+ * @author Jordan Wang
+ */
+ 
+#include "BondBatchAnalytics.hpp"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+using namespace std;
+
+
+
+
+// # of bonds priced per instruction
+#if defined(__AVX512F__)
+static const int SIMD_WIDTH = 8;
+#elif defined(__AVX2__)
+static const int SIMD_WIDTH = 4;
+#else
+static const int SIMD_WIDTH = 1;
+#endif
+
+
+
+
+#if defined(__AVX512F__)
+// exp(x) on 8 doubles: exp(x) = 2^n * exp(f) with |f| <= ln2 / 2 and a degree 12 polynomial for exp(f)
+static inline __m512d Exp512(__m512d x)
+{
+	x = _mm512_min_pd(_mm512_max_pd(x, _mm512_set1_pd(-700.0)), _mm512_set1_pd(700.0));
+	__m512d n = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(1.4426950408889634)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m512d f = _mm512_fnmadd_pd(n, _mm512_set1_pd(0.693145751953125), x);
+	f = _mm512_fnmadd_pd(n, _mm512_set1_pd(1.42860682030941723212e-6), f);
+	
+	__m512d p = _mm512_set1_pd(1.0 / 479001600.0);
+	p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 39916800.0));
+	p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 3628800.0));
+	p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 362880.0));
+	p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 40320.0));
+	p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 5040.0));
+	p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 720.0));
+	p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 120.0));
+	p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 24.0));
+	p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 6.0));
+	p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(0.5));
+	p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0));
+	p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0));
+	return _mm512_scalef_pd(p, n);
+}
+#elif defined(__AVX2__)
+// exp(x) on 4 doubles: exp(x) = 2^n * exp(f) with |f| <= ln2 / 2 and a degree 12 polynomial for exp(f)
+static inline __m256d Exp256(__m256d x)
+{
+	x = _mm256_min_pd(_mm256_max_pd(x, _mm256_set1_pd(-700.0)), _mm256_set1_pd(700.0));
+	__m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256d f = _mm256_sub_pd(x, _mm256_mul_pd(n, _mm256_set1_pd(0.693145751953125)));
+	f = _mm256_sub_pd(f, _mm256_mul_pd(n, _mm256_set1_pd(1.42860682030941723212e-6)));
+	
+	__m256d p = _mm256_set1_pd(1.0 / 479001600.0);
+	p = _mm256_add_pd(_mm256_mul_pd(p, f), _mm256_set1_pd(1.0 / 39916800.0));
+	p = _mm256_add_pd(_mm256_mul_pd(p, f), _mm256_set1_pd(1.0 / 3628800.0));
+	p = _mm256_add_pd(_mm256_mul_pd(p, f), _mm256_set1_pd(1.0 / 362880.0));
+	p = _mm256_add_pd(_mm256_mul_pd(p, f), _mm256_set1_pd(1.0 / 40320.0));
+	p = _mm256_add_pd(_mm256_mul_pd(p, f), _mm256_set1_pd(1.0 / 5040.0));
+	p = _mm256_add_pd(_mm256_mul_pd(p, f), _mm256_set1_pd(1.0 / 720.0));
+	p = _mm256_add_pd(_mm256_mul_pd(p, f), _mm256_set1_pd(1.0 / 120.0));
+	p = _mm256_add_pd(_mm256_mul_pd(p, f), _mm256_set1_pd(1.0 / 24.0));
+	p = _mm256_add_pd(_mm256_mul_pd(p, f), _mm256_set1_pd(1.0 / 6.0));
+	p = _mm256_add_pd(_mm256_mul_pd(p, f), _mm256_set1_pd(0.5));
+	p = _mm256_add_pd(_mm256_mul_pd(p, f), _mm256_set1_pd(1.0));
+	p = _mm256_add_pd(_mm256_mul_pd(p, f), _mm256_set1_pd(1.0));
+	
+	// Build 2^n from the exponent bits
+	__m256i exponent = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n));
+	exponent = _mm256_slli_epi64(_mm256_add_epi64(exponent, _mm256_set1_epi64x(1023)), 52);
+	return _mm256_mul_pd(p, _mm256_castsi256_pd(exponent));
+}
+#endif
+
+
+
+
+BondUniverse::BondUniverse(const vector<Bond> &_bonds, const date &_settlementDate) :
+	bonds(_bonds)
+{
+	bondCount = bonds.size();
+	paddedCount = (bondCount + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+	
+	// Build the coupon schedule of every bond
+	vector<BondAnalytics> schedules;
+	periodCount = 0;
+	for (int i = 0; i < bondCount; i++)
+	{
+		indices[bonds[i].GetProductId()] = i;
+		schedules.push_back(BondAnalytics(bonds[i], _settlementDate));
+		periodCount = max(periodCount, (int)schedules[i].GetCashFlows().size());
+	}
+	
+	coupons = vector<double>(paddedCount, 0.0);
+	notionals = vector<double>(paddedCount, 0.0);
+	times = vector<double>(periodCount * paddedCount, 0.0);
+	cashFlows = vector<double>(periodCount * paddedCount, 0.0);
+	lowerKnots = vector<int>(periodCount * paddedCount, 0);
+	upperKnots = vector<int>(periodCount * paddedCount, 0);
+	knotWeights = vector<double>(periodCount * paddedCount, 0.0);
+	prices = vector<double>(paddedCount, 0.0);
+	pv01s = vector<double>(paddedCount, 0.0);
+	
+	// Lay the schedules out period-major
+	for (int i = 0; i < bondCount; i++)
+	{
+		coupons[i] = bonds[i].GetCoupon();
+		notionals[i] = 100.0;
+		const vector<double>& bondTimes = schedules[i].GetCashFlowTimes();
+		const vector<double>& bondCashFlows = schedules[i].GetCashFlows();
+		for (int k = 0; k < (int)bondTimes.size(); k++)
+		{
+			times[k * paddedCount + i] = bondTimes[k] / 2.0;		// coupon periods -> years
+			cashFlows[k * paddedCount + i] = bondCashFlows[k];
+		}
+	}
+}
+
+int BondUniverse::GetSize() const
+{
+	return bondCount;
+}
+
+int BondUniverse::GetIndex(const string &productId) const
+{
+	unordered_map<string, int>::const_iterator it = indices.find(productId);
+	return (it == indices.end()) ? -1 : it->second;
+}
+
+const Bond& BondUniverse::GetBond(int index) const
+{
+	return bonds[index];
+}
+
+double BondUniverse::GetCoupon(int index) const
+{
+	return coupons[index];
+}
+
+double BondUniverse::GetNotional(int index) const
+{
+	return notionals[index];
+}
+
+double BondUniverse::GetPrice(int index) const
+{
+	return prices[index];
+}
+
+double BondUniverse::GetPV01(int index) const
+{
+	return pv01s[index];
+}
+
+void BondUniverse::BindCurve(const DiscountCurve &curve)
+{
+	boundTenors = curve.GetTenors();
+	for (int slot = 0; slot < periodCount * paddedCount; slot++)
+		curve.GetInterpolation(times[slot], lowerKnots[slot], upperKnots[slot], knotWeights[slot]);
+}
+
+void BondUniverse::Reprice(const DiscountCurve &curve)
+{
+	if (curve.GetZeroRates().empty()) return;
+	
+	// The knots only depend on the tenors, so they are recomputed only when the tenors change
+	if (curve.GetTenors() != boundTenors) BindCurve(curve);
+	const double* zeroRates = curve.GetZeroRates().data();
+	
+	for (int b = 0; b < paddedCount; b += SIMD_WIDTH)
+	{
+#if defined(__AVX512F__)
+		__m512d price = _mm512_setzero_pd();
+		__m512d risk = _mm512_setzero_pd();
+		for (int k = 0; k < periodCount; k++)
+		{
+			int slot = k * paddedCount + b;
+			__m512d t = _mm512_loadu_pd(&times[slot]);
+			__m512d cf = _mm512_loadu_pd(&cashFlows[slot]);
+			__m512d w = _mm512_loadu_pd(&knotWeights[slot]);
+			__m512d lower = _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*)&lowerKnots[slot]), zeroRates, 8);
+			__m512d upper = _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*)&upperKnots[slot]), zeroRates, 8);
+			__m512d z = _mm512_fmadd_pd(w, _mm512_sub_pd(upper, lower), lower);
+			__m512d pv = _mm512_mul_pd(cf, Exp512(_mm512_mul_pd(_mm512_sub_pd(_mm512_setzero_pd(), z), t)));
+			price = _mm512_add_pd(price, pv);
+			risk = _mm512_fmadd_pd(t, pv, risk);
+		}
+		_mm512_storeu_pd(&prices[b], price);
+		_mm512_storeu_pd(&pv01s[b], _mm512_mul_pd(risk, _mm512_set1_pd(0.01)));
+#elif defined(__AVX2__)
+		__m256d price = _mm256_setzero_pd();
+		__m256d risk = _mm256_setzero_pd();
+		for (int k = 0; k < periodCount; k++)
+		{
+			int slot = k * paddedCount + b;
+			__m256d t = _mm256_loadu_pd(&times[slot]);
+			__m256d cf = _mm256_loadu_pd(&cashFlows[slot]);
+			__m256d w = _mm256_loadu_pd(&knotWeights[slot]);
+			__m256d lower = _mm256_i32gather_pd(zeroRates, _mm_loadu_si128((const __m128i*)&lowerKnots[slot]), 8);
+			__m256d upper = _mm256_i32gather_pd(zeroRates, _mm_loadu_si128((const __m128i*)&upperKnots[slot]), 8);
+			__m256d z = _mm256_add_pd(lower, _mm256_mul_pd(w, _mm256_sub_pd(upper, lower)));
+			__m256d pv = _mm256_mul_pd(cf, Exp256(_mm256_mul_pd(_mm256_sub_pd(_mm256_setzero_pd(), z), t)));
+			price = _mm256_add_pd(price, pv);
+			risk = _mm256_add_pd(risk, _mm256_mul_pd(t, pv));
+		}
+		_mm256_storeu_pd(&prices[b], price);
+		_mm256_storeu_pd(&pv01s[b], _mm256_mul_pd(risk, _mm256_set1_pd(0.01)));
+#else
+		double price = 0.0;
+		double risk = 0.0;
+		for (int k = 0; k < periodCount; k++)
+		{
+			int slot = k * paddedCount + b;
+			double z = zeroRates[lowerKnots[slot]] + knotWeights[slot] * (zeroRates[upperKnots[slot]] - zeroRates[lowerKnots[slot]]);
+			double pv = cashFlows[slot] * exp(-z * times[slot]);
+			price += pv;
+			risk += times[slot] * pv;
+		}
+		prices[b] = price;
+		pv01s[b] = risk * 0.01;
+#endif
+	}
+}
@@ -0,0 +1,95 @@
+/**
+ * BondBatchAnalytics.hpp
+ * Defines the batch analytics to reprice a whole universe of bonds off a discount curve.
+ *
+ * @author Jordan Wang
+ */
+
+#ifndef BondBatchAnalytics_hpp
+#define BondBatchAnalytics_hpp
+#include "boost/date_time/gregorian/gregorian.hpp"
+#include "soa.hpp"
+#include "products.hpp"
+#include "BondAnalytics.hpp"
+#include "DiscountCurve.hpp"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <map>
+#include <unordered_map>
+using namespace std;
+using namespace boost::gregorian;
+
+
+
+
+/**
+ * Structure-of-arrays view of a universe of bonds for batch repricing.
+ * Cash flows are stored period-major, i.e. slot [period * paddedCount + bond], with the bonds
+ * padded to a multiple of the SIMD width and short schedules padded with zero cash flows,
+ * so that one kernel prices several bonds per instruction (AVX-512, AVX2 or scalar fallback,
+ * selected at compile time).
+ */
+class BondUniverse
+{
+
+public:
+	// default ctor
+	BondUniverse() = default;
+
+	// ctor for a universe of bonds settling on a given date
+	BondUniverse(const vector<Bond> &_bonds, const date &_settlementDate);
+
+	// Get the # of bonds in the universe
+	int GetSize() const;
+
+	// Get the index of a bond in the universe (-1 if it is not in the universe)
+	int GetIndex(const string &productId) const;
+
+	// Get a bond in the universe
+	const Bond& GetBond(int index) const;
+
+	// Get the coupon of a bond in the universe
+	double GetCoupon(int index) const;
+
+	// Get the notional of a bond in the universe
+	double GetNotional(int index) const;
+
+	// Reprice all the bonds in the universe off a curve in one batch
+	void Reprice(const DiscountCurve &curve);
+
+	// Get the dirty price per 100 face of a bond from the last Reprice
+	double GetPrice(int index) const;
+
+	// Get the PV01 of a bond to a parallel curve shift from the last Reprice, on the same scale as GetPV01
+	double GetPV01(int index) const;
+
+private:
+	// Precompute the interpolation knots of every cash flow time on the tenors of a curve
+	void BindCurve(const DiscountCurve &curve);
+
+	vector<Bond> bonds;
+	unordered_map<string, int> indices;		// a map of {product identifier -> index in the universe}
+	int bondCount;
+	int paddedCount;						// # of bonds padded to a multiple of the SIMD width
+	int periodCount;						// # of cash flows in the longest schedule
+	vector<double> coupons;					// annual coupon of each bond in percent
+	vector<double> notionals;				// face of each bond
+	vector<double> times;					// cash flow times in years from settlement
+	vector<double> cashFlows;				// cash flow amounts
+	vector<int> lowerKnots;					// lower curve knot of each cash flow time
+	vector<int> upperKnots;					// upper curve knot of each cash flow time
+	vector<double> knotWeights;				// interpolation weight of each cash flow time
+	vector<double> boundTenors;				// curve tenors the knots were computed for
+	vector<double> prices;
+	vector<double> pv01s;
+};
+
+
+
+
+#endif
@@ -0,0 +1,216 @@
+/**
+ * BondCurveService.cpp
+ * Defines the Service bootstrapping the yield curve from the on-the-run bond prices.
+ *
+ * @author Jordan Wang
+ */
+
+#include "BondCurveService.hpp"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <unordered_map>
+using namespace std;
+
+
+
+
+template<typename T>
+CurveService<T>::CurveService(const vector<T>& _bonds, string _curveName) :
+	bonds(_bonds)
+{
+	curves = map<string, DiscountCurve>();
+	listeners = vector<ServiceListener<DiscountCurve>*>();
+	listener = new CurveToPricingListener<T>(this);
+	curveName = _curveName;
+	
+	int tenorCount = bonds.size();
+	for (int i = 0; i < tenorCount; i++)
+		tenorIndices[bonds[i].GetProductId()] = i;
+	mids = vector<double>(tenorCount, 0.0);
+	parYields = vector<double>(tenorCount, 0.0);
+	priced = vector<bool>(tenorCount, false);
+	pricedCount = 0;
+	
+	SetSettlementDate(day_clock::local_day());
+}
+
+template<typename T>
+DiscountCurve& CurveService<T>::GetData(string key)
+{
+	return curves[key];
+}
+
+template<typename T>
+void CurveService<T>::OnMessage(DiscountCurve& data)
+{
+	curves[curveName] = data;
+}
+
+template<typename T>
+void CurveService<T>::AddListener(ServiceListener<DiscountCurve>* listener)
+{
+	listeners.push_back(listener);
+}
+
+template<typename T>
+const vector<ServiceListener<DiscountCurve>*>& CurveService<T>::GetListeners() const
+{
+	return listeners;
+}
+
+template<typename T>
+CurveToPricingListener<T>* CurveService<T>::GetListener()
+{
+	return listener;
+}
+
+template<typename T>
+double CurveService<T>::GetParYield(int index) const
+{
+	return parYields[index];
+}
+
+template<typename T>
+void CurveService<T>::SetSettlementDate(const date& _settlementDate)
+{
+	settlementDate = _settlementDate;
+	int tenorCount = bonds.size();
+	
+	// Build the coupon schedule of each tenor, with the tenor at the maturity of its bond
+	analytics.clear();
+	times = vector<vector<double>>(tenorCount);
+	vector<double> tenors;
+	for (int i = 0; i < tenorCount; i++)
+	{
+		analytics.push_back(BondAnalytics(bonds[i], settlementDate));
+		const vector<double>& cashFlowTimes = analytics[i].GetCashFlowTimes();
+		for (vector<double>::const_iterator it = cashFlowTimes.begin(); it != cashFlowTimes.end(); it++)
+			times[i].push_back(*it / 2.0);		// coupon periods -> years
+		tenors.push_back(times[i].empty() ? 0.0 : times[i].back());
+	}
+	DiscountCurve& curve = curves[curveName];
+	curve = DiscountCurve(tenors, vector<double>(tenorCount, 0.0));
+	
+	// The curve knots of each cash flow only depend on the tenors, so they are computed once here
+	lowerKnots = vector<vector<int>>(tenorCount);
+	upperKnots = vector<vector<int>>(tenorCount);
+	knotWeights = vector<vector<double>>(tenorCount);
+	for (int i = 0; i < tenorCount; i++)
+	{
+		for (vector<double>::iterator it = times[i].begin(); it != times[i].end(); it++)
+		{
+			int lower, upper;
+			double weight;
+			curve.GetInterpolation(*it, lower, upper, weight);
+			lowerKnots[i].push_back(lower);
+			upperKnots[i].push_back(upper);
+			knotWeights[i].push_back(weight);
+		}
+	}
+	
+	// Re-fit the curve off the latest mids
+	for (int i = 0; i < tenorCount; i++)
+		if (priced[i]) parYields[i] = analytics[i].GetYield(mids[i]);
+	if (pricedCount == tenorCount)
+		for (int i = 0; i < tenorCount; i++) Bootstrap(i);
+}
+
+template<typename T>
+void CurveService<T>::Bootstrap(int index)
+{
+	DiscountCurve& curve = curves[curveName];
+	const vector<double>& zeroRates = curve.GetZeroRates();
+	const vector<double>& cashFlows = analytics[index].GetCashFlows();
+	double dirtyPrice = mids[index] + analytics[index].GetAccruedInterest();
+	int cashFlowCount = cashFlows.size();
+	
+	// Newton solve on the zero rate of this tenor, starting from the continuously compounded bond yield
+	double zeroRate = 2.0 * log(1.0 + parYields[index] / 2.0);
+	for (int iteration = 0; iteration < 50; iteration++)
+	{
+		double pv = 0.0, dpv = 0.0;
+		for (int j = 0; j < cashFlowCount; j++)
+		{
+			int lower = lowerKnots[index][j];
+			int upper = upperKnots[index][j];
+			double weight = knotWeights[index][j];
+			double lowerRate = (lower == index) ? zeroRate : zeroRates[lower];
+			double upperRate = (upper == index) ? zeroRate : zeroRates[upper];
+			double sensitivity = ((lower == index) ? 1.0 - weight : 0.0) + ((upper == index) ? weight : 0.0);
+			double t = times[index][j];
+			double discounted = cashFlows[j] * exp(-((1.0 - weight) * lowerRate + weight * upperRate) * t);
+			pv += discounted;
+			dpv -= sensitivity * t * discounted;
+		}
+		double error = pv - dirtyPrice;
+		if (fabs(error) < 1e-10 || dpv == 0.0) break;
+		zeroRate -= error / dpv;
+	}
+	
+	curve.SetZeroRate(index, zeroRate);
+}
+
+template<typename T>
+void CurveService<T>::UpdatePrice(Price<T>& price)
+{
+	unordered_map<string, int>::iterator it = tenorIndices.find(price.GetProduct().GetProductId());
+	if (it == tenorIndices.end()) return;		// not an on-the-run bond
+	
+	int index = it->second;
+	double mid = price.GetMid();
+	if (priced[index] && mid == mids[index]) return;		// unchanged mid, nothing to re-fit
+	
+	int tenorCount = bonds.size();
+	bool wasComplete = (pricedCount == tenorCount);
+	if (!priced[index])
+	{
+		priced[index] = true;
+		pricedCount++;
+	}
+	mids[index] = mid;
+	parYields[index] = analytics[index].GetYield(mid);
+	
+	// Wait for a mid on every tenor before publishing a curve
+	if (pricedCount < tenorCount) return;
+	
+	// Shorter tenors do not depend on this one, so only re-fit from this tenor onwards
+	int firstIndex = wasComplete ? index : 0;
+	for (int i = firstIndex; i < tenorCount; i++)
+		Bootstrap(i);
+	
+	DiscountCurve& curve = curves[curveName];
+	for (vector<ServiceListener<DiscountCurve>*>::iterator l_it = listeners.begin(); l_it != listeners.end(); l_it++)
+		(*l_it)->ProcessAdd(curve);
+}
+
+
+
+
+template<typename T>
+CurveToPricingListener<T>::CurveToPricingListener(CurveService<T>* _service)
+{
+	service = _service;
+}
+
+template<typename T>
+void CurveToPricingListener<T>::ProcessAdd(Price<T>& _data)
+{
+	service->UpdatePrice(_data);
+}
+
+template<typename T>
+void CurveToPricingListener<T>::ProcessRemove(Price<T>& _data)
+{
+}
+
+template<typename T>
+void CurveToPricingListener<T>::ProcessUpdate(Price<T>& _data)
+{
+}
@@ -0,0 +1,122 @@
+/**
+ * BondCurveService.hpp
+ * Defines the Service bootstrapping the yield curve from the on-the-run bond prices.
+ *
+ * @author Jordan Wang
+ */
+#ifndef BondCurveService_hpp
+#define BondCurveService_hpp
+#include "soa.hpp"
+#include "my functions.hpp"
+#include "BondPricingService.hpp"
+#include "BondAnalytics.hpp"
+#include "DiscountCurve.hpp"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <map>
+#include <unordered_map>
+using namespace std;
+
+
+
+
+/* Listener of CurveService to PricingService */
+template<typename T>
+class CurveToPricingListener;
+
+
+
+
+/**
+ * Curve Service bootstrapping a zero curve from the mids of the on-the-run bonds (2Y through 30Y).
+ * Each on-the-run bond is a tenor of the curve at its maturity. When the mid of one bond moves,
+ * only the zero rates from its tenor onwards are re-solved, since shorter tenors do not depend on it.
+ * Keyed on curve name.
+ * Type T is the product type.
+ */
+template<typename T>
+class CurveService : public Service<string, DiscountCurve>
+{
+public:
+	// ctor for a curve on the on-the-run bonds (in increasing maturity)
+	CurveService(const vector<T>& _bonds, string _curveName);
+
+    // Get data on our service given a key
+    DiscountCurve& GetData(string key);
+
+    // The callback that a Connector should invoke for any new or updated data
+    void OnMessage(DiscountCurve& data);
+
+    // Add a listener to CurveService for callbacks on add, remove, and update events for data to CurveService
+    void AddListener(ServiceListener<DiscountCurve>* listener);
+
+    // Get all listeners on CurveService
+    const vector<ServiceListener<DiscountCurve>*>& GetListeners() const;
+
+	// Get the listener to PricingService
+    CurveToPricingListener<T>* GetListener();
+
+	// Set the settlement date of the curve (rebuilds the coupon schedules)
+	void SetSettlementDate(const date& _settlementDate);
+
+	// Get the market yield of a tenor from its latest mid (the par curve)
+	double GetParYield(int index) const;
+
+	// Update the mid of an on-the-run bond, re-fit the curve and publish it to the listeners
+	void UpdatePrice(Price<T>& price);
+
+private:
+	// Bootstrap the zero rate of one tenor given the zero rates of the shorter tenors
+	void Bootstrap(int index);
+
+    map<string, DiscountCurve> curves;					// a map of {curve name -> curve}
+    vector<ServiceListener<DiscountCurve>*> listeners;	// all listeners on CurveService
+    CurveToPricingListener<T>* listener;				// a pointer to a listener to PricingService
+	string curveName;									// name of the curve
+	date settlementDate;								// settlement date of the curve
+	vector<T> bonds;									// on-the-run bond of each tenor
+	unordered_map<string, int> tenorIndices;			// a map of {product identifier -> tenor index}
+	vector<BondAnalytics> analytics;					// analytics of each tenor
+	vector<double> mids;								// latest mid of each tenor
+	vector<double> parYields;							// latest yield of each tenor
+	vector<bool> priced;								// whether a tenor has received a mid
+	int pricedCount;									// # of tenors with a mid
+	vector<vector<double>> times;						// cash flow times of each tenor in years
+	vector<vector<int>> lowerKnots;						// lower curve knot of each cash flow time
+	vector<vector<int>> upperKnots;						// upper curve knot of each cash flow time
+	vector<vector<double>> knotWeights;					// interpolation weight of each cash flow time
+};
+
+
+
+
+/* Listener of CurveService to PricingService */
+template<typename T>
+class CurveToPricingListener : public ServiceListener<Price<T>>
+{
+public:
+	// ctor
+    CurveToPricingListener(CurveService<T>* _service);
+
+    // Listener callback to process an add event to CurveService
+    void ProcessAdd(Price<T>& _data);
+
+    // Listener callback to process a remove event to CurveService
+    void ProcessRemove(Price<T>& _data);
+
+    // Listener callback to process an update event to CurveService
+    void ProcessUpdate(Price<T>& _data);
+
+private:
+    CurveService<T>* service;				// a pointer to CurveService
+};
+
+
+
+
+#endif
@@ -15,6 +15,7 @@
 #include <chrono>
 #include <map>
 #include <unordered_map>
+#include <algorithm>
 using namespace std;
 
 
@@ -40,6 +41,12 @@ const T& ExecutionOrder<T>::GetProduct() const
     return product;
 }
 
+template<typename T>
+PricingSide ExecutionOrder<T>::GetSide() const
+{
+    return side;
+}
+
 template<typename T>
 const string& ExecutionOrder<T>::GetOrderId() const
 {
@@ -85,7 +92,7 @@ bool ExecutionOrder<T>::IsChildOrder() const
 template<typename T>
 vector<string> ExecutionOrder<T>::GetExecutionOrder_eo2s() const
 {
-	return GetExecutionOrder_eo2s<T>(product, side, orderId, orderType, price, visibleQuantity, hiddenQuantity, parentOrderId, isChildOrder); 
+	return ::GetExecutionOrder_eo2s<T>(product, side, orderId, orderType, price, visibleQuantity, hiddenQuantity, parentOrderId, isChildOrder); 
 }
 
 
@@ -114,6 +121,15 @@ AlgoExecutionService<T>::AlgoExecutionService()
     listener = new AlgoExecutionToMarketDataListener<T>(this);
     minSpread = 1.0 / 128.0;
     count = 0;
+    alternationPeriod = 1;
+	executionListener = new AlgoExecutionToExecutionListener<T>(this);
+	timerListener = new AlgoExecutionToTimerListener<T>(this);
+	timers = nullptr;
+	clipTimeout = 60000;
+	expiredCount = 0;
+	
+	// Intraday volume in 13 half hour buckets, heavier at the open and the close
+	SetVolumeProfile({ 0.12, 0.09, 0.07, 0.06, 0.06, 0.05, 0.05, 0.05, 0.06, 0.07, 0.08, 0.10, 0.14 });
 }
 
 template<typename T>
@@ -127,7 +143,7 @@ void AlgoExecutionService<T>::OnMessage(AlgoExecution<T>& data)
 {
 	ExecutionOrder<T>* executionOrder = data.GetExecutionOrder();
 	T curr_product = executionOrder->GetProduct();
-	string productId = curr_product.GetParentOrderId();
+	string productId = curr_product.GetProductId();
 	algoExecutions[productId] = data;
 }
 
@@ -153,10 +169,10 @@ template<typename T>
 void AlgoExecutionService<T>::ExecuteOrder(OrderBook<T>& orderBook)
 {
 	T curr_product = orderBook.GetProduct();
-	string productId = product.GetProductId();
+	string productId = curr_product.GetProductId();
 	string orderId = GetTime();		// Use current timestamp as order ID
 	
-	BidOffer bidOffer = orderBook.GetBidOffer();
+	BidOffer bidOffer = orderBook.GetBestBidOffer();
 	Order bidOrder = bidOffer.GetBidOrder();
 	double bidPrice = bidOrder.GetPrice();
 	long bidQuantity = bidOrder.GetQuantity();
@@ -164,30 +180,254 @@ void AlgoExecutionService<T>::ExecuteOrder(OrderBook<T>& orderBook)
 	double offerPrice = offerOrder.GetPrice();
 	long offerQuantity = offerOrder.GetQuantity();
 	
-	// Only aggress at the tightest spread (i.e. 1/128th)
-	if (offerPrice - bidPrice == spread)
+	// Only aggress at the tightest spread (i.e. 1/128th) or tighter
+	if (offerPrice - bidPrice <= minSpread)
 	{
-		// Alternate between bid and offer
-		if (count % 2 == 0)
-		{
-			double price = bidPrice;
-			long quantity = bidQuantity;
-			PricingSide side = BID;
-		}
-		else
-		{
-			double price = offerPrice;
-			long quantity = offerQuantity;
-			PricingSide side = OFFER;
-		}
+		// Alternate between bid and offer every alternation period
+		PricingSide side = ((count / alternationPeriod) % 2 == 0) ? BID : OFFER;
+		double price = (side == BID) ? bidPrice : offerPrice;
+		long quantity = (side == BID) ? bidQuantity : offerQuantity;
 		count++;
 		
-        AlgoExecution<T> algoExecution(product, side, orderId, MARKET, price, quantity, 0, "", false);
-        algoExecutions[productId] = algoExecution;
+		AlgoExecution<T> algoExecution(curr_product, side, orderId, MARKET, price, quantity, 0, "", false);
+		algoExecutions[productId] = algoExecution;
+		
+		for (typename vector<ServiceListener<AlgoExecution<T>>*>::iterator ae_it = listeners.begin(); ae_it != listeners.end(); ae_it++)
+			(*ae_it)->ProcessAdd(algoExecution);
+	}
+}
+
+template<typename T>
+void AlgoExecutionService<T>::SetMinSpread(double _minSpread)
+{
+	minSpread = _minSpread;
+}
+
+template<typename T>
+void AlgoExecutionService<T>::SetAlternationPeriod(int _alternationPeriod)
+{
+	if (_alternationPeriod > 0) alternationPeriod = _alternationPeriod;
+}
+
+
+
+
+template<typename T>
+AlgoExecutionToExecutionListener<T>* AlgoExecutionService<T>::GetExecutionListener()
+{
+	return executionListener;
+}
+
+template<typename T>
+bool AlgoExecutionService<T>::SubmitParentOrder(const T& product, PricingSide side, string parentOrderId, long quantity, double limitPrice,
+	SlicingStrategy strategy, long startTime, long duration, int sliceCount)
+{
+	if (timers == nullptr || quantity <= 0 || sliceCount <= 0 || parentIndices.find(parentOrderId) != parentIndices.end()) return false;
+	
+	string productId = product.GetProductId();
+	unordered_map<string, int>::iterator product_it = productIndices.find(productId);
+	if (product_it == productIndices.end())
+	{
+		product_it = productIndices.insert(make_pair(productId, (int)products.size())).first;
+		products.push_back(product);
+	}
+	
+	// Reuse a free record if there is one
+	int parentIndex;
+	if (!freeParents.empty())
+	{
+		parentIndex = freeParents.back();
+		freeParents.pop_back();
+		parentOrderIds[parentIndex] = parentOrderId;
+	}
+	else
+	{
+		parentIndex = parentOrders.size();
+		parentOrders.push_back(ParentOrderState());
+		parentOrderIds.push_back(parentOrderId);
+	}
+	parentIndices[parentOrderId] = parentIndex;
+	
+	ParentOrderState& parent = parentOrders[parentIndex];
+	parent.productIndex = product_it->second;
+	parent.side = side;
+	parent.strategy = strategy;
+	parent.sliceCount = sliceCount;
+	parent.nextSlice = 0;
+	parent.totalQuantity = quantity;
+	parent.sentQuantity = 0;
+	parent.filledQuantity = 0;
+	parent.limitPrice = limitPrice;
+	parent.startTime = startTime;
+	parent.interval = max(duration / sliceCount, 1L);
+	parent.clipTime = -1;
+	parent.timerId = timers->Schedule(startTime, timerListener, parentIndex);
+	if (parent.timerId < 0)
+	{
+		// No room on the wheel, reject the parent
+		parentIndices.erase(parentOrderId);
+		freeParents.push_back(parentIndex);
+		return false;
+	}
+	return true;
+}
+
+template<typename T>
+void AlgoExecutionService<T>::SetVolumeProfile(const vector<double>& _volumeProfile)
+{
+	double totalVolume = 0.0;
+	for (vector<double>::const_iterator it = _volumeProfile.begin(); it != _volumeProfile.end(); it++)
+		totalVolume += *it;
+	
+	cumulativeVolumes = vector<double>(1, 0.0);
+	for (vector<double>::const_iterator it = _volumeProfile.begin(); it != _volumeProfile.end(); it++)
+		cumulativeVolumes.push_back(cumulativeVolumes.back() + *it / totalVolume);
+}
+
+template<typename T>
+void AlgoExecutionService<T>::SetTimerWheel(TimerWheel* _timers)
+{
+	timers = _timers;
+}
+
+template<typename T>
+void AlgoExecutionService<T>::SetClipTimeout(long _clipTimeout)
+{
+	clipTimeout = _clipTimeout;
+}
+
+template<typename T>
+void AlgoExecutionService<T>::SendSlice(int parentIndex)
+{
+	ParentOrderState& parent = parentOrders[parentIndex];
+	parent.timerId = -1;
+	long remainingQuantity = parent.totalQuantity - parent.sentQuantity;
+	
+	// Expire what is left once the schedule is over, or once the clip of an iceberg has waited too long to fill
+	// (sent again or not, as no venue could take its residual)
+	bool clipPending = parent.filledQuantity < parent.sentQuantity;
+	bool expired = (parent.strategy == ICEBERG) ? parent.clipTime >= 0 && timers->GetTime() - parent.clipTime >= clipTimeout
+		: parent.nextSlice >= parent.sliceCount;
+	if (expired)
+	{
+		expiredCount++;
+		CompleteParentOrder(parentIndex);
+		return;
+	}
+	
+	// Size the slice off the schedule
+	long quantity = 0;
+	if (parent.strategy == TWAP)
+	{
+		long targetQuantity = parent.totalQuantity * (parent.nextSlice + 1) / parent.sliceCount;
+		quantity = targetQuantity - parent.sentQuantity;
+	}
+	if (parent.strategy == VWAP)
+	{
+		double volumeFraction = GetVolumeFraction((double)(parent.nextSlice + 1) / parent.sliceCount);
+		long targetQuantity = (parent.nextSlice + 1 == parent.sliceCount) ? parent.totalQuantity : (long)(parent.totalQuantity * volumeFraction);
+		quantity = targetQuantity - parent.sentQuantity;
+	}
+	if (parent.strategy == ICEBERG)
+	{
+		// Only show the next clip once the last one has filled
+		long clipQuantity = (parent.totalQuantity + parent.sliceCount - 1) / parent.sliceCount;
+		if (!clipPending) quantity = min(clipQuantity, remainingQuantity);
+	}
+	quantity = min(quantity, remainingQuantity);
+	
+	// A scheduled slice is used up even with nothing to send (a parent smaller than its # of slices, or a VWAP
+	// target repeated by rounding), while an iceberg only counts the clips it shows
+	int slice = parent.nextSlice;
+	if (parent.strategy != ICEBERG || quantity > 0) parent.nextSlice++;
+	
+	if (quantity > 0)
+	{
+		const T& product = products[parent.productIndex];
+		const string& parentOrderId = parentOrderIds[parentIndex];
+		string orderId = parentOrderId + "-" + to_string(slice);
+		OrderType orderType = (parent.limitPrice > 0.0) ? LIMIT : MARKET;
+		parent.sentQuantity += quantity;
+		if (parent.clipTime < 0) parent.clipTime = timers->GetTime();
 		
-        for (vector<ServiceListener<AlgoExecution<T>>*>::iterator ae_it = listeners.begin(); ae_it != listeners.end(); ae_it++)
-            (*ae_it)->ProcessAdd(_algoExecution);
+		AlgoExecution<T> algoExecution(product, parent.side, orderId, orderType, parent.limitPrice, quantity, 0, parentOrderId, true);
+		algoExecutions[product.GetProductId()] = algoExecution;
+		for (typename vector<ServiceListener<AlgoExecution<T>>*>::iterator ae_it = listeners.begin(); ae_it != listeners.end(); ae_it++)
+			(*ae_it)->ProcessAdd(algoExecution);
 	}
+	
+	// The listeners may have filled the slice, which completes the parent and frees its record
+	if (parentIndex >= (int)parentOrders.size() || parentIndices.find(parentOrderIds[parentIndex]) == parentIndices.end()) return;
+	ParentOrderState& working = parentOrders[parentIndex];
+	if (working.timerId >= 0) return;
+	
+	// Schedule the next slice, or the end of the schedule after the last one (an iceberg checks on its clip until it fills)
+	long nextTime = (working.strategy == ICEBERG) ? timers->GetTime() + working.interval : working.startTime + working.nextSlice * working.interval;
+	working.timerId = timers->Schedule(nextTime, timerListener, parentIndex);
+}
+
+template<typename T>
+void AlgoExecutionService<T>::ProcessFill(ExecutionOrder<T>& childOrder)
+{
+	if (!childOrder.IsChildOrder()) return;
+	unordered_map<string, int>::iterator it = parentIndices.find(childOrder.GetParentOrderId());
+	if (it == parentIndices.end()) return;
+	
+	ParentOrderState& parent = parentOrders[it->second];
+	parent.filledQuantity += childOrder.GetVisibleQuantity() + childOrder.GetHiddenQuantity();
+	if (parent.filledQuantity >= parent.sentQuantity) parent.clipTime = -1;		// the clip has filled
+	if (parent.filledQuantity >= parent.totalQuantity) CompleteParentOrder(it->second);
+}
+
+template<typename T>
+void AlgoExecutionService<T>::ProcessResidual(ExecutionOrder<T>& childOrder)
+{
+	if (!childOrder.IsChildOrder()) return;
+	unordered_map<string, int>::iterator it = parentIndices.find(childOrder.GetParentOrderId());
+	if (it == parentIndices.end()) return;
+	
+	// The next slice sizes off the quantity sent, so it picks the residual up (a clip keeps its time)
+	ParentOrderState& parent = parentOrders[it->second];
+	parent.sentQuantity -= min(childOrder.GetVisibleQuantity() + childOrder.GetHiddenQuantity(), parent.sentQuantity - parent.filledQuantity);
+}
+
+template<typename T>
+const ParentOrderState* AlgoExecutionService<T>::GetParentOrderState(const string& parentOrderId) const
+{
+	unordered_map<string, int>::const_iterator it = parentIndices.find(parentOrderId);
+	if (it == parentIndices.end()) return nullptr;
+	return &parentOrders[it->second];
+}
+
+template<typename T>
+int AlgoExecutionService<T>::GetParentOrderCount() const
+{
+	return parentIndices.size();
+}
+
+template<typename T>
+long AlgoExecutionService<T>::GetExpiredParentCount() const
+{
+	return expiredCount;
+}
+
+template<typename T>
+double AlgoExecutionService<T>::GetVolumeFraction(double timeFraction) const
+{
+	int bucketCount = cumulativeVolumes.size() - 1;
+	double position = min(max(timeFraction, 0.0), 1.0) * bucketCount;
+	int bucket = min((int)position, bucketCount - 1);
+	return cumulativeVolumes[bucket] + (position - bucket) * (cumulativeVolumes[bucket + 1] - cumulativeVolumes[bucket]);
+}
+
+template<typename T>
+void AlgoExecutionService<T>::CompleteParentOrder(int parentIndex)
+{
+	ParentOrderState& parent = parentOrders[parentIndex];
+	timers->Cancel(parent.timerId);
+	parent.timerId = -1;
+	parentIndices.erase(parentOrderIds[parentIndex]);
+	freeParents.push_back(parentIndex);
 }
 
 
@@ -205,6 +445,87 @@ void AlgoExecutionToMarketDataListener<T>::ProcessAdd(OrderBook<T>& _data)
 	service->ExecuteOrder(_data);
 }
 
+template<typename T>
+void AlgoExecutionToMarketDataListener<T>::ProcessRemove(OrderBook<T>& _data)
+{
+}
+
+template<typename T>
+void AlgoExecutionToMarketDataListener<T>::ProcessUpdate(OrderBook<T>& _data)
+{
+}
+
+
+
+
+SimulatedVenue::SimulatedVenue(Market _market) :
+	market(_market), acknowledgedCount(0), filledQuantity(0)
+{
+}
+
+Market SimulatedVenue::GetMarket() const
+{
+	return market;
+}
+
+long SimulatedVenue::Execute(const string& orderId, PricingSide side, double price, long quantity)
+{
+	acknowledgedCount++;
+	filledQuantity += quantity;
+	return quantity;
+}
+
+long SimulatedVenue::GetAcknowledgedCount() const
+{
+	return acknowledgedCount;
+}
+
+long SimulatedVenue::GetFilledQuantity() const
+{
+	return filledQuantity;
+}
+
+
+
+
+template<typename T>
+AlgoExecutionToExecutionListener<T>::AlgoExecutionToExecutionListener(AlgoExecutionService<T>* _service)
+{
+	service = _service;
+}
+
+template<typename T>
+void AlgoExecutionToExecutionListener<T>::ProcessAdd(ExecutionOrder<T>& _data)
+{
+	service->ProcessFill(_data);
+}
+
+template<typename T>
+void AlgoExecutionToExecutionListener<T>::ProcessRemove(ExecutionOrder<T>& _data)
+{
+	service->ProcessResidual(_data);
+}
+
+template<typename T>
+void AlgoExecutionToExecutionListener<T>::ProcessUpdate(ExecutionOrder<T>& _data)
+{
+}
+
+
+
+
+template<typename T>
+AlgoExecutionToTimerListener<T>::AlgoExecutionToTimerListener(AlgoExecutionService<T>* _service)
+{
+	service = _service;
+}
+
+template<typename T>
+void AlgoExecutionToTimerListener<T>::ProcessTimeout(long data)
+{
+	service->SendSlice((int)data);
+}
+
 
 
 
@@ -214,6 +535,11 @@ ExecutionService<T>::ExecutionService()
     executionOrders = map<string, ExecutionOrder<T>>();
     listeners = vector<ServiceListener<ExecutionOrder<T>>*>();
     listener = new ExecutionToAlgoExecutionListener<T>(this);
+	marketDataService = nullptr;
+	for (int i = 0; i < MARKET_COUNT; i++)
+		venues.push_back(SimulatedVenue(Market(i)));
+	unroutedCount = 0;
+	unroutedQuantity = 0;
 }
 
 template<typename T>
@@ -254,9 +580,119 @@ void ExecutionService<T>::ExecuteOrder(ExecutionOrder<T>& executionOrder)
 	T curr_product = executionOrder.GetProduct();
     string productId = curr_product.GetProductId();
     executionOrders[productId] = executionOrder;
-    
-    for (vector<ServiceListener<ExecutionOrder<T>>*>::iterator eo_it = listeners.begin(); eo_it != listeners.end(); eo_it++)
-        (*eo_it)->ProcessAdd(executionOrder);
+	
+	VenueAllocation allocations[MARKET_COUNT];
+	int allocationCount = RouteOrder(executionOrder, allocations);
+	if (allocationCount < 0)
+	{
+		// No venue books for the product: a market child has no price to fill at, so reject it
+		// (its parent expires at the end of its schedule), and publish any other order whole
+		if (executionOrder.IsChildOrder() && executionOrder.GetOrderType() == MARKET) return;
+		for (typename vector<ServiceListener<ExecutionOrder<T>>*>::iterator eo_it = listeners.begin(); eo_it != listeners.end(); eo_it++)
+			(*eo_it)->ProcessAdd(executionOrder);
+		return;
+	}
+	
+	// Send a child order to each venue, take its fill off the venue's size and publish it
+	PricingSide side = executionOrder.GetSide();
+	string orderId = executionOrder.GetOrderId();
+	string parentOrderId = executionOrder.IsChildOrder() ? executionOrder.GetParentOrderId() : orderId;	// fills belong to the root parent
+	long residualQuantity = executionOrder.GetVisibleQuantity() + executionOrder.GetHiddenQuantity();
+	for (int i = 0; i < allocationCount; i++)
+	{
+		string childOrderId = orderId + "-" + GetMarket_m2s(allocations[i].venue);
+		long filledQuantity = venues[allocations[i].venue].Execute(childOrderId, side, allocations[i].price, allocations[i].quantity);
+		if (filledQuantity <= 0) continue;
+		residualQuantity -= filledQuantity;
+		marketDataService->OnVenueFill(productId, allocations[i].venue, side, filledQuantity);
+		
+		ExecutionOrder<T> childOrder(curr_product, side, childOrderId, IOC, allocations[i].price, filledQuantity, 0, parentOrderId, true);
+		for (typename vector<ServiceListener<ExecutionOrder<T>>*>::iterator eo_it = listeners.begin(); eo_it != listeners.end(); eo_it++)
+			(*eo_it)->ProcessAdd(childOrder);
+	}
+	if (residualQuantity <= 0) return;
+	
+	// Report what no venue could take, which the parent of a child order sends again
+	unroutedCount++;
+	unroutedQuantity += residualQuantity;
+	ExecutionOrder<T> residualOrder(curr_product, side, orderId, executionOrder.GetOrderType(), executionOrder.GetPrice(), residualQuantity, 0,
+		executionOrder.GetParentOrderId(), executionOrder.IsChildOrder());
+	for (typename vector<ServiceListener<ExecutionOrder<T>>*>::iterator eo_it = listeners.begin(); eo_it != listeners.end(); eo_it++)
+		(*eo_it)->ProcessRemove(residualOrder);
+}
+
+template<typename T>
+void ExecutionService<T>::SetMarketDataService(MarketDataService<T>* _marketDataService)
+{
+	marketDataService = _marketDataService;
+}
+
+template<typename T>
+int ExecutionService<T>::RouteOrder(const ExecutionOrder<T>& executionOrder, VenueAllocation* allocations) const
+{
+	if (marketDataService == nullptr) return -1;
+	const VenueTopOfBook* top = marketDataService->GetVenueTopOfBook(executionOrder.GetProduct().GetProductId());
+	if (top == nullptr) return -1;
+	
+	// Execute against the bids of every venue for a BID order, and against the offers for an OFFER order
+	bool againstBids = executionOrder.GetSide() == BID;
+	const double* prices = againstBids ? top->bidPrices : top->offerPrices;
+	const long* quantities = againstBids ? top->bidQuantities : top->offerQuantities;
+	bool isLimit = executionOrder.GetOrderType() == LIMIT;
+	double limitPrice = executionOrder.GetPrice();
+	
+	// Rank the venues with size, best price first and larger size first at the same price (insertion sort of MARKET_COUNT)
+	int ranked[MARKET_COUNT];
+	int rankedCount = 0;
+	for (int v = 0; v < MARKET_COUNT; v++)
+	{
+		if (quantities[v] <= 0) continue;
+		if (isLimit && (againstBids ? prices[v] < limitPrice : prices[v] > limitPrice)) continue;
+		
+		int i = rankedCount++;
+		while (i > 0)
+		{
+			int w = ranked[i - 1];
+			bool better = againstBids ? prices[v] > prices[w] : prices[v] < prices[w];
+			if (!better && !(prices[v] == prices[w] && quantities[v] > quantities[w])) break;
+			ranked[i] = w;
+			i--;
+		}
+		ranked[i] = v;
+	}
+	
+	// Walk the venues until the order is filled
+	long remainingQuantity = executionOrder.GetVisibleQuantity() + executionOrder.GetHiddenQuantity();
+	int allocationCount = 0;
+	for (int i = 0; i < rankedCount && remainingQuantity > 0; i++)
+	{
+		int v = ranked[i];
+		long quantity = min(remainingQuantity, quantities[v]);
+		allocations[allocationCount].venue = Market(v);
+		allocations[allocationCount].price = prices[v];
+		allocations[allocationCount].quantity = quantity;
+		allocationCount++;
+		remainingQuantity -= quantity;
+	}
+	return allocationCount;
+}
+
+template<typename T>
+const SimulatedVenue& ExecutionService<T>::GetVenue(Market market) const
+{
+	return venues[market];
+}
+
+template<typename T>
+long ExecutionService<T>::GetUnroutedCount() const
+{
+	return unroutedCount;
+}
+
+template<typename T>
+long ExecutionService<T>::GetUnroutedQuantity() const
+{
+	return unroutedQuantity;
 }
 
 
@@ -276,3 +712,13 @@ void ExecutionToAlgoExecutionListener<T>::ProcessAdd(AlgoExecution<T>& _data)
     service->ExecuteOrder(*executionOrder);
 }
 
+template<typename T>
+void ExecutionToAlgoExecutionListener<T>::ProcessRemove(AlgoExecution<T>& _data)
+{
+}
+
+template<typename T>
+void ExecutionToAlgoExecutionListener<T>::ProcessUpdate(AlgoExecution<T>& _data)
+{
+}
+
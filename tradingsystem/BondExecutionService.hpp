@@ -9,6 +9,7 @@
 #include "soa.hpp"
 #include "my functions.hpp"
 #include "BondMarketDataService.hpp"
+#include "TimerWheel.hpp"
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -40,6 +41,9 @@ public:
     // Get the product
     const T& GetProduct() const;
 
+    // Get the side of the book the order executes against
+    PricingSide GetSide() const;
+
     // Get the order ID
     const string& GetOrderId() const;
 
@@ -100,13 +104,52 @@ private:
 
 
 
+/**
+ * Fill state of a parent order being sliced into child orders, one compact record per parent.
+ */
+struct ParentOrderState
+{
+	int productIndex;					// index of the product in the product table of the algo
+	PricingSide side;					// side of the book the children execute against
+	SlicingStrategy strategy;			// TWAP, VWAP or ICEBERG
+	int sliceCount;						// # of slices (# of clips for an iceberg)
+	int nextSlice;						// next slice to send
+	long totalQuantity;					// parent quantity
+	long sentQuantity;					// quantity sent in child orders
+	long filledQuantity;				// quantity filled on the child orders
+	double limitPrice;					// limit price of the children (0 for market children)
+	long startTime;						// time of the first slice in ms
+	long interval;						// time between two slices in ms
+	long clipTime;						// time the working clip of an iceberg was first sent in ms (-1 if none)
+	long timerId;						// timer of the next slice, or of the end of the schedule (-1 if none)
+};
+
+
+
+
 /* Listener of AlgoExecution on MarketDataService */
 template<typename T>
 class AlgoExecutionToMarketDataListener;
 
+/* Listener of AlgoExecution on ExecutionService (fills of the child orders) */
+template<typename T>
+class AlgoExecutionToExecutionListener;
+
+/* Listener of AlgoExecution on its slice timers */
+template<typename T>
+class AlgoExecutionToTimerListener;
+
 
 
-/* AlgoExecutionService*/
+/**
+ * Algo Execution Service aggressing the top of the book, and slicing parent orders into child orders over time.
+ * A parent order is cut into slices on a TWAP (equal slices at equal intervals), VWAP (slices following
+ * the intraday volume profile) or ICEBERG (one clip at a time, the next clip once the last one has filled)
+ * schedule. The next slice of every parent sits on the shared timer wheel, and the fill state of the parents is kept
+ * in a table of compact records reused as parents complete, so thousands of parents can work at once.
+ * Keyed on product identifier.
+ * Type T is the product type.
+ */
 template<typename T>
 class AlgoExecutionService : public Service<string, AlgoExecution<T>>
 {
@@ -129,17 +172,78 @@ public:
 	// Get the listener on MarketDataService
     AlgoExecutionToMarketDataListener<T>* GetListener();
 	
-	// Aggress the top of the book, alternating between bid and offer, 
+	// Aggress the top of the book, alternating between bid and offer every alternation period of orders,
 	// and only aggressing when the spread is at its tightest (i.e. 1/128th)
 	// to reduce the cost of crossing the spread
     void ExecuteOrder(OrderBook<T>& orderBook);
 	
+	// Set the widest spread ExecuteOrder aggresses at
+	void SetMinSpread(double _minSpread);
+	
+	// Set the # of orders ExecuteOrder sends on a side before it switches sides (1 by default)
+	void SetAlternationPeriod(int _alternationPeriod);
+	
+	// Get the listener on ExecutionService
+	AlgoExecutionToExecutionListener<T>* GetExecutionListener();
+	
+	// Submit a parent order sliced into sliceCount child orders over [startTime, startTime + duration) ms, expiring
+	// what is left unfilled at startTime + duration (a limit price of 0 sends market children; false if the parent
+	// order identifier is already working or there is no room on the wheel)
+	bool SubmitParentOrder(const T& product, PricingSide side, string parentOrderId, long quantity, double limitPrice,
+		SlicingStrategy strategy, long startTime, long duration, int sliceCount);
+	
+	// Set the intraday volume profile VWAP slices follow (relative volume of equal time buckets)
+	void SetVolumeProfile(const vector<double>& _volumeProfile);
+	
+	// Set the timer wheel the next slices are scheduled on, driven by the owner's clock in ms
+	void SetTimerWheel(TimerWheel* _timers);
+	
+	// Set how long an iceberg waits for a clip to fill before it expires, in ms (60s by default)
+	void SetClipTimeout(long _clipTimeout);
+	
+	// Send the next slice of a parent order, or expire it once its schedule is over or its clip has timed out
+	void SendSlice(int parentIndex);
+	
+	// Record the fill of a child order against its parent
+	void ProcessFill(ExecutionOrder<T>& childOrder);
+	
+	// Hand the unrouted residual of a child order back to its parent, to be sent again with the next slice
+	void ProcessResidual(ExecutionOrder<T>& childOrder);
+	
+	// Get the fill state of a working parent order (nullptr if it is unknown or complete)
+	const ParentOrderState* GetParentOrderState(const string& parentOrderId) const;
+	
+	// Get the # of working parent orders
+	int GetParentOrderCount() const;
+	
+	// Get the # of parent orders expired before they filled
+	long GetExpiredParentCount() const;
+	
 private:
+	// Get the fraction of the day's volume traded by a fraction of the time, off the volume profile
+	double GetVolumeFraction(double timeFraction) const;
+	
+	// Complete a parent order and free its record
+	void CompleteParentOrder(int parentIndex);
+	
     map<string, AlgoExecution<T>> algoExecutions;			// a map of {order identifier -> algo execution}
     vector<ServiceListener<AlgoExecution<T>>*> listeners;	// all listeners on AlgoExecutionService
     AlgoExecutionToMarketDataListener<T>* listener;			// a pointer to a listener on MarketDataService
-    double minSpread;										// tightest spread (i.e. 1/128th)
+    AlgoExecutionToExecutionListener<T>* executionListener;	// a pointer to a listener on ExecutionService
+    AlgoExecutionToTimerListener<T>* timerListener;			// a pointer to the listener on the slice timers
+    double minSpread;										// widest spread aggressed at (1/128th by default)
     int count;												// algo execution count
+    int alternationPeriod;									// # of orders sent on a side before switching sides
+	TimerWheel* timers;										// a pointer to the timer wheel of the next slices
+	vector<ParentOrderState> parentOrders;					// fill state of each parent record
+	vector<string> parentOrderIds;							// parent order identifier of each parent record
+	unordered_map<string, int> parentIndices;				// a map of {parent order identifier -> parent record}
+	vector<int> freeParents;								// parent records free for reuse
+	vector<T> products;										// product table of the parents
+	unordered_map<string, int> productIndices;				// a map of {product identifier -> index in products}
+	vector<double> cumulativeVolumes;						// cumulative volume profile, normalized to 1
+	long clipTimeout;										// time an iceberg waits for a clip to fill in ms
+	long expiredCount;										// # of parent orders expired
 };
 
 
@@ -169,6 +273,96 @@ private:
 
 
 
+/**
+ * Quantity routed to one venue at the venue's top of book price.
+ */
+struct VenueAllocation
+{
+	Market venue;
+	double price;
+	long quantity;
+};
+
+
+
+
+/**
+ * Local simulation of a venue, acknowledging every child order routed to it and filling it in full
+ * at the routed price (the router only sends what the venue displays, less what it has already filled).
+ */
+class SimulatedVenue
+{
+
+public:
+	// default ctor
+	SimulatedVenue() = default;
+
+	// ctor for a venue
+	SimulatedVenue(Market _market);
+
+	// Get the venue
+	Market GetMarket() const;
+
+	// Acknowledge a child order and fill it, returning the filled quantity
+	long Execute(const string& orderId, PricingSide side, double price, long quantity);
+
+	// Get the # of orders acknowledged
+	long GetAcknowledgedCount() const;
+
+	// Get the total quantity filled
+	long GetFilledQuantity() const;
+
+private:
+	Market market;
+	long acknowledgedCount;
+	long filledQuantity;
+};
+
+
+
+
+/* Listener of AlgoExecution on ExecutionService (fills of the child orders) */
+template<typename T>
+class AlgoExecutionToExecutionListener : public ServiceListener<ExecutionOrder<T>>
+{
+public:
+    // ctor
+	AlgoExecutionToExecutionListener(AlgoExecutionService<T>* _service);
+	
+    // Listener callback to process an add event to AlgoExecutionService
+    void ProcessAdd(ExecutionOrder<T>& _data);
+	
+	// Listener callback to process a remove event to AlgoExecutionService
+    void ProcessRemove(ExecutionOrder<T>& _data);
+    
+	// Listener callback to process an update event to AlgoExecutionService
+	void ProcessUpdate(ExecutionOrder<T>& _data);
+	
+private:
+    AlgoExecutionService<T>* service;						// a pointer to AlgoExecutionService
+};
+
+
+
+
+/* Listener of AlgoExecution on its slice timers */
+template<typename T>
+class AlgoExecutionToTimerListener : public TimerListener
+{
+public:
+    // ctor
+	AlgoExecutionToTimerListener(AlgoExecutionService<T>* _service);
+	
+	// Timer callback sending the next slice of a parent order
+	void ProcessTimeout(long data);
+	
+private:
+    AlgoExecutionService<T>* service;						// a pointer to AlgoExecutionService
+};
+
+
+
+
 /* Listener of ExecutionService To AlgoExecutionService */
 template<typename T>
 class ExecutionToAlgoExecutionListener;
@@ -176,7 +370,18 @@ class ExecutionToAlgoExecutionListener;
 
 
 
-/* ExecutionService */
+/**
+ * Execution Service routing execution orders across the venues (BROKERTEC, ESPEED and CME).
+ * An order is split over the venues best price first, each taking up to its displayed size,
+ * off the top of book MarketDataService precomputes per venue, so routing is a few comparisons
+ * on one record. Each slice is a child order filled by the simulated venue and published to the listeners,
+ * and the fill is taken off the venue's displayed size until its next book. What no venue can take is
+ * published to the listeners as removed, so that the parent of a child order sends it again.
+ * Orders on products with no venue books are published whole, as before, except market child orders
+ * of a parent, which have no price to fill at and are rejected.
+ * Keyed on product identifier.
+ * Type T is the product type.
+ */
 template<typename T>
 class ExecutionService : public Service<string, ExecutionOrder<T>>
 {
@@ -203,10 +408,30 @@ public:
 	// for the right side you are executing against 
     void ExecuteOrder(ExecutionOrder<T>& executionOrder);
 	
+	// Set the market data service whose venue top of book the router reads and fills
+	void SetMarketDataService(MarketDataService<T>* _marketDataService);
+	
+	// Split an order across the venues, best price first, into at most MARKET_COUNT allocations
+	// (returns the # of allocations, or -1 if there is no venue book for the product)
+	int RouteOrder(const ExecutionOrder<T>& executionOrder, VenueAllocation* allocations) const;
+	
+	// Get the simulated venue of a market
+	const SimulatedVenue& GetVenue(Market market) const;
+	
+	// Get the # of orders with a residual no venue could take
+	long GetUnroutedCount() const;
+	
+	// Get the total quantity no venue could take
+	long GetUnroutedQuantity() const;
+	
 private:
     map<string, ExecutionOrder<T> > executionOrders;			// a map of {execution order identifier -> execution order}
     vector<ServiceListener<ExecutionOrder<T>>*> listeners;		// all listeners on ExecutionService
     ExecutionToAlgoExecutionListener<T>* listener;				// a pointer to a listener to AlgoExecutionService
+	MarketDataService<T>* marketDataService;					// a pointer to the MarketDataService holding the venue books
+	vector<SimulatedVenue> venues;								// simulated venue of each market
+	long unroutedCount;											// # of orders with a residual no venue could take
+	long unroutedQuantity;										// total quantity no venue could take
 };
 
 
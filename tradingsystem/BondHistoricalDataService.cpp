@@ -6,6 +6,14 @@
  */
  
 #include "BondHistoricalDataService.hpp"
+#include "BondPositionService.hpp"
+#include "BondRiskService.hpp"
+#include "BondExecutionService.hpp"
+#include "BondStreamingService.hpp"
+#include "BondInquiryService.hpp"
+#include "BondScenarioService.hpp"
+#include "BondVaRService.hpp"
+#include "BondMarketDataService.hpp"
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -15,6 +23,7 @@
 #include <chrono>
 #include <map>
 #include <unordered_map>
+#include <type_traits>
 using namespace std;
 
 
@@ -76,7 +85,8 @@ HistoricalDataType HistoricalDataService<V>::GetHistoricalDataType() const
 template<typename V>
 void HistoricalDataService<V>::PersistData(string persistKey, const V& data)
 {
-	connector->Publish(data);
+	V record = data;
+	connector->Publish(record);
 }
 
 
@@ -91,17 +101,25 @@ HistoricalDataConnector<V>::HistoricalDataConnector(HistoricalDataService<V>* _s
 template<typename V>
 void HistoricalDataConnector<V>::Publish(V& _data)
 {
-    HistoricalDataType type = service->GetHistoricalDataType();
-	if (type == POSITION) 
-		OutputDataStream("positions.txt", data.GetPosition_p2s());			// output to positions.txt
-	if (type == RISK) 
-		OutputDataStream("risk.txt", data.GetPV01_pv2s());					// output to risk.txt
-	if (type == EXECUTION) 
-		OutputDataStream("executions.txt", data.GetExecutionOrder_eo2s());	// output to executions.txt
-	if (type == STREAMING) 
-		OutputDataStream("streaming.txt", data.GetPriceStream_ps2s());		// output to streaming.txt
-	if (type == INQUIRY) 
-		OutputDataStream("allinquiries.txt", data.GetPosition_p2s());		// output to allinquiries.txt
+	// Each data type has its own file and its own conversion to strings
+	if constexpr (is_same<V, Position<Bond>>::value)
+		OutputDataStream("positions.txt", _data.GetPositions_p2s());			// output to positions.txt
+	if constexpr (is_same<V, PV01<Bond>>::value)
+		OutputDataStream("risk.txt", _data.GetPV01_pv2s());					// output to risk.txt
+	if constexpr (is_same<V, ExecutionOrder<Bond>>::value)
+		OutputDataStream("executions.txt", _data.GetExecutionOrder_eo2s());	// output to executions.txt
+	if constexpr (is_same<V, PriceStreamDelta<Bond>>::value)
+		OutputDataStream("streaming.txt", _data.GetPriceStream_ps2s());		// output to streaming.txt
+	if constexpr (is_same<V, Inquiry<Bond>>::value)
+		OutputDataStream("allinquiries.txt", _data.GetInquiry_i2s());		// output to allinquiries.txt
+	if constexpr (is_same<V, ScenarioPnL>::value)
+		OutputDataStream("scenarios.txt", _data.GetScenarioPnL_s2s());		// output to scenarios.txt
+	if constexpr (is_same<V, KeyRateLadder<Bond>>::value)
+		OutputDataStream("ladder.txt", _data.GetKeyRateLadder_k2s());		// output to ladder.txt
+	if constexpr (is_same<V, OrderBook<Bond>>::value)
+		OutputDataStream("books.txt", _data.GetOrderBook_ob2s());			// output to books.txt
+	if constexpr (is_same<V, ValueAtRisk>::value)
+		OutputDataStream("var.txt", _data.GetValueAtRisk_v2s());			// output to var.txt
 }
 
     
@@ -120,6 +138,16 @@ void HistoricalDataListener<V>::ProcessAdd(V& _data)
     service->PersistData(productId, _data);
 }
 
+template<typename V>
+void HistoricalDataListener<V>::ProcessRemove(V& _data)
+{
+}
+
+template<typename V>
+void HistoricalDataListener<V>::ProcessUpdate(V& _data)
+{
+}
+
 	
 	
 	
\ No newline at end of file
@@ -13,8 +13,10 @@
 #include <string>
 #include <vector>
 #include <chrono>
-#include <map>
 #include <unordered_map>
+#include <cstdint>
+#include <cmath>
+#include <type_traits>
 using namespace std;
 
 
@@ -61,83 +63,496 @@ double Inquiry<T>::GetPrice() const
     return price;
 }
 
+template<typename T>
+void Inquiry<T>::SetPrice(double _price)
+{
+    price = _price;
+}
+
 template<typename T>
 InquiryState Inquiry<T>::GetState() const
 {
     return state;
 }
 
+template<typename T>
+void Inquiry<T>::SetState(InquiryState _state)
+{
+    state = _state;
+}
+
+template<typename T>
+vector<string> Inquiry<T>::GetInquiry_i2s()
+{
+	return ::GetInquiry_i2s<T>(product, inquiryId, side, quantity, price, state);
+}
+
 
 
 
 template<typename T>
 InquiryService<T>::InquiryService()
 {
-    inquiries = map<string, Inquiry<T>>();
     listeners = vector<ServiceListener<Inquiry<T>>*>();
     connector = new InquiryConnector<T>(this);
+	timerListener = new InquiryToTimerListener<T>(this);
+	pricingService = nullptr;
+	timers = nullptr;
+	sizeSpread = 1.0 / 512.0;
+	maxQuantity = 50000000;
+	quoteLifetime = 1000;
+	quotedCount = 0;
+	rejectedCount = 0;
+	expiredCount = 0;
+	totalLatency = 0;
+	maxLatency = 0;
+	closeCount = 0;
+	for (int i = 0; i < INQUIRY_LATENCY_BUCKETS; i++)
+		latencyBuckets[i] = 0;
+	for (int i = 0; i < INQUIRY_STATE_COUNT; i++)
+		stateLists[i] = InquiryList{ -1, -1, 0 };
+	
+	// Allocate the whole table up front, every record on the free list
+	inquiries = vector<Inquiry<T>>(INQUIRY_TABLE_CAPACITY);
+	records = vector<InquiryRecord>(INQUIRY_TABLE_CAPACITY, InquiryRecord{ -1, 0, -1, -1, 0, -1, -1, -1, -1, -1 });
+	for (int i = 0; i < INQUIRY_TABLE_CAPACITY; i++)
+		records[i].stateNext = (i + 1 < INQUIRY_TABLE_CAPACITY) ? i + 1 : -1;
+	freeHead = 0;
+	
+	// Keep the hash index at most half full, so that probes stay short
+	int hashSize = 16;
+	while (hashSize < 2 * INQUIRY_TABLE_CAPACITY)
+		hashSize <<= 1;
+	hashSlots = vector<int>(hashSize, -1);
+	hashMask = hashSize - 1;
 }
 
 template<typename T>
-Inquiry<T>& GetData(string key)
+Inquiry<T>& InquiryService<T>::GetData(string key)
 {
-	return inquiries[key];
+	int record = FindInquiry(key);
+	return (record < 0) ? unknownInquiry : inquiries[record];
 }
 
 template<typename T>
-void OnMessage(Inquiry<T>& data)
+void InquiryService<T>::OnMessage(Inquiry<T>& data)
 {
-    InquiryState state = data.GetState();
-	if (state == RECEIVED) 
+	long now = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+	long inquiryId = ParseInquiryId(data.GetInquiryId());
+	
+	// A new inquiry is quoted at once
+	if (data.GetState() == RECEIVED)
 	{
-		string inquiryId = data.GetInquiryId();
-		inquiries[inquiryId] = data;
-		connector->Publish(data);
-	}
-	if (state == QUOTED)
-	{
-		data.SetState(DONE);
-		string inquiryId = data.GetInquiryId();
-		inquiries[inquiryId] = data;
-		for (vector<ServiceListener<Inquiry<T>>*>::iterator inq_it = listeners.begin(); inq_it != listeners.end(); inq_it++)
-			(*inq_it)->ProcessAdd(data);
+		if (inquiryId < 0)
+		{
+			RejectUnrecorded(data);
+			return;
+		}
+		int record = (FindSlot(inquiryId) >= 0) ? -1 : AllocateRecord();
+		if (record < 0)
+		{
+			RejectUnrecorded(data);
+			return;
+		}
+		
+		// Index the identifier at the end of its probe run
+		int slot = GetHashSlot(inquiryId);
+		while (hashSlots[slot] >= 0)
+			slot = (slot + 1) & hashMask;
+		hashSlots[slot] = record;
+		inquiries[record] = data;
+		InquiryRecord& entry = records[record];
+		entry.inquiryId = inquiryId;
+		entry.receivedTime = now;
+		entry.quoteLatency = -1;
+		entry.timerId = -1;
+		entry.product = GetProductIndex(data.GetProduct().GetProductId());
+		LinkRecord(stateLists[RECEIVED], record, false);
+		LinkRecord(productLists[entry.product], record, true);
+		QuoteInquiry(record);
+		return;
 	}
+	
+	// Otherwise it is the client's answer to a quote
+	int record = (inquiryId < 0) ? -1 : FindInquiry(inquiryId);
+	if (record < 0 || inquiries[record].GetState() != QUOTED) return;
+	if (data.GetState() == DONE || data.GetState() == CUSTOMER_REJECTED) CloseInquiry(record, data.GetState());
 }
 
 template<typename T>
-void AddListener(ServiceListener<Inquiry<T>>* listener)
+void InquiryService<T>::AddListener(ServiceListener<Inquiry<T>>* listener)
 {
 	listeners.push_back(listener);
 }
 
 template<typename T>
-vector<ServiceListener<Inquiry<T>>*> GetListeners()
+const vector<ServiceListener<Inquiry<T>>*>& InquiryService<T>::GetListeners() const
 {
 	return listeners;
 }
 
 template<typename T>
-void SendQuote(const string& inquiryId, double price)
+void InquiryService<T>::SendQuote(const string& inquiryId, double price)
 {
-    Inquiry<T> inquiry = inquiries[inquiryId];
-    inquiry.SetPrice(price);
-    for (vector<ServiceListener<Inquiry<T>>*>::iterator inq_it = listeners.begin(); inq_it != listeners.end(); inq_it++)
-        (*inq_it)->ProcessAdd(inquiry);
+	int record = FindInquiry(inquiryId);
+	if (record < 0) return;
+	Inquiry<T>& inquiry = inquiries[record];
+	if (inquiry.GetState() != RECEIVED && inquiry.GetState() != QUOTED) return;
+	InquiryRecord& entry = records[record];
+	inquiry.SetPrice(price);
+	if (inquiry.GetState() == RECEIVED) MoveToState(record, QUOTED);
+	
+	// Measure the first quote of the inquiry
+	if (entry.quoteLatency < 0)
+	{
+		long now = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+		entry.quoteLatency = now - entry.receivedTime;
+		quotedCount++;
+		totalLatency += entry.quoteLatency;
+		maxLatency = max(maxLatency, entry.quoteLatency);
+		int bucket = 63 - __builtin_clzll((unsigned long long)entry.quoteLatency | 1);
+		latencyBuckets[min(bucket, INQUIRY_LATENCY_BUCKETS - 1)]++;
+	}
+	if (timers != nullptr)
+	{
+		if (entry.timerId >= 0) timers->Cancel(entry.timerId);
+		entry.timerId = timers->Schedule(timers->GetTime() + quoteLifetime, timerListener, record);
+	}
+	
+	// Send the quote last, as the client may answer it at once
+	Inquiry<T> quote = inquiry;
+	connector->Publish(quote);
 }
 
 template<typename T>
-void RejectInquiry(const string &inquiryId)
+void InquiryService<T>::RejectInquiry(const string &inquiryId)
 {
-    Inquiry<T> inquiry = inquiries[inquiryId];
-    inquiry.SetState(REJECTED);
+	int record = FindInquiry(inquiryId);
+	if (record < 0) return;
+	InquiryState state = inquiries[record].GetState();
+	if (state != RECEIVED && state != QUOTED) return;
+	rejectedCount++;
+	CloseInquiry(record, REJECTED);
 }
 
 template<typename T>
-InquiryConnector<T>* GetConnector()
+InquiryConnector<T>* InquiryService<T>::GetConnector()
 {
 	return connector;
 }
 
+template<typename T>
+void InquiryService<T>::SetPricingService(PricingService<T>* _pricingService)
+{
+	pricingService = _pricingService;
+}
+
+template<typename T>
+void InquiryService<T>::SetTimerWheel(TimerWheel* _timers)
+{
+	timers = _timers;
+}
+
+template<typename T>
+void InquiryService<T>::SetQuoteParameters(double _sizeSpread, long _maxQuantity, long _quoteLifetime)
+{
+	sizeSpread = _sizeSpread;
+	maxQuantity = _maxQuantity;
+	quoteLifetime = _quoteLifetime;
+}
+
+template<typename T>
+void InquiryService<T>::ExpireQuote(int record)
+{
+	records[record].timerId = -1;
+	if (inquiries[record].GetState() != QUOTED) return;
+	expiredCount++;
+	CloseInquiry(record, CUSTOMER_REJECTED);
+}
+
+template<typename T>
+int InquiryService<T>::FindInquiry(long inquiryId) const
+{
+	int slot = FindSlot(inquiryId);
+	return (slot < 0) ? -1 : hashSlots[slot];
+}
+
+template<typename T>
+const Inquiry<T>& InquiryService<T>::GetInquiry(int record) const
+{
+	return inquiries[record];
+}
+
+template<typename T>
+int InquiryService<T>::GetFirstInquiry(InquiryState state) const
+{
+	return stateLists[state].head;
+}
+
+template<typename T>
+int InquiryService<T>::GetNextInquiry(int record) const
+{
+	return records[record].stateNext;
+}
+
+template<typename T>
+int InquiryService<T>::GetFirstOpenInquiry(const string& productId) const
+{
+	unordered_map<string, int>::const_iterator it = productIndices.find(productId);
+	return (it == productIndices.end()) ? -1 : productLists[it->second].head;
+}
+
+template<typename T>
+int InquiryService<T>::GetNextOpenInquiry(int record) const
+{
+	return records[record].productNext;
+}
+
+template<typename T>
+int InquiryService<T>::GetStateCount(InquiryState state) const
+{
+	return stateLists[state].count;
+}
+
+template<typename T>
+int InquiryService<T>::GetOpenCount() const
+{
+	return stateLists[RECEIVED].count + stateLists[QUOTED].count;
+}
+
+template<typename T>
+int InquiryService<T>::GetOpenCount(const string& productId) const
+{
+	unordered_map<string, int>::const_iterator it = productIndices.find(productId);
+	return (it == productIndices.end()) ? 0 : productLists[it->second].count;
+}
+
+template<typename T>
+long InquiryService<T>::GetQuotedCount() const
+{
+	return quotedCount;
+}
+
+template<typename T>
+long InquiryService<T>::GetRejectedCount() const
+{
+	return rejectedCount;
+}
+
+template<typename T>
+long InquiryService<T>::GetExpiredCount() const
+{
+	return expiredCount;
+}
+
+template<typename T>
+long InquiryService<T>::GetQuoteLatency(const string& inquiryId) const
+{
+	int record = FindInquiry(inquiryId);
+	return (record < 0) ? -1 : records[record].quoteLatency;
+}
+
+template<typename T>
+double InquiryService<T>::GetAverageQuoteLatency() const
+{
+	return quotedCount == 0 ? 0.0 : (double)totalLatency / quotedCount;
+}
+
+template<typename T>
+long InquiryService<T>::GetMaxQuoteLatency() const
+{
+	return maxLatency;
+}
+
+template<typename T>
+long InquiryService<T>::GetQuoteLatencyPercentile(double percentile) const
+{
+	long target = (long)ceil(percentile * quotedCount);
+	long cumulative = 0;
+	for (int i = 0; i < INQUIRY_LATENCY_BUCKETS; i++)
+	{
+		cumulative += latencyBuckets[i];
+		if (cumulative >= target && cumulative > 0) return 1L << (i + 1);
+	}
+	return 0;
+}
+
+template<typename T>
+void InquiryService<T>::QuoteInquiry(int record)
+{
+	Inquiry<T>& inquiry = inquiries[record];
+	
+	// Latest mid of the product, off the cached snapshot slot
+	PriceRecord price;
+	bool hasPrice = false;
+	if (pricingService != nullptr)
+	{
+		int& priceSlot = priceSlots[records[record].product];
+		if (priceSlot < 0) priceSlot = pricingService->GetSnapshotSlot(inquiry.GetProduct().GetProductId());
+		hasPrice = pricingService->GetSnapshot(priceSlot, price);
+	}
+	if (!hasPrice || inquiry.GetQuantity() > maxQuantity)
+	{
+		rejectedCount++;
+		CloseInquiry(record, REJECTED);
+		return;
+	}
+	
+	// The client buys at the offer and sells at the bid, rounded away from the client
+	double spread = price.bidOfferSpread / 2.0 + sizeSpread * inquiry.GetQuantity() / 1000000.0;
+	double quote = (inquiry.GetSide() == BUY) ? ceil((price.mid + spread) * MARKET_DATA_TICKS - 1e-9) / MARKET_DATA_TICKS
+		: floor((price.mid - spread) * MARKET_DATA_TICKS + 1e-9) / MARKET_DATA_TICKS;
+	SendQuote(inquiry.GetInquiryId(), quote);
+}
+
+template<typename T>
+void InquiryService<T>::CloseInquiry(int record, InquiryState state)
+{
+	InquiryRecord& entry = records[record];
+	if (timers != nullptr && entry.timerId >= 0) timers->Cancel(entry.timerId);
+	entry.timerId = -1;
+	entry.closeNumber = closeCount++;
+	UnlinkRecord(productLists[entry.product], record, true);
+	MoveToState(record, state);
+	
+	Inquiry<T>& inquiry = inquiries[record];
+	for (typename vector<ServiceListener<Inquiry<T>>*>::iterator inq_it = listeners.begin(); inq_it != listeners.end(); inq_it++)
+		(*inq_it)->ProcessAdd(inquiry);
+}
+
+template<typename T>
+void InquiryService<T>::RejectUnrecorded(Inquiry<T>& data)
+{
+	rejectedCount++;
+	data.SetState(REJECTED);
+	for (typename vector<ServiceListener<Inquiry<T>>*>::iterator inq_it = listeners.begin(); inq_it != listeners.end(); inq_it++)
+		(*inq_it)->ProcessAdd(data);
+}
+
+template<typename T>
+int InquiryService<T>::AllocateRecord()
+{
+	if (freeHead >= 0)
+	{
+		int record = freeHead;
+		freeHead = records[record].stateNext;
+		return record;
+	}
+	
+	// Each closed list is in closing order, so the oldest closed inquiry heads one of them
+	int oldest = -1;
+	InquiryState finalStates[3] = { DONE, REJECTED, CUSTOMER_REJECTED };
+	for (int i = 0; i < 3; i++)
+	{
+		int head = stateLists[finalStates[i]].head;
+		if (head >= 0 && (oldest < 0 || records[head].closeNumber < records[oldest].closeNumber)) oldest = head;
+	}
+	if (oldest < 0) return -1;
+	
+	UnlinkRecord(stateLists[inquiries[oldest].GetState()], oldest, false);
+	UnindexRecord(FindSlot(records[oldest].inquiryId));
+	return oldest;
+}
+
+template<typename T>
+void InquiryService<T>::MoveToState(int record, InquiryState state)
+{
+	UnlinkRecord(stateLists[inquiries[record].GetState()], record, false);
+	inquiries[record].SetState(state);
+	LinkRecord(stateLists[state], record, false);
+}
+
+template<typename T>
+void InquiryService<T>::LinkRecord(InquiryList& list, int record, bool byProduct)
+{
+	InquiryRecord& entry = records[record];
+	int& previous = byProduct ? entry.productPrevious : entry.statePrevious;
+	int& next = byProduct ? entry.productNext : entry.stateNext;
+	previous = list.tail;
+	next = -1;
+	if (list.tail >= 0) (byProduct ? records[list.tail].productNext : records[list.tail].stateNext) = record;
+	else list.head = record;
+	list.tail = record;
+	list.count++;
+}
+
+template<typename T>
+void InquiryService<T>::UnlinkRecord(InquiryList& list, int record, bool byProduct)
+{
+	InquiryRecord& entry = records[record];
+	int previous = byProduct ? entry.productPrevious : entry.statePrevious;
+	int next = byProduct ? entry.productNext : entry.stateNext;
+	if (previous >= 0) (byProduct ? records[previous].productNext : records[previous].stateNext) = next;
+	else list.head = next;
+	if (next >= 0) (byProduct ? records[next].productPrevious : records[next].statePrevious) = previous;
+	else list.tail = previous;
+	list.count--;
+}
+
+template<typename T>
+int InquiryService<T>::GetProductIndex(const string& productId)
+{
+	unordered_map<string, int>::iterator it = productIndices.find(productId);
+	if (it != productIndices.end()) return it->second;
+	
+	productIndices[productId] = productLists.size();
+	productLists.push_back(InquiryList{ -1, -1, 0 });
+	priceSlots.push_back(-1);
+	return productLists.size() - 1;
+}
+
+template<typename T>
+long InquiryService<T>::ParseInquiryId(const string& inquiryId) const
+{
+	if (inquiryId.empty() || inquiryId.size() > 18) return -1;
+	long value = 0;
+	for (string::const_iterator it = inquiryId.begin(); it != inquiryId.end(); it++)
+	{
+		if (*it < '0' || *it > '9') return -1;
+		value = value * 10 + (*it - '0');
+	}
+	return value;
+}
+
+template<typename T>
+int InquiryService<T>::FindInquiry(const string& inquiryId) const
+{
+	long numericId = ParseInquiryId(inquiryId);
+	return (numericId < 0) ? -1 : FindInquiry(numericId);
+}
+
+template<typename T>
+int InquiryService<T>::GetHashSlot(long inquiryId) const
+{
+	// Fibonacci hashing spreads sequential identifiers over the table
+	return (int)(((uint64_t)inquiryId * 0x9E3779B97F4A7C15ULL) >> 32) & hashMask;
+}
+
+template<typename T>
+int InquiryService<T>::FindSlot(long inquiryId) const
+{
+	for (int slot = GetHashSlot(inquiryId); hashSlots[slot] >= 0; slot = (slot + 1) & hashMask)
+		if (records[hashSlots[slot]].inquiryId == inquiryId) return slot;
+	return -1;
+}
+
+template<typename T>
+void InquiryService<T>::UnindexRecord(int slot)
+{
+	// Backward shift deletion, so lookups never need tombstones
+	int hole = slot;
+	for (int next = (slot + 1) & hashMask; hashSlots[next] >= 0; next = (next + 1) & hashMask)
+	{
+		int home = GetHashSlot(records[hashSlots[next]].inquiryId);
+		if (((next - home) & hashMask) >= ((next - hole) & hashMask))
+		{
+			hashSlots[hole] = hashSlots[next];
+			hole = next;
+		}
+	}
+	hashSlots[hole] = -1;
+}
+
 
 
 
@@ -145,17 +560,29 @@ template<typename T>
 InquiryConnector<T>::InquiryConnector(InquiryService<T>* _service)
 { 
 	service = _service; 
+	timerListener = new InquiryConnectorToTimerListener<T>(this);
+	timers = nullptr;
+	responseDelay = 0;
+	lapsePeriod = 0;
+	quoteCount = 0;
 }
 
 template<typename T>
 void InquiryConnector<T>::Publish(Inquiry<T>& _data)
 {
-    InquiryState state = _data.GetState();
-    if (state == RECEIVED)
-    {
-        data.SetState(QUOTED);
-		service->OnMessage(data);
-    }
+	if (_data.GetState() != QUOTED) return;
+	quoteCount++;
+	if (timers == nullptr)
+	{
+		Inquiry<T> response = _data;
+		response.SetState(DONE);
+		service->OnMessage(response);
+		return;
+	}
+	
+	// The simulated client answers later on the timer wheel, trading on the quote unless it leaves it to lapse
+	if (lapsePeriod > 0 && quoteCount % lapsePeriod == 0) return;
+	timers->Schedule(timers->GetTime() + responseDelay, timerListener, stol(_data.GetInquiryId()));
 }
 
 template<typename T>
@@ -164,28 +591,90 @@ void InquiryConnector<T>::Subscribe(fstream& data_stream)
 	// Read inquiry data from an input stream
 	vector<vector<string>> inquiry_data = ReadDataStream(data_stream);
 	for (vector<vector<string>>::iterator it = inquiry_data.begin(); it != inquiry_data.end(); it++)
+		SubscribeLine(*it);
+}
+
+template<typename T>
+void InquiryConnector<T>::SubscribeLine(const vector<string>& words)
+{
+	SubscribeLine(words, words.size());
+}
+
+template<typename T>
+void InquiryConnector<T>::SubscribeLine(const vector<string>& words, int wordCount)
+{
+	string inquiryId = words[0];
+	string productId = words[1];
+	Side side = (words[2] == "BUY") ? BUY : SELL;
+	long quantity = stol(words[3]);
+	long ticks = ParseTickPrice(words[4]);
+	if (ticks < 0) return;		// an unreadable price is a parse error
+	double price = (double)ticks / MARKET_DATA_TICKS;
+	
+    InquiryState state;
+    if (words[5] == "RECEIVED") 			state = RECEIVED;
+    if (words[5] == "QUOTED") 				state = QUOTED;
+    if (words[5] == "DONE") 				state = DONE;
+    if (words[5] == "REJECTED")			 	state = REJECTED;
+    if (words[5] == "CUSTOMER_REJECTED") 	state = CUSTOMER_REJECTED;
+	
+	// Bond
+	if constexpr (is_same<T, Bond>::value)
 	{
-		string inquiryId = (*it)[0];
-		string productId = (*it)[1];
-		Side side = ((*it)[2] == "BUY") ? BUY : SELL;
-		long quantity = stol((*it)[3]);
-        double price = GetPrice_d2s(stod((*it)[4]));
-		
-        InquiryState state;
-        if ((*it)[5] == "RECEIVED") 			state = RECEIVED;
-        if ((*it)[5] == "QUOTED") 				state = QUOTED;
-        if ((*it)[5] == "DONE") 				state = DONE;
-        if ((*it)[5] == "REJECTED")			 	state = REJECTED;
-        if ((*it)[5] == "CUSTOMER_REJECTED") 	state = CUSTOMER_REJECTED;
-		
-		// Bond
-		if (T == BOND)
-		{
-			T curr_product = GetBond(productId);
-			Inquiry<T> inquiry(inquiryId, curr_product, side, quantity, price, state);
-			service->OnMessage(inquiry);
-		}
+		T curr_product = GetBond(productId);
+		Inquiry<T> inquiry(inquiryId, curr_product, side, quantity, price, state);
+		service->OnMessage(inquiry);
 	}
 }
 
 
+
+
+template<typename T>
+void InquiryConnector<T>::SetClient(TimerWheel* _timers, long _responseDelay, int _lapsePeriod)
+{
+	timers = _timers;
+	responseDelay = _responseDelay;
+	lapsePeriod = _lapsePeriod;
+}
+
+template<typename T>
+void InquiryConnector<T>::Respond(long inquiryId)
+{
+	// A quote already closed or lapsed is not answered
+	int record = service->FindInquiry(inquiryId);
+	if (record < 0 || service->GetInquiry(record).GetState() != QUOTED) return;
+	Inquiry<T> response = service->GetInquiry(record);
+	response.SetState(DONE);
+	service->OnMessage(response);
+}
+
+
+
+
+template<typename T>
+InquiryToTimerListener<T>::InquiryToTimerListener(InquiryService<T>* _service)
+{
+	service = _service;
+}
+
+template<typename T>
+void InquiryToTimerListener<T>::ProcessTimeout(long data)
+{
+	service->ExpireQuote(data);
+}
+
+
+
+
+template<typename T>
+InquiryConnectorToTimerListener<T>::InquiryConnectorToTimerListener(InquiryConnector<T>* _connector)
+{
+	connector = _connector;
+}
+
+template<typename T>
+void InquiryConnectorToTimerListener<T>::ProcessTimeout(long data)
+{
+	connector->Respond(data);
+}
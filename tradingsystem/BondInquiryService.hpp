@@ -8,6 +8,8 @@
 #define BondInquiryService_hpp
 #include "soa.hpp"
 #include "BondTradeBookingService.hpp"
+#include "BondPricingService.hpp"
+#include "TimerWheel.hpp"
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -15,7 +17,7 @@
 #include <string>
 #include <vector>
 #include <chrono>
-#include <map>
+#include <cstdint>
 #include <unordered_map>
 using namespace std;
 
@@ -51,6 +53,9 @@ public:
 
     // Get the price that we have responded back with
     double GetPrice() const;
+	
+	// Set the price that we respond back with
+	void SetPrice(double _price);
 
     // Get the current state on the inquiry
     InquiryState GetState() const;
@@ -73,15 +78,77 @@ private:
 
 
 
+const int INQUIRY_TABLE_CAPACITY = 1 << 16;		// # of inquiries the inquiry table has room for
+const int INQUIRY_STATE_COUNT = 5;				// # of inquiry states, each with its list of records
+const int INQUIRY_LATENCY_BUCKETS = 48;			// # of power of two buckets of the quote latency histogram (ns)
+
+
+
+
+/**
+ * Record of an inquiry in the inquiry table of InquiryService.
+ * A record is linked into the list of its state, and while the inquiry is open into the list of its product.
+ */
+struct InquiryRecord
+{
+	long inquiryId;							// numeric inquiry identifier
+	long receivedTime;						// time the inquiry came in, in ns of the steady clock
+	long quoteLatency;						// time from receipt to quote in ns (-1 until quoted)
+	long timerId;							// expiry timer of the quote (-1 if none)
+	long closeNumber;						// order the inquiry closed in, to reuse the oldest closed record first
+	int product;							// index of the product list
+	int statePrevious;						// previous record of the state list (-1 at the head)
+	int stateNext;							// next record of the state list, or in the free list (-1 at the tail)
+	int productPrevious;					// previous open record of the product list (-1 at the head)
+	int productNext;						// next open record of the product list (-1 at the tail)
+};
+
+
+
+
+/**
+ * Intrusive doubly linked list of records of the inquiry table, oldest first.
+ */
+struct InquiryList
+{
+	int head;								// oldest record (-1 if empty)
+	int tail;								// newest record (-1 if empty)
+	int count;								// # of records
+};
+
+
+
+
 /* Connector to InquiryService */
 template<typename T>
 class InquiryConnector;
 
+/* Listener of InquiryService on its quote expiry timers */
+template<typename T>
+class InquiryToTimerListener;
+
+/* Listener of InquiryConnector on the response timers of its simulated client */
+template<typename T>
+class InquiryConnectorToTimerListener;
+
 
 
 
 /**
- * Service for customer inquirry objects.
+ * Service for customer inquirry objects, quoting them as an RFQ engine.
+ * Inquiries sit in a table of records allocated up front, found by numeric inquiry identifier through an
+ * open-addressing hash index. Each record is linked into an intrusive list of its state, and while the inquiry is
+ * open into a list of its product, so the open inquiries of a product or the quotes standing are a list walk, and
+ * finding an inquiry or moving it to a new state is O(1) and never allocates. Closed inquiries stay in the table
+ * until it is full, when the record of the oldest closed inquiry is reused.
+ * A new inquiry is quoted at once off the latest mid of PricingService, read through a snapshot slot cached per
+ * product: the client buys at the mid plus the spread and sells at the mid minus it, where the spread is half the
+ * bid/offer spread of the price plus a spread per million of size, rounded away from the client on the tick grid.
+ * An inquiry with no price or over the size limit is rejected, as is one with a non-numeric identifier, with an identifier
+ * already in the table, or with the table full of open inquiries, which are not kept. A quote lapses to
+ * CUSTOMER_REJECTED after the quote lifetime on the shared timer wheel, unless the client has done it or turned it down.
+ * The time from receipt to quote is measured for every inquiry into a histogram of power of two buckets of ns.
+ * Closed inquiries are sent to the listeners.
  * Keyed on inquiry identifier (NOTE: this is NOT a product identifier since each inquiry must be unique).
  * Type T is the product type.
  */
@@ -92,7 +159,7 @@ public:
 	// default ctor
 	InquiryService();
 	
-    // Get data on our service given a key
+    // Get data on our service given a key (an empty inquiry if it is unknown)
     Inquiry<T>& GetData(string key);
 	
     // The callback that a Connector should invoke for any new or updated data
@@ -102,7 +169,7 @@ public:
 	void AddListener(ServiceListener<Inquiry<T>>* listener);
 	
     // Get all listeners on InquiryService
-	vector<ServiceListener<Inquiry<T>>*> GetListeners();
+	const vector<ServiceListener<Inquiry<T>>*>& GetListeners() const;
 	
     // Send a quote back to the client
     void SendQuote(const string& inquiryId, double price);
@@ -112,11 +179,132 @@ public:
 	
 	// Get the connector to InquiryService
 	InquiryConnector<T>* GetConnector();
+	
+	// Set the service the mids are read from
+	void SetPricingService(PricingService<T>* _pricingService);
+	
+	// Set the timer wheel the quote expiry timers are scheduled on, driven by the owner's clock in ms
+	void SetTimerWheel(TimerWheel* _timers);
+	
+	// Set the spread per million of size added to half the bid/offer spread, the largest size quoted, and the quote lifetime in ms
+	void SetQuoteParameters(double _sizeSpread, long _maxQuantity, long _quoteLifetime);
+	
+	// Lapse a quote the client has not answered in time
+	void ExpireQuote(int record);
+	
+	// Find the record of an inquiry by numeric identifier (-1 if it is unknown)
+	int FindInquiry(long inquiryId) const;
+	
+	// Get the inquiry of a record
+	const Inquiry<T>& GetInquiry(int record) const;
+	
+	// Get the oldest record in a state (-1 if none)
+	int GetFirstInquiry(InquiryState state) const;
+	
+	// Get the next record in the same state (-1 at the end)
+	int GetNextInquiry(int record) const;
+	
+	// Get the oldest record of the open inquiries of a product (-1 if none)
+	int GetFirstOpenInquiry(const string& productId) const;
+	
+	// Get the next record of the open inquiries of the same product (-1 at the end)
+	int GetNextOpenInquiry(int record) const;
+	
+	// Get the # of inquiries in a state
+	int GetStateCount(InquiryState state) const;
+	
+	// Get the # of open inquiries
+	int GetOpenCount() const;
+	
+	// Get the # of open inquiries of a product
+	int GetOpenCount(const string& productId) const;
+	
+	// Get the # of inquiries quoted
+	long GetQuotedCount() const;
+	
+	// Get the # of inquiries rejected
+	long GetRejectedCount() const;
+	
+	// Get the # of quotes lapsed
+	long GetExpiredCount() const;
+	
+	// Get the time from receipt to quote of an inquiry in ns (-1 if it is unknown or not quoted)
+	long GetQuoteLatency(const string& inquiryId) const;
+	
+	// Get the average time from receipt to quote in ns
+	double GetAverageQuoteLatency() const;
+	
+	// Get the longest time from receipt to quote in ns
+	long GetMaxQuoteLatency() const;
+	
+	// Get the upper bound of the histogram bucket of a percentile (in [0, 1]) of the times from receipt to quote in ns
+	long GetQuoteLatencyPercentile(double percentile) const;
 
 private:
-    map<string, Inquiry<T>> inquiries;					// a map of {inquiry identifier -> inquiry}
+	// Quote an open inquiry off the latest mid of its product, or reject it
+	void QuoteInquiry(int record);
+	
+	// Close an open inquiry in a final state, taking it off its product list, and send it to the listeners
+	void CloseInquiry(int record, InquiryState state);
+	
+	// Turn down an inquiry the table does not take, and send it to the listeners
+	void RejectUnrecorded(Inquiry<T>& data);
+	
+	// Take a record off the free list, or else reuse the record of the oldest closed inquiry (-1 if all are open)
+	int AllocateRecord();
+	
+	// Move a record to the tail of the list of a state
+	void MoveToState(int record, InquiryState state);
+	
+	// Append a record to a list, through the state or the product links
+	void LinkRecord(InquiryList& list, int record, bool byProduct);
+	
+	// Unlink a record from a list, through the state or the product links
+	void UnlinkRecord(InquiryList& list, int record, bool byProduct);
+	
+	// Get the index of the product list of a product, adding it on first sight
+	int GetProductIndex(const string& productId);
+	
+	// Parse a numeric inquiry identifier (-1 if it is not numeric)
+	long ParseInquiryId(const string& inquiryId) const;
+	
+	// Find the record of an inquiry by identifier (-1 if it is unknown or not numeric)
+	int FindInquiry(const string& inquiryId) const;
+	
+	// Get the hash slot of a numeric inquiry identifier
+	int GetHashSlot(long inquiryId) const;
+	
+	// Find the hash slot of a numeric inquiry identifier (-1 if it is unknown)
+	int FindSlot(long inquiryId) const;
+	
+	// Remove an identifier from the hash index, shifting back the entries after it
+	void UnindexRecord(int slot);
+	
     vector<ServiceListener<Inquiry<T>>*> listeners;		// all listeners on InquiryService
     InquiryConnector<T>* connector;						// a pointer to InquiryConnector
+	InquiryToTimerListener<T>* timerListener;			// a pointer to the listener on the quote expiry timers
+	PricingService<T>* pricingService;					// a pointer to the service the mids are read from
+	TimerWheel* timers;									// a pointer to the timer wheel of the quote expiry timers
+	vector<Inquiry<T>> inquiries;						// inquiry of each record
+	vector<InquiryRecord> records;						// table state of each record
+	vector<int> hashSlots;								// record of the inquiry in each hash slot (-1 if empty)
+	int hashMask;										// # of hash slots - 1
+	int freeHead;										// head of the free list of records
+	long closeCount;									// # of inquiries closed
+	InquiryList stateLists[INQUIRY_STATE_COUNT];		// records in each state, oldest first
+	unordered_map<string, int> productIndices;			// a map of {product identifier -> index of the product list}
+	vector<InquiryList> productLists;					// open records of each product, oldest first
+	vector<int> priceSlots;								// snapshot slot in PricingService of each product (-1 until found)
+	Inquiry<T> unknownInquiry;							// empty inquiry returned for an unknown key
+	double sizeSpread;									// spread per million of size
+	long maxQuantity;									// largest size quoted
+	long quoteLifetime;									// time a quote stands in ms
+	long quotedCount;									// # of inquiries quoted
+	long rejectedCount;									// # of inquiries rejected
+	long expiredCount;									// # of quotes lapsed
+	long totalLatency;									// sum of the times from receipt to quote in ns
+	long maxLatency;									// longest time from receipt to quote in ns
+	long latencyBuckets[INQUIRY_LATENCY_BUCKETS];		// # of times from receipt to quote in [2^i, 2^(i+1)) ns
 };
 
 
@@ -136,8 +324,62 @@ public:
 	// Subscribe data from the Connector
     void Subscribe(fstream& data_stream);
 	
+	// Subscribe one line of data from the Connector, split into words
+    void SubscribeLine(const vector<string>& words);
+	
+	// Subscribe the first # of words of a word buffer reused across lines
+	void SubscribeLine(const vector<string>& words, int wordCount);
+	
+	// Set the timer wheel the simulated client answers on, its response time in ms, and the period of the quotes it
+	// leaves to lapse (0 for none); with no timer wheel it trades on every quote at once
+	void SetClient(TimerWheel* _timers, long _responseDelay, int _lapsePeriod);
+	
+	// Answer a quote as the simulated client, by numeric inquiry identifier
+	void Respond(long inquiryId);
+	
 private:
     InquiryService<T>* service;
+	InquiryConnectorToTimerListener<T>* timerListener;		// a pointer to the listener on the response timers
+	TimerWheel* timers;										// a pointer to the timer wheel of the response timers
+	long responseDelay;										// time the simulated client takes to answer in ms
+	int lapsePeriod;										// every lapsePeriod-th quote is left to lapse (0 for none)
+	long quoteCount;										// # of quotes the simulated client has received
+};
+
+
+
+
+/* Listener of InquiryService on its quote expiry timers */
+template<typename T>
+class InquiryToTimerListener : public TimerListener
+{
+public:
+	// ctor
+	InquiryToTimerListener(InquiryService<T>* _service);
+	
+	// Timer callback when a quote lapses, with the record of its inquiry
+	void ProcessTimeout(long data);
+	
+private:
+	InquiryService<T>* service;				// a pointer to InquiryService
+};
+
+
+
+
+/* Listener of InquiryConnector on the response timers of its simulated client */
+template<typename T>
+class InquiryConnectorToTimerListener : public TimerListener
+{
+public:
+	// ctor
+	InquiryConnectorToTimerListener(InquiryConnector<T>* _connector);
+	
+	// Timer callback when the simulated client answers, with the numeric identifier of the inquiry
+	void ProcessTimeout(long data);
+	
+private:
+	InquiryConnector<T>* connector;			// a pointer to InquiryConnector
 };
 
 
@@ -15,6 +15,13 @@
 #include <chrono>
 #include <map>
 #include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <mutex>
+#include <type_traits>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
 using namespace std;
 
 
@@ -88,13 +95,13 @@ const vector<Order>& OrderBook<T>::GetOfferStack() const
 }
 
 template<typename T>
-const BidOffer& OrderBook<T>::GetBestBidOffer() const
+BidOffer OrderBook<T>::GetBestBidOffer() const
 {
 	double bestBidPrice = -99999.99, bestOfferPrice = 99999.99;
 	Order bestBidOrder, bestOfferOrder;
 	
 	// Traverse bidStack to find the best bid order
-	for (vector<Order>::iterator it = bidStack.begin(); it != bidStack.end(); it++)
+	for (vector<Order>::const_iterator it = bidStack.begin(); it != bidStack.end(); it++)
 	{
 		if (it->GetPrice() > bestBidPrice)
 		{
@@ -104,7 +111,7 @@ const BidOffer& OrderBook<T>::GetBestBidOffer() const
 	}
 	
 	// Traverse offerStack to find the best offer order
-	for (vector<Order>::iterator it = offerStack.begin(); it != offerStack.end(); it++)
+	for (vector<Order>::const_iterator it = offerStack.begin(); it != offerStack.end(); it++)
 	{
 		if (it->GetPrice() < bestOfferPrice)
 		{
@@ -116,6 +123,32 @@ const BidOffer& OrderBook<T>::GetBestBidOffer() const
 	return BidOffer(bestBidOrder, bestOfferOrder);
 }
 
+template<typename T>
+vector<string> OrderBook<T>::GetOrderBook_ob2s() const
+{
+	BidOffer bidOffer = GetBestBidOffer();
+	const Order& bidOrder = bidOffer.GetBidOrder();
+	const Order& offerOrder = bidOffer.GetOfferOrder();
+	return ::GetOrderBook_ob2s<T>(product, bidOrder.GetPrice(), bidOrder.GetQuantity(), offerOrder.GetPrice(), offerOrder.GetQuantity());
+}
+
+template<typename T>
+bool OrderBook<T>::SetLevel(int level, const Order& order)
+{
+	// A level past the depth of the side cannot be placed without leaving empty levels before it
+	vector<Order>& stack = (order.GetSide() == BID) ? bidStack : offerStack;
+	if (level > (int)stack.size()) return false;
+	
+	// A zero quantity deletes the level, and the deeper levels move up
+	if (order.GetQuantity() == 0)
+	{
+		if (level < (int)stack.size()) stack.erase(stack.begin() + level);
+	}
+	else if (level < (int)stack.size()) stack[level] = order;
+	else stack.push_back(order);
+	return true;
+}
+
 
 
 
@@ -126,6 +159,9 @@ MarketDataService<T>::MarketDataService()
     listeners = vector<ServiceListener<OrderBook<T> >*>();
     connector = new MarketDataConnector<T>(this);
     orderBookLevels = 5;
+	snapshots = new SeqlockTable<OrderBookRecord>(64);
+	gapCount = 0;
+	droppedCount = 0;
 }
 
 template<typename T>
@@ -141,14 +177,50 @@ void MarketDataService<T>::OnMessage(OrderBook<T>& data)
 	string productId = curr_product.GetProductId();
 	orderBooks[productId] = data;
 	
-	for (vector<ServiceListener<OrderBook<T>>*>::iterator it = listeners.begin(); it != listeners.end(); it++)
+	// Flatten the top levels for readers on other threads
+	OrderBookRecord record;
+	const vector<Order>& bidStack = data.GetBidStack();
+	const vector<Order>& offerStack = data.GetOfferStack();
+	record.bidDepth = min((int)bidStack.size(), ORDER_BOOK_RECORD_LEVELS);
+	record.offerDepth = min((int)offerStack.size(), ORDER_BOOK_RECORD_LEVELS);
+	for (int i = 0; i < ORDER_BOOK_RECORD_LEVELS; i++)
+	{
+		record.bidPrices[i] = i < record.bidDepth ? bidStack[i].GetPrice() : 0.0;
+		record.bidQuantities[i] = i < record.bidDepth ? bidStack[i].GetQuantity() : 0;
+		record.offerPrices[i] = i < record.offerDepth ? offerStack[i].GetPrice() : 0.0;
+		record.offerQuantities[i] = i < record.offerDepth ? offerStack[i].GetQuantity() : 0;
+	}
+	snapshots->Write(productId, record);
+	
+	// Fast listeners see every update
+	for (typename vector<ServiceListener<OrderBook<T>>*>::iterator it = listeners.begin(); it != listeners.end(); it++)
 		(*it)->ProcessAdd(data);
+	
+	// Slow listeners only get the latest book of the product on their next drain
+	lock_guard<mutex> lock(conflationMutex);
+	if (conflatedListeners.empty()) return;
+	unordered_map<string, int>::iterator slot_it = slotIndices.find(productId);
+	if (slot_it == slotIndices.end())
+	{
+		slot_it = slotIndices.insert(make_pair(productId, (int)latestBooks.size())).first;
+		latestBooks.push_back(data);
+		for (int i = 0; i < (int)dirtyFlags.size(); i++)
+			dirtyFlags[i].push_back(0);
+	}
+	int slot = slot_it->second;
+	latestBooks[slot] = data;
+	for (int i = 0; i < (int)dirtyFlags.size(); i++)
+	{
+		if (dirtyFlags[i][slot]) continue;		// already pending, the newer book just replaces it
+		dirtyFlags[i][slot] = 1;
+		dirtySlots[i].push_back(slot);
+	}
 }
 
 template<typename T>
 void MarketDataService<T>::AddListener(ServiceListener<OrderBook<T>>* listener)
 {
-	listeners.push_back(_listener);
+	listeners.push_back(listener);
 }
 
 template<typename T>
@@ -157,6 +229,49 @@ const vector<ServiceListener<OrderBook<T>>*>& MarketDataService<T>::GetListeners
 	return listeners; 
 }
 
+template<typename T>
+void MarketDataService<T>::AddConflatedListener(ServiceListener<OrderBook<T>>* listener)
+{
+	lock_guard<mutex> lock(conflationMutex);
+	conflatedListeners.push_back(listener);
+	dirtyFlags.push_back(vector<char>(latestBooks.size(), 0));
+	dirtySlots.push_back(vector<int>());
+}
+
+template<typename T>
+void MarketDataService<T>::DrainConflated(ServiceListener<OrderBook<T>>* listener)
+{
+	// Take the pending books under the lock, and call the listener outside it
+	vector<OrderBook<T>> pendingBooks;
+	{
+		lock_guard<mutex> lock(conflationMutex);
+		int index = find(conflatedListeners.begin(), conflatedListeners.end(), listener) - conflatedListeners.begin();
+		if (index == (int)conflatedListeners.size()) return;
+		
+		for (vector<int>::iterator it = dirtySlots[index].begin(); it != dirtySlots[index].end(); it++)
+		{
+			pendingBooks.push_back(latestBooks[*it]);
+			dirtyFlags[index][*it] = 0;
+		}
+		dirtySlots[index].clear();
+	}
+	
+	for (typename vector<OrderBook<T>>::iterator it = pendingBooks.begin(); it != pendingBooks.end(); it++)
+		listener->ProcessAdd(*it);
+}
+
+template<typename T>
+void MarketDataService<T>::DrainConflated()
+{
+	vector<ServiceListener<OrderBook<T>>*> currListeners;
+	{
+		lock_guard<mutex> lock(conflationMutex);
+		currListeners = conflatedListeners;
+	}
+	for (typename vector<ServiceListener<OrderBook<T>>*>::iterator it = currListeners.begin(); it != currListeners.end(); it++)
+		DrainConflated(*it);
+}
+
 template<typename T>
 MarketDataConnector<T>* MarketDataService<T>::GetConnector()
 {
@@ -170,7 +285,7 @@ int MarketDataService<T>::GetOrderBookLevels() const
 }
 
 template<typename T>
-const BidOffer& MarketDataService<T>::GetBestBidOffer(const string &productId)
+BidOffer MarketDataService<T>::GetBestBidOffer(const string &productId)
 {
 	return orderBooks[productId].GetBestBidOffer();
 }
@@ -214,53 +329,411 @@ const OrderBook<T>& MarketDataService<T>::AggregateDepth(const string &productId
 	return OrderBook<T>(curr_product, newBidStack, newOfferStack);
 }
 
+template<typename T>
+bool MarketDataService<T>::GetSnapshot(const string& key, OrderBookRecord& record) const
+{
+	return snapshots->Read(key, record);
+}
+
+template<typename T>
+int MarketDataService<T>::GetSnapshotSlot(const string& key) const
+{
+	return snapshots->Find(key);
+}
+
+template<typename T>
+bool MarketDataService<T>::GetSnapshot(int slot, OrderBookRecord& record) const
+{
+	return snapshots->Read(slot, record);
+}
+
+template<typename T>
+void MarketDataService<T>::OnVenueMessage(Market venue, OrderBook<T>& data)
+{
+	T curr_product = data.GetProduct();
+	string productId = curr_product.GetProductId();
+	
+	unordered_map<string, int>::iterator slot_it = venueIndices.find(productId);
+	if (slot_it == venueIndices.end())
+	{
+		slot_it = venueIndices.insert(make_pair(productId, (int)venueTopOfBooks.size())).first;
+		venueTopOfBooks.push_back(VenueTopOfBook());
+		venueBooks.push_back(vector<OrderBook<T>>(MARKET_COUNT));
+	}
+	int slot = slot_it->second;
+	venueBooks[slot][venue] = data;
+	
+	// Precompute the top of book of the venue for the router
+	VenueTopOfBook& top = venueTopOfBooks[slot];
+	top.bidPrices[venue] = 0.0;
+	top.bidQuantities[venue] = 0;
+	top.offerPrices[venue] = 0.0;
+	top.offerQuantities[venue] = 0;
+	const vector<Order>& bidStack = data.GetBidStack();
+	for (vector<Order>::const_iterator it = bidStack.begin(); it != bidStack.end(); it++)
+	{
+		if (it->GetQuantity() <= 0) continue;
+		if (top.bidQuantities[venue] == 0 || it->GetPrice() > top.bidPrices[venue])
+		{
+			top.bidPrices[venue] = it->GetPrice();
+			top.bidQuantities[venue] = it->GetQuantity();
+		}
+		else if (it->GetPrice() == top.bidPrices[venue]) top.bidQuantities[venue] += it->GetQuantity();
+	}
+	const vector<Order>& offerStack = data.GetOfferStack();
+	for (vector<Order>::const_iterator it = offerStack.begin(); it != offerStack.end(); it++)
+	{
+		if (it->GetQuantity() <= 0) continue;
+		if (top.offerQuantities[venue] == 0 || it->GetPrice() < top.offerPrices[venue])
+		{
+			top.offerPrices[venue] = it->GetPrice();
+			top.offerQuantities[venue] = it->GetQuantity();
+		}
+		else if (it->GetPrice() == top.offerPrices[venue]) top.offerQuantities[venue] += it->GetQuantity();
+	}
+	
+	// Merge the books of all venues by price into the consolidated book
+	map<double, long, greater<double>> aggregatedBids;		// a map of {bid price -> bid quantity}, best first
+	map<double, long> aggregatedOffers;						// a map of {offer price -> offer quantity}, best first
+	for (int i = 0; i < MARKET_COUNT; i++)
+	{
+		const vector<Order>& venueBids = venueBooks[slot][i].GetBidStack();
+		for (vector<Order>::const_iterator it = venueBids.begin(); it != venueBids.end(); it++)
+			aggregatedBids[it->GetPrice()] += it->GetQuantity();
+		const vector<Order>& venueOffers = venueBooks[slot][i].GetOfferStack();
+		for (vector<Order>::const_iterator it = venueOffers.begin(); it != venueOffers.end(); it++)
+			aggregatedOffers[it->GetPrice()] += it->GetQuantity();
+	}
+	vector<Order> newBidStack;
+	for (map<double, long, greater<double>>::iterator it = aggregatedBids.begin(); it != aggregatedBids.end() && (int)newBidStack.size() < orderBookLevels; it++)
+		newBidStack.push_back(Order(it->first, it->second, BID));
+	vector<Order> newOfferStack;
+	for (map<double, long>::iterator it = aggregatedOffers.begin(); it != aggregatedOffers.end() && (int)newOfferStack.size() < orderBookLevels; it++)
+		newOfferStack.push_back(Order(it->first, it->second, OFFER));
+	
+	OrderBook<T> consolidatedBook(curr_product, newBidStack, newOfferStack);
+	OnMessage(consolidatedBook);
+}
 
+template<typename T>
+const VenueTopOfBook* MarketDataService<T>::GetVenueTopOfBook(const string& productId) const
+{
+	unordered_map<string, int>::const_iterator it = venueIndices.find(productId);
+	if (it == venueIndices.end()) return nullptr;
+	return &venueTopOfBooks[it->second];
+}
 
+template<typename T>
+void MarketDataService<T>::OnVenueFill(const string& productId, Market venue, PricingSide side, long quantity)
+{
+	unordered_map<string, int>::iterator it = venueIndices.find(productId);
+	if (it == venueIndices.end()) return;
+	long& topQuantity = (side == BID) ? venueTopOfBooks[it->second].bidQuantities[venue] : venueTopOfBooks[it->second].offerQuantities[venue];
+	topQuantity = max(topQuantity - quantity, 0L);
+}
 
 template<typename T>
-MarketDataConnector<T>::MarketDataConnector()
+void MarketDataService<T>::OnLevelUpdate(const T& product, unsigned long sequence, PricingSide side, int level, double price, long quantity)
 {
-	service = _service;
+	string productId = product.GetProductId();
+	int slot = GetSequenceSlot(productId);
+	BookSequenceState& state = sequenceStates[slot];
+	if (sequence <= state.lastSequence)
+	{
+		// Already in the book, through an earlier update or a snapshot
+		droppedCount++;
+		return;
+	}
+	
+	PendingLevelUpdate update = { sequence, side, level, price, quantity };
+	if (state.recovering || sequence != state.lastSequence + 1)
+	{
+		// An update is missing: hold this one back until a snapshot covers the gap
+		if (!state.recovering)
+		{
+			state.recovering = true;
+			gapCount++;
+			connector->RequestSnapshot(productId, state.lastSequence);
+		}
+		HoldLevelUpdate(slot, productId, update);
+		return;
+	}
+	
+	typename map<string, OrderBook<T>>::iterator book_it = orderBooks.find(productId);
+	if (book_it == orderBooks.end())
+		book_it = orderBooks.insert(make_pair(productId, OrderBook<T>(product, vector<Order>(), vector<Order>()))).first;
+	state.lastSequence = sequence;
+	if (!book_it->second.SetLevel(level, Order(price, quantity, side)))
+	{
+		// The levels before this one are missing from the book: only a snapshot can fill them in
+		state.recovering = true;
+		gapCount++;
+		connector->RequestSnapshot(productId, state.lastSequence);
+		return;
+	}
+	OnMessage(book_it->second);
 }
 
 template<typename T>
-void MarketDataConnector<T>::Subscribe(fstream& data_stream)
+void MarketDataService<T>::OnSnapshot(OrderBook<T>& data, unsigned long sequence)
 {
-	int orderBookLevels = service->GetOrderBookLevels();
-	int orderCount = 0;
-	vector<Order> bidStack;
-	vector<Order> offerStack;
+	string productId = data.GetProduct().GetProductId();
+	int slot = GetSequenceSlot(productId);
+	BookSequenceState& state = sequenceStates[slot];
+	if (sequence < state.lastSequence || (sequence == state.lastSequence && !state.recovering))
+	{
+		droppedCount++;
+		return;
+	}
+	
+	OrderBook<T>& book = orderBooks[productId];
+	book = data;
+	state.lastSequence = sequence;
+	state.recovering = false;
 	
+	// Replay the updates held back after the snapshot, up to the next gap if there is still one
+	vector<PendingLevelUpdate>& ring = pendingUpdates[slot];
+	bool missingLevel = false;
+	while (state.pendingCount > 0 && !missingLevel)
+	{
+		const PendingLevelUpdate& update = ring[state.pendingHead];
+		if (update.sequence > state.lastSequence + 1) break;
+		if (update.sequence == state.lastSequence + 1)
+		{
+			missingLevel = !book.SetLevel(update.level, Order(update.price, update.quantity, update.side));
+			state.lastSequence = update.sequence;
+		}
+		state.pendingHead = (state.pendingHead + 1) % ring.size();
+		state.pendingCount--;
+	}
+	if (state.pendingCount > 0 || missingLevel)
+	{
+		state.recovering = true;
+		gapCount++;
+		connector->RequestSnapshot(productId, state.lastSequence);
+	}
+	OnMessage(book);
+}
+
+template<typename T>
+bool MarketDataService<T>::IsRecovering(const string& productId) const
+{
+	unordered_map<string, int>::const_iterator it = sequenceIndices.find(productId);
+	return it != sequenceIndices.end() && sequenceStates[it->second].recovering;
+}
+
+template<typename T>
+long MarketDataService<T>::GetGapCount() const
+{
+	return gapCount;
+}
+
+template<typename T>
+long MarketDataService<T>::GetDroppedCount() const
+{
+	return droppedCount;
+}
+
+template<typename T>
+int MarketDataService<T>::GetSequenceSlot(const string& productId)
+{
+	unordered_map<string, int>::iterator slot_it = sequenceIndices.find(productId);
+	if (slot_it == sequenceIndices.end())
+	{
+		slot_it = sequenceIndices.insert(make_pair(productId, (int)sequenceStates.size())).first;
+		sequenceStates.push_back(BookSequenceState{ 0, false, 0, 0 });
+		pendingUpdates.push_back(vector<PendingLevelUpdate>(MARKET_DATA_RECOVERY_QUEUE_SIZE));
+	}
+	return slot_it->second;
+}
+
+template<typename T>
+void MarketDataService<T>::HoldLevelUpdate(int slot, const string& productId, const PendingLevelUpdate& update)
+{
+	BookSequenceState& state = sequenceStates[slot];
+	vector<PendingLevelUpdate>& ring = pendingUpdates[slot];
+	if (state.pendingCount == (int)ring.size())
+	{
+		// The snapshot is late: whatever it missed is lost with the ring, so ask for a newer one
+		droppedCount += state.pendingCount;
+		state.pendingHead = 0;
+		state.pendingCount = 0;
+		connector->RequestSnapshot(productId, state.lastSequence);
+	}
+	ring[(state.pendingHead + state.pendingCount) % ring.size()] = update;
+	state.pendingCount++;
+}
+
+
+
+
+template<typename T>
+void MarketDataConnector<T>::Subscribe(fstream& data_stream)
+{
 	// Read market data from an input stream
 	vector<vector<string>> market_data = ReadDataStream(data_stream);
-	
 	for (vector<vector<string>>::iterator it = market_data.begin(); it != market_data.end(); it++)
+		SubscribeLine(*it);
+}
+
+template<typename T>
+void MarketDataConnector<T>::SubscribeLine(const vector<string>& words)
+{
+	SubscribeLine(words, words.size());
+}
+
+template<typename T>
+void MarketDataConnector<T>::SubscribeLine(const vector<string>& words, int wordCount)
+{
+	string productId = words[0];
+	long ticks = ParseTickPrice(words[1]);
+	if (ticks < 0) return;		// an unreadable price is a parse error
+	double price = (double)ticks / MARKET_DATA_TICKS;
+	long quantity = stol(words[2]);
+	PricingSide side = (words[3] == "BID") ? BID : OFFER;
+	bool hasVenue = wordCount > 4;		// optional venue column
+	Market venue = hasVenue ? GetMarket(words[4]) : BROKERTEC;
+	AddOrder(productId, price, quantity, side, hasVenue, venue);
+}
+
+template<typename T>
+void MarketDataConnector<T>::SubscribeLevelUpdate(const LevelUpdateView& update)
+{
+	if (!requestBacklog.empty()) FlushRequests();
+	
+	// A venue or side out of range is a malformed message
+	int venue = update.GetVenue();
+	if ((venue != MARKET_DATA_CONSOLIDATED && venue >= MARKET_COUNT) || (update.GetSide() != BID && update.GetSide() != OFFER)) return;
+	if (venue != MARKET_DATA_CONSOLIDATED)
 	{
-		string productId = (*it)[0];
-		double price = GetPrice_d2s((*it)[1]);
-		long quantity = stol((*it)[2]);
-		PricingSide side = ((*it)[3] == "BID") ? BID : OFFER;
-		
-		Order order(price, quantity, side);
-		if (side == BID) bidStack.push_back(order);
-		if (side == OFFER) offerStack.push_back(order);
-		
-		orderCount++;
-		if (orderCount % (2 * orderBookLevels) == 0)
+		// Venue books are still read whole, a level at a time
+		AddOrder(update.GetProductId(), update.GetPrice(), update.GetQuantity(), (PricingSide)update.GetSide(), true, (Market)venue);
+		return;
+	}
+	
+	// Bond
+	if constexpr (is_same<T, Bond>::value)
+	{
+		string productId = update.GetProductId();
+		typename unordered_map<string, T>::iterator product_it = products.find(productId);
+		if (product_it == products.end()) product_it = products.insert(make_pair(productId, GetBond(productId))).first;
+		service->OnLevelUpdate(product_it->second, update.GetSequence(), (PricingSide)update.GetSide(), update.GetLevel(),
+			update.GetPrice(), update.GetQuantity());
+	}
+}
+
+template<typename T>
+void MarketDataConnector<T>::SubscribeBookSnapshot(const BookSnapshotView& snapshot)
+{
+	if (!requestBacklog.empty()) FlushRequests();
+	
+	// A venue or an entry side out of range is a malformed snapshot, dropped whole
+	int venue = snapshot.GetVenue();
+	if (venue != MARKET_DATA_CONSOLIDATED && venue >= MARKET_COUNT) return;
+	int entryCount = snapshot.GetEntryCount();
+	for (int i = 0; i < entryCount; i++)
+		if (snapshot.GetEntrySide(i) != BID && snapshot.GetEntrySide(i) != OFFER) return;
+	
+	// A snapshot is a whole book: publish it straight away
+	vector<Order> bids;
+	vector<Order> offers;
+	for (int i = 0; i < entryCount; i++)
+	{
+		PricingSide side = (PricingSide)snapshot.GetEntrySide(i);
+		Order order(snapshot.GetEntryPrice(i), snapshot.GetEntryQuantity(i), side);
+		if (side == BID) bids.push_back(order);
+		else offers.push_back(order);
+	}
+	
+	// Bond
+	if constexpr (is_same<T, Bond>::value)
+	{
+		T curr_product = GetBond(snapshot.GetProductId());
+		OrderBook<T> orderBook(curr_product, bids, offers);
+		if (venue != MARKET_DATA_CONSOLIDATED) service->OnVenueMessage((Market)venue, orderBook);
+		else service->OnSnapshot(orderBook, snapshot.GetSequence());
+	}
+}
+
+template<typename T>
+void MarketDataConnector<T>::SetRequestDescriptor(int fd)
+{
+	requestDescriptor = fd;
+}
+
+template<typename T>
+void MarketDataConnector<T>::RequestSnapshot(const string& productId, unsigned long lastSequence)
+{
+	if (requestDescriptor < 0) return;
+	char request[MARKET_DATA_SNAPSHOT_REQUEST_SIZE];
+	int size = EncodeSnapshotRequest(request, lastSequence, productId);
+	requestBacklog.insert(requestBacklog.end(), request, request + size);
+	FlushRequests();
+}
+
+template<typename T>
+void MarketDataConnector<T>::FlushRequests()
+{
+	// The socket is non-blocking: send what it takes, and keep the rest for the next message read off the feed
+	size_t sent = 0;
+	while (sent < requestBacklog.size())
+	{
+		ssize_t written = write(requestDescriptor, &requestBacklog[sent], requestBacklog.size() - sent);
+		if (written > 0)
+		{
+			sent += written;
+			continue;
+		}
+		if (written < 0 && errno == EINTR) continue;
+		if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+		{
+			cout << "Cannot request snapshots: " << strerror(errno) << endl;
+			sent = requestBacklog.size();
+		}
+		break;
+	}
+	requestBacklog.erase(requestBacklog.begin(), requestBacklog.begin() + sent);
+}
+
+template<typename T>
+void MarketDataConnector<T>::AddOrder(const string& productId, double price, long quantity, PricingSide side, bool hasVenue, Market venue)
+{
+	int orderBookLevels = service->GetOrderBookLevels();
+	unordered_map<string, int>::iterator slot_it = pendingIndices.find(productId);
+	if (slot_it == pendingIndices.end())
+	{
+		slot_it = pendingIndices.insert(make_pair(productId, (int)pendingBooks.size())).first;
+		for (int i = 0; i <= MARKET_COUNT; i++)
 		{
-			// Bond
-			if (T == BOND)
-			{
-				T curr_product = GetBond(productId);
-				OrderBook<T> orderBook(curr_product, bidStack, offerStack);
-				service->OnMessage(orderBook);
-
-				// Clear bidStack and offerStack
-				bidStack.clear();
-				offerStack.clear();
-			}
+			PendingOrderBook pendingBook;
+			pendingBook.bidStack.reserve(2 * orderBookLevels);
+			pendingBook.offerStack.reserve(2 * orderBookLevels);
+			pendingBook.orderCount = 0;
+			pendingBooks.push_back(pendingBook);
 		}
 	}
+	PendingOrderBook& pendingBook = pendingBooks[slot_it->second + (hasVenue ? venue : MARKET_COUNT)];
+	Order order(price, quantity, side);
+	if (side == BID) pendingBook.bidStack.push_back(order);
+	if (side == OFFER) pendingBook.offerStack.push_back(order);
+	
+	pendingBook.orderCount++;
+	if (pendingBook.orderCount == 2 * orderBookLevels)
+	{
+		// Bond
+		if constexpr (is_same<T, Bond>::value)
+		{
+			T curr_product = GetBond(productId);
+			OrderBook<T> orderBook(curr_product, pendingBook.bidStack, pendingBook.offerStack);
+			if (hasVenue) service->OnVenueMessage(venue, orderBook);
+			else service->OnMessage(orderBook);
+		}
+		
+		// Clear the stacks, keeping their capacity for the next book of the product
+		pendingBook.bidStack.clear();
+		pendingBook.offerStack.clear();
+		pendingBook.orderCount = 0;
+	}
 }
 
 
@@ -8,6 +8,8 @@
 #define BondMarketDataService_hpp
 #include "soa.hpp"
 #include "my functions.hpp"
+#include "SeqlockTable.hpp"
+#include "MarketDataMessage.hpp"
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -17,6 +19,8 @@
 #include <chrono>
 #include <map>
 #include <unordered_map>
+#include <mutex>
+#include <type_traits>
 using namespace std;
 
 
@@ -105,7 +109,14 @@ public:
     const vector<Order>& GetOfferStack() const;
 	
 	// Get the best bid/offer order
-	const BidOffer& GetBestBidOffer() const;
+	BidOffer GetBestBidOffer() const;
+	
+	// Convert the top of book -> vector<string> format
+	vector<string> GetOrderBook_ob2s() const;
+	
+	// Set the order at a level of its side of the book, removing the level on a zero quantity
+	// (false if the levels before it are missing)
+	bool SetLevel(int level, const Order& order);
 	
 private:
     T product;
@@ -116,6 +127,92 @@ private:
 
 
 
+const int ORDER_BOOK_RECORD_LEVELS = 5;		// # of bid/offer levels kept in an order book record
+
+
+
+
+/**
+ * Flat copy of the top levels of an order book, read from any thread through MarketDataService::GetSnapshot.
+ */
+struct OrderBookRecord
+{
+	int bidDepth;										// # of bid levels filled
+	int offerDepth;										// # of offer levels filled
+	double bidPrices[ORDER_BOOK_RECORD_LEVELS];
+	long bidQuantities[ORDER_BOOK_RECORD_LEVELS];
+	double offerPrices[ORDER_BOOK_RECORD_LEVELS];
+	long offerQuantities[ORDER_BOOK_RECORD_LEVELS];
+};
+
+
+
+
+/**
+ * Top of book of a product on every venue, indexed by Market.
+ * The venues sit side by side so that a router reads all of them off one or two cache lines;
+ * a venue with no quantity on a side has nothing to trade on that side.
+ */
+struct VenueTopOfBook
+{
+	double bidPrices[MARKET_COUNT];
+	long bidQuantities[MARKET_COUNT];
+	double offerPrices[MARKET_COUNT];
+	long offerQuantities[MARKET_COUNT];
+};
+
+
+
+
+const int MARKET_DATA_RECOVERY_QUEUE_SIZE = 1024;	// # of level updates buffered per product while it awaits a snapshot
+
+
+
+
+/**
+ * A level update of a book held back while its product recovers from a sequence gap.
+ */
+struct PendingLevelUpdate
+{
+	unsigned long sequence;
+	PricingSide side;
+	int level;
+	double price;
+	long quantity;
+};
+
+
+
+
+/**
+ * Sequencing state of the consolidated book of a product.
+ * The updates held back during recovery sit in a ring, allocated once with the state.
+ */
+struct BookSequenceState
+{
+	unsigned long lastSequence;							// sequence number the book is as of
+	bool recovering;									// whether a gap was found and a snapshot is awaited
+	int pendingHead;									// index of the oldest update in the ring
+	int pendingCount;									// # of updates in the ring
+};
+
+
+
+
+/**
+ * Orders of the book of a product being read by the connector, on one venue or consolidated.
+ * The stacks are reserved for a whole book once, and cleared without freeing after each book is published.
+ */
+struct PendingOrderBook
+{
+	vector<Order> bidStack;								// bid orders read so far
+	vector<Order> offerStack;							// offer orders read so far
+	int orderCount;										// # of orders read so far
+};
+
+
+
+
 /* Subscribe-only Connector to BondMarketDataService */
 template<typename T>
 class MarketDataConnector;
@@ -125,6 +222,12 @@ class MarketDataConnector;
 
 /**
  * Market Data Service which distributes market data
+ * GetData is for the service thread; other threads read the top of the books through GetSnapshot,
+ * which copies a seqlock-versioned record and never blocks the service thread.
+ * Books tagged with a venue are kept per venue: the top of book of each venue is precomputed
+ * for the order router, and the venue books are merged into the consolidated book distributed to listeners.
+ * Level updates of the consolidated book are applied in the sequence of their product: on a gap the
+ * product asks the connector for a snapshot and holds later updates back until the snapshot replaces the book.
  * Keyed on product identifier.
  * Type T is the product type.
  */
@@ -147,6 +250,17 @@ public:
     // Get all listeners on MarketDataService
 	const vector<ServiceListener<OrderBook<T>>*>& GetListeners() const;
 	
+	// Add a slow listener to MarketDataService, which only receives the latest book of each product
+	// that changed since its last drain, instead of every update
+	void AddConflatedListener(ServiceListener<OrderBook<T>>* listener);
+	
+	// Deliver the latest book of every product that changed since the last drain to a conflated listener
+	// (may be called from the listener's own thread)
+	void DrainConflated(ServiceListener<OrderBook<T>>* listener);
+	
+	// Drain all conflated listeners
+	void DrainConflated();
+	
 	// Get the pointer to the connector on MarketDataService
 	MarketDataConnector<T>* GetConnector();
 	
@@ -154,16 +268,74 @@ public:
 	int GetOrderBookLevels() const;
 	
     // Get the best bid/offer order
-    const BidOffer& GetBestBidOffer(const string &productId);
+    BidOffer GetBestBidOffer(const string &productId);
 
     // Aggregate the order book
     const OrderBook<T>& AggregateDepth(const string &productId);
+	
+	// Copy the top levels of the latest book of a product from any thread (false if there is none yet)
+	bool GetSnapshot(const string& key, OrderBookRecord& record) const;
+	
+	// Get the snapshot slot of a product (-1 if it has no book yet); readers may cache it
+	int GetSnapshotSlot(const string& key) const;
+	
+	// Copy the top levels of the latest book of a snapshot slot from any thread (false if the slot is not in use)
+	bool GetSnapshot(int slot, OrderBookRecord& record) const;
+	
+	// The callback for the book of a product on one venue:
+	// update the top of book of the venue, and distribute the consolidated book of all venues
+	void OnVenueMessage(Market venue, OrderBook<T>& data);
+	
+	// Get the top of book of a product on every venue (nullptr if no venue has quoted it)
+	const VenueTopOfBook* GetVenueTopOfBook(const string& productId) const;
+	
+	// Take a fill against the top of book of a venue off its size, until the next book of the venue
+	void OnVenueFill(const string& productId, Market venue, PricingSide side, long quantity);
+	
+	// The callback for an update of one level of the consolidated book of a product:
+	// apply and distribute it in sequence, or hold it back and request a snapshot on a gap
+	void OnLevelUpdate(const T& product, unsigned long sequence, PricingSide side, int level, double price, long quantity);
+	
+	// The callback for a snapshot of the consolidated book of a product as of a sequence number:
+	// replace the book, replay the updates held back after it, and distribute it
+	void OnSnapshot(OrderBook<T>& data, unsigned long sequence);
+	
+	// Whether a product awaits a snapshot after a sequence gap
+	bool IsRecovering(const string& productId) const;
+	
+	// Get the # of sequence gaps found
+	long GetGapCount() const;
+	
+	// Get the # of level updates and snapshots dropped, as stale or past a full ring
+	long GetDroppedCount() const;
 
 private:
+	// Get the sequence slot of a product, adding it on first sight
+	int GetSequenceSlot(const string& productId);
+	
+	// Hold a level update back in the ring of a sequence slot, starting over with a new snapshot request when it is full
+	void HoldLevelUpdate(int slot, const string& productId, const PendingLevelUpdate& update);
+	
+
 	map<string, OrderBook<T>> orderBooks;				// a map of {order identifier -> order book}
     vector<ServiceListener<OrderBook<T>>*> listeners;	// all listeners on BondMarketDataService
     MarketDataConnector<T>* connector;					// a pointer to a MarketDataConnector
     int orderBookLevels;								// # of bid/offer levels in the order book
+	vector<ServiceListener<OrderBook<T>>*> conflatedListeners;	// all slow listeners on BondMarketDataService
+	unordered_map<string, int> slotIndices;				// a map of {product identifier -> conflation slot}
+	vector<OrderBook<T>> latestBooks;					// latest book of each slot (latest value wins)
+	vector<vector<char>> dirtyFlags;					// whether each slot changed, per conflated listener
+	vector<vector<int>> dirtySlots;						// slots that changed, per conflated listener
+	mutex conflationMutex;								// guards the conflation slots against a draining thread
+	SeqlockTable<OrderBookRecord>* snapshots;			// top levels of the latest book of each product for other threads
+	unordered_map<string, int> venueIndices;			// a map of {product identifier -> venue slot}
+	vector<VenueTopOfBook> venueTopOfBooks;				// top of book on every venue, per venue slot
+	vector<vector<OrderBook<T>>> venueBooks;			// book on each venue, per venue slot
+	unordered_map<string, int> sequenceIndices;			// a map of {product identifier -> sequence slot}
+	vector<BookSequenceState> sequenceStates;			// sequencing state, per sequence slot
+	vector<vector<PendingLevelUpdate>> pendingUpdates;	// ring of updates held back during recovery, per sequence slot
+	long gapCount;										// # of sequence gaps found
+	long droppedCount;									// # of level updates and snapshots dropped
 };
 
 
@@ -175,7 +347,7 @@ class MarketDataConnector
 {
 public:
 	// ctor
-    MarketDataConnector(MarketDataService<T>* _service) { service = _service; }
+    MarketDataConnector(MarketDataService<T>* _service) { service = _service; requestDescriptor = -1; }
 
     // Publish data to the Connector
     void Publish(OrderBook<T>& _data); 					// Empty
@@ -183,9 +355,38 @@ public:
     // Subscribe data from the Connector
     void Subscribe(fstream& data_stream);
 	
+	// Subscribe one line of data from the Connector, split into words
+	void SubscribeLine(const vector<string>& words);
+	
+	// Subscribe the first # of words of a word buffer reused across lines
+	void SubscribeLine(const vector<string>& words, int wordCount);
+	
+	// Subscribe a binary level update from the Connector, read in place
+	void SubscribeLevelUpdate(const LevelUpdateView& update);
+	
+	// Subscribe a binary book snapshot from the Connector, read in place
+	void SubscribeBookSnapshot(const BookSnapshotView& snapshot);
+	
+	// Set the file descriptor to send snapshot requests on (the feed socket), -1 for none
+	void SetRequestDescriptor(int fd);
+	
+	// Request a snapshot of the book of a product from the feed, queueing what the socket does not take
+	void RequestSnapshot(const string& productId, unsigned long lastSequence);
+	
 private:
+	// Send as much of the queued snapshot requests as the socket takes
+	void FlushRequests();
+	
+	// Add an order to the book of its product being read, and publish the book once the product has all its levels
+	void AddOrder(const string& productId, double price, long quantity, PricingSide side, bool hasVenue, Market venue);
+	
     MarketDataService<T>* service;						// a pointer to MarketDataService
-}
+	unordered_map<string, int> pendingIndices;			// a map of {product identifier -> first pending book slot}
+	vector<PendingOrderBook> pendingBooks;				// books being read, a slot per venue then one consolidated, per product
+	unordered_map<string, T> products;					// a map of {product identifier -> product} of the level updates read
+	int requestDescriptor;								// file descriptor snapshot requests are sent on
+	vector<char> requestBacklog;						// bytes of snapshot requests the socket has not taken yet
+};
 
 
 
@@ -16,6 +16,8 @@
 #include <chrono>
 #include <map>
 #include <unordered_map>
+#include <cstring>
+#include <numeric>
 using namespace std;
 
 
@@ -43,8 +45,8 @@ long Position<T>::GetPosition(string &book)
 template<typename T>
 long Position<T>::GetAggregatePosition()
 {
-    return accumulate(begin(positions), end(positions), 0,
-		[](long previous, pair<string, long>& p){ return previous + p.second; });
+    return accumulate(begin(positions), end(positions), 0L,
+		[](long previous, const pair<const string, long>& p){ return previous + p.second; });
 }
 
 template<typename T>
@@ -56,11 +58,11 @@ map<string, long> Position<T>::GetPositions()
 template<typename T>
 vector<string> Position<T>::GetPositions_p2s()
 {
-	return GetPositions_p2s<T>(product, positions);
+	return ::GetPositions_p2s<T>(product, positions);
 }
 
 template<typename T>
-void Position<T>::AddPosition(string& book, long position)
+void Position<T>::AddPosition(const string& book, long position)
 {
 	positions[book] += position;
 }
@@ -74,6 +76,7 @@ PositionService<T>::PositionService()
     positions = map<string, Position<T>>();
     listeners = vector<ServiceListener<Position<T>>*>();
     listener = new PositionToTradeBookingListener<T>(this);
+	snapshots = new SeqlockTable<PositionRecord>(64);
 }
 
 template<typename T>
@@ -85,7 +88,7 @@ Position<T>& PositionService<T>::GetData(string key)
 template<typename T>
 void PositionService<T>::OnMessage(Position<T>& data)
 {
-	string curr_product = data.GetProduct();
+	T curr_product = data.GetProduct();
 	string productId = curr_product.GetProductId();
 	positions[productId] = data;
 }
@@ -128,10 +131,40 @@ void PositionService<T>::AddTrade(const Trade<T>& trade)
 		newPosition.AddPosition(it->first, it->second);
 	positions[productId] = newPosition;
 	
-	for (vector<ServiceListener<Position<T>>*>::iterator it = listeners.begin(); it != listeners.end(); it++)
+	// Flatten the position for readers on other threads
+	PositionRecord record = {};
+	map<string, long> newPositions = newPosition.GetPositions();
+	for (map<string, long>::iterator it = newPositions.begin(); it != newPositions.end(); it++)
+	{
+		record.aggregatePosition += it->second;
+		if (record.bookCount == POSITION_RECORD_BOOKS) continue;
+		strncpy(record.books[record.bookCount], it->first.c_str(), POSITION_RECORD_BOOK_LENGTH - 1);
+		record.positions[record.bookCount++] = it->second;
+	}
+	snapshots->Write(productId, record);
+	
+	for (typename vector<ServiceListener<Position<T>>*>::iterator it = listeners.begin(); it != listeners.end(); it++)
 		(*it)->ProcessAdd(newPosition);
 }
 
+template<typename T>
+bool PositionService<T>::GetSnapshot(const string& key, PositionRecord& record) const
+{
+	return snapshots->Read(key, record);
+}
+
+template<typename T>
+int PositionService<T>::GetSnapshotSlot(const string& key) const
+{
+	return snapshots->Find(key);
+}
+
+template<typename T>
+bool PositionService<T>::GetSnapshot(int slot, PositionRecord& record) const
+{
+	return snapshots->Read(slot, record);
+}
+
 
 
 
@@ -147,4 +180,14 @@ void PositionToTradeBookingListener<T>::ProcessAdd(Trade<T> &data)
 	service->AddTrade(data);
 }
 
+template<typename T>
+void PositionToTradeBookingListener<T>::ProcessRemove(Trade<T>& _data)
+{
+}
+
+template<typename T>
+void PositionToTradeBookingListener<T>::ProcessUpdate(Trade<T>& _data)
+{
+}
+
 
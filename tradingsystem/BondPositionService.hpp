@@ -9,6 +9,7 @@
 #include "soa.hpp"
 #include "my functions.hpp"
 #include "BondTradeBookingService.hpp"
+#include "SeqlockTable.hpp"
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -54,7 +55,7 @@ public:
 	vector<string> GetPositions_p2s();
 	
 	// Add a position to a book
-	void AddPosition(string& book, long position);
+	void AddPosition(const string& book, long position);
 	
 private:
     T product;
@@ -64,6 +65,26 @@ private:
 
 
 
+const int POSITION_RECORD_BOOKS = 4;			// # of books kept in a position record
+const int POSITION_RECORD_BOOK_LENGTH = 8;		// max book name length (with the null)
+
+
+
+
+/**
+ * Flat copy of a position, read from any thread through PositionService::GetSnapshot.
+ */
+struct PositionRecord
+{
+	long aggregatePosition;												// position across all books
+	int bookCount;														// # of books filled
+	char books[POSITION_RECORD_BOOKS][POSITION_RECORD_BOOK_LENGTH];	// book names
+	long positions[POSITION_RECORD_BOOKS];								// position in each book
+};
+
+
+
+
 /* Listener of BondPositionService to BondTradeBookingService */
 template<typename T>
 class PositionToTradeBookingListener;
@@ -73,6 +94,8 @@ class PositionToTradeBookingListener;
 
 /**
  * Position Service to manage positions across multiple books and secruties.
+ * GetData is for the service thread; other threads read positions through GetSnapshot,
+ * which copies a seqlock-versioned record and never blocks the service thread.
  * Keyed on product identifier.
  * Type T is the product type.
  */
@@ -100,11 +123,21 @@ public:
 	
     // Add a trade to the service
     void AddTrade(const Trade<T>& trade);
+	
+	// Copy the latest position of a product from any thread (false if there is none yet)
+	bool GetSnapshot(const string& key, PositionRecord& record) const;
+	
+	// Get the snapshot slot of a product (-1 if it has no position yet); readers may cache it
+	int GetSnapshotSlot(const string& key) const;
+	
+	// Copy the latest position of a snapshot slot from any thread (false if the slot is not in use)
+	bool GetSnapshot(int slot, PositionRecord& record) const;
 
 private:
 	map<string, Position<T>> positions;
 	vector<ServiceListener<Position<T>>*> listeners;
 	PositionToTradeBookingListener<T>* listener;
+	SeqlockTable<PositionRecord>* snapshots;		// latest position of each product for other threads
 };
 
 
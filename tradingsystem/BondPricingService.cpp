@@ -15,6 +15,7 @@
 #include <chrono>
 #include <map>
 #include <unordered_map>
+#include <type_traits>
 using namespace std;
 
 
@@ -53,7 +54,11 @@ vector<string> Price<T>::print()
 	string _mid = GetPrice_d2s(mid);
 	string _bidOfferSpread = GetPrice_d2s(bidOfferSpread);
 	
-	return vector<string>(_product, _mid, _bidOfferSpread);
+	vector<string> res;
+	res.push_back(_product);					// Append productId
+	res.push_back(_mid);						// Append mid price
+	res.push_back(_bidOfferSpread);				// Append bid/offer spread
+	return res;
 }
 
 
@@ -65,6 +70,7 @@ PricingService<T>::PricingService()
 	prices = map<string, Price<T>>();
 	listeners = vector<ServiceListener<Price<T>>*>();	
 	connector = new PricingConnector<T>(this);
+	snapshots = new SeqlockTable<PriceRecord>(64);
 }
 
 
@@ -77,9 +83,14 @@ Price<T>& PricingService<T>::GetData(string key)
 template<typename T>
 void PricingService<T>::OnMessage(Price<T>& data)
 {
-	string _productId = prices[data.GetProduct().GetProductId()];
-	for(vector<ServiceListener<Price<T>>*>::iterator p_it = listeners.begin(); p_it != listeners.end(); p_it++)
-		(*p_it)->ProcessAdd(_productId);
+	string _productId = data.GetProduct().GetProductId();
+	prices[_productId] = data;
+	
+	PriceRecord record = { data.GetMid(), data.GetBidOfferSpread() };
+	snapshots->Write(_productId, record);
+	
+	for(typename vector<ServiceListener<Price<T>>*>::iterator p_it = listeners.begin(); p_it != listeners.end(); p_it++)
+		(*p_it)->ProcessAdd(data);
 }
 
 template<typename T>
@@ -100,6 +111,24 @@ PricingConnector<T>* PricingService<T>::GetConnector()
 	return connector;
 }
 
+template<typename T>
+bool PricingService<T>::GetSnapshot(const string& key, PriceRecord& record) const
+{
+	return snapshots->Read(key, record);
+}
+
+template<typename T>
+int PricingService<T>::GetSnapshotSlot(const string& key) const
+{
+	return snapshots->Find(key);
+}
+
+template<typename T>
+bool PricingService<T>::GetSnapshot(int slot, PriceRecord& record) const
+{
+	return snapshots->Read(slot, record);
+}
+
 
 
 
@@ -109,26 +138,44 @@ PricingConnector<T>::PricingConnector(PricingService<T>* _service)
 	service = _service;
 }
 
+template<typename T>
+void PricingConnector<T>::Publish(Price<T>& data)
+{
+}
+
 template<typename T>
 void PricingConnector<T>::Subscribe(fstream& data_stream)
 {
 	// Read price data from an input stream
 	vector<vector<string>> price_data = ReadDataStream(data_stream);
-	for (vector<vector<string>>::iterator it = price_data.begin; it != price_data.end(); it++)
+	for (vector<vector<string>>::iterator it = price_data.begin(); it != price_data.end(); it++)
+		SubscribeLine(*it);
+}
+
+template<typename T>
+void PricingConnector<T>::SubscribeLine(const vector<string>& words)
+{
+	SubscribeLine(words, words.size());
+}
+
+template<typename T>
+void PricingConnector<T>::SubscribeLine(const vector<string>& words, int wordCount)
+{
+	string productId = words[0];
+	long bidTicks = ParseTickPrice(words[1]);
+	long offerTicks = ParseTickPrice(words[2]);
+	if (bidTicks < 0 || offerTicks < 0) return;		// an unreadable price is a parse error
+	double bidPrice = (double)bidTicks / MARKET_DATA_TICKS;
+	double offerPrice = (double)offerTicks / MARKET_DATA_TICKS;
+	double midPrice = (bidPrice + offerPrice) / 2.0;
+	double spread = offerPrice - bidPrice;
+	
+	// Bond
+	if constexpr (is_same<T, Bond>::value)
 	{
-		string productId = (*it)[0];
-		double bidPrice = GetPrice_d2s((*it)[1]);
-		double offerPrice = GetPrice_d2s((*it)[2]);
-		double midPrice = (bidPrice + offerPrice) / 2.0;
-		double spread = offerPrice - bidPrice;
-		
-		// Bond
-		if (T == BOND)
-		{
-			T curr_product = GetBond(productId);
-			Price<T> curr_price(curr_product, midPrice, spread);
-			service->OnMessage(curr_price);
-		}
+		T curr_product = GetBond(productId);
+		Price<T> curr_price(curr_product, midPrice, spread);
+		service->OnMessage(curr_price);
 	}
 }
 
@@ -9,6 +9,8 @@
 #define BondPricingService_hpp
 #include "soa.hpp"
 #include "my functions.hpp"
+#include "SeqlockTable.hpp"
+#include "MarketDataMessage.hpp"
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -51,7 +53,7 @@ public:
 	vector<string> print();
 	
 private:
-    const T& product;
+    T product;
     double mid;
     double bidOfferSpread;
 
@@ -60,6 +62,18 @@ private:
 
 
 
+/**
+ * Flat copy of a price, read from any thread through PricingService::GetSnapshot.
+ */
+struct PriceRecord
+{
+	double mid;
+	double bidOfferSpread;
+};
+
+
+
+
 /* Connector to PricingService */
 template<typename T>
 class PricingConnector;
@@ -69,6 +83,8 @@ class PricingConnector;
 
 /**
  * Pricing Service managing mid prices and bid/offers.
+ * GetData is for the service thread; other threads read prices through GetSnapshot,
+ * which copies a seqlock-versioned record and never blocks the service thread.
  * Keyed on product identifier.
  * Type T is the product type.
  */
@@ -94,10 +110,20 @@ public:
 	// Get the pointer to the connector on PricingService
 	PricingConnector<T>* GetConnector();
 	
+	// Copy the latest price of a product from any thread (false if there is none yet)
+	bool GetSnapshot(const string& key, PriceRecord& record) const;
+	
+	// Get the snapshot slot of a product (-1 if it has no price yet); readers may cache it
+	int GetSnapshotSlot(const string& key) const;
+	
+	// Copy the latest price of a snapshot slot from any thread (false if the slot is not in use)
+	bool GetSnapshot(int slot, PriceRecord& record) const;
+	
 private:
 	map<string, Price<T>> prices;					// a map of {product identifier -> price}
 	vector<ServiceListener<Price<T>>*> listeners;	// all listeners on PricingService
 	PricingConnector<T>* connector;					// a pointer to a PricingConnector
+	SeqlockTable<PriceRecord>* snapshots;			// latest price of each product for other threads
 };
 
 
@@ -117,6 +143,12 @@ public:
 	// Subscribe data from the Connector
 	void Subscribe(fstream& data_stream);
 	
+	// Subscribe one line of data from the Connector, split into words
+	void SubscribeLine(const vector<string>& words);
+	
+	// Subscribe the first # of words of a word buffer reused across lines
+	void SubscribeLine(const vector<string>& words, int wordCount);
+	
 private:
 	PricingService<T>* service;					// a pointer to a PricingService
 };
@@ -55,10 +55,17 @@ void PV01<T>::SetQuantity(long _quantity)
 	quantity = _quantity;
 }
 
+template<typename T>
+void PV01<T>::AddDelta(double _pv01Delta, long _quantityDelta)
+{
+	pv01 += _pv01Delta;
+	quantity += _quantityDelta;
+}
+
 template<typename T>
 vector<string> PV01<T>::GetPV01_pv2s()
 {
-	return GetPV01_pv2s<T>(product, pv01, quantity);
+	return ::GetPV01_pv2s<T>(product, pv01, quantity);
 }
 
 
@@ -83,6 +90,52 @@ const string& BucketedSector<T>::GetName() const
     return name;
 }
 
+template<typename T>
+const string& BucketedSector<T>::GetProductId() const
+{
+    return name;
+}
+
+
+
+
+template<typename T>
+KeyRateLadder<T>::KeyRateLadder(const BucketedSector<T> &_sector) :
+	sector(_sector)
+{
+	for (int i = 0; i < KEY_RATE_COUNT; i++)
+		pv01s[i] = 0.0;
+}
+
+template<typename T>
+const BucketedSector<T>& KeyRateLadder<T>::GetProduct() const
+{
+	return sector;
+}
+
+template<typename T>
+double KeyRateLadder<T>::GetPV01(int keyRate) const
+{
+	return pv01s[keyRate];
+}
+
+template<typename T>
+void KeyRateLadder<T>::AddDelta(const double* weights, double _pv01Delta)
+{
+	for (int i = 0; i < KEY_RATE_COUNT; i++)
+		pv01s[i] += weights[i] * _pv01Delta;
+}
+
+template<typename T>
+vector<string> KeyRateLadder<T>::GetKeyRateLadder_k2s() const
+{
+	vector<string> res;
+	res.push_back(sector.GetName());			// Append bucket name
+	for (int i = 0; i < KEY_RATE_COUNT; i++)
+		res.push_back(to_string(pv01s[i]));		// Append pv01 at each key rate
+	return res;
+}
+
 
 
 
@@ -92,6 +145,13 @@ RiskService<T>::RiskService()
     pv01s = map<string, PV01<T> >();
     listeners = vector<ServiceListener<PV01<T> >*>();
     listener = new RiskToPositionListener<T>(this);
+	pricingListener = new RiskToPricingListener<T>(this);
+	curveListener = new RiskToCurveListener<T>(this);
+	settlementDate = day_clock::local_day();
+	universe = BondUniverse(GetBonds(), settlementDate);
+	hasCurve = false;
+	ladder = KeyRateLadder<T>(BucketedSector<T>(GetBonds(), "TRSY"));
+	snapshots = new SeqlockTable<PV01Record>(64);
 }
 
 template<typename T>
@@ -115,7 +175,7 @@ void RiskService<T>::AddListener(ServiceListener<PV01<T>>* listener)
 }
 
 template<typename T>
-const RiskService<T>::vector<ServiceListener<PV01<T>>*>& GetListeners() const 
+const vector<ServiceListener<PV01<T>>*>& RiskService<T>::GetListeners() const 
 { 
 	return listeners; 
 }
@@ -125,23 +185,186 @@ RiskToPositionListener<T>* RiskService<T>::GetListener()
 { 
 	return listener; 
 }
+
+template<typename T>
+RiskToPricingListener<T>* RiskService<T>::GetPricingListener() 
+{ 
+	return pricingListener; 
+}
+
+template<typename T>
+RiskToCurveListener<T>* RiskService<T>::GetCurveListener() 
+{ 
+	return curveListener; 
+}
+
+template<typename T>
+void RiskService<T>::AddLadderListener(ServiceListener<KeyRateLadder<T>>* listener)
+{
+	ladderListeners.push_back(listener);
+}
+
+template<typename T>
+const KeyRateLadder<T>& RiskService<T>::GetKeyRateLadder() const
+{
+	return ladder;
+}
+
+template<typename T>
+const vector<double>& RiskService<T>::GetKeyRateWeights(const T& product)
+{
+	string productId = product.GetProductId();
+	unordered_map<string, vector<double>>::iterator it = keyRateWeights.find(productId);
+	if (it != keyRateWeights.end()) return it->second;
+	
+	// Split between the key rates around the maturity, linearly in maturity
+	double maturity = (product.GetMaturityDate() - settlementDate).days() / 365.25;
+	DiscountCurve keyRates(vector<double>(KEY_RATE_TENORS, KEY_RATE_TENORS + KEY_RATE_COUNT), vector<double>(KEY_RATE_COUNT, 0.0));
+	int lower, upper;
+	double weight;
+	keyRates.GetInterpolation(maturity, lower, upper, weight);
+	
+	vector<double> weights(KEY_RATE_COUNT, 0.0);
+	weights[lower] += 1.0 - weight;
+	weights[upper] += weight;
+	return keyRateWeights[productId] = weights;
+}
+
+template<typename T>
+void RiskService<T>::SetSettlementDate(const date& _settlementDate)
+{
+	settlementDate = _settlementDate;
+	analytics.clear();		// coupon schedules depend on the settlement date
+	keyRateWeights.clear();	// so do maturities in years
+	universe = BondUniverse(GetBonds(), settlementDate);
+	hasCurve = false;
+	
+	// Re-spread the risk held onto the key rates at the new maturities
+	ladder = KeyRateLadder<T>(BucketedSector<T>(GetBonds(), "TRSY"));
+	for (typename map<string, PV01<T>>::iterator it = pv01s.begin(); it != pv01s.end(); it++)
+		ladder.AddDelta(GetKeyRateWeights(it->second.GetProduct()).data(), it->second.GetPV01() * it->second.GetQuantity());
+	if (!pv01s.empty()) PublishLadder(true);
+}
+
+template<typename T>
+void RiskService<T>::UpdatePrice(Price<T>& price)
+{
+	const T& curr_product = price.GetProduct();
+	string productId = curr_product.GetProductId();
+	
+	typename unordered_map<string, BondAnalytics>::iterator it = analytics.find(productId);
+	if (it == analytics.end())
+		it = analytics.insert(make_pair(productId, BondAnalytics(curr_product, settlementDate))).first;
+	it->second.Reprice(price.GetMid());
+	
+	// Keep the risk of a held product (and its buckets) in line with the market,
+	// unless the risk is driven by the curve
+	typename map<string, PV01<T>>::iterator pv01_it = pv01s.find(productId);
+	if (hasCurve || pv01_it == pv01s.end()) return;
+	PublishRisk(ApplyRisk(curr_product, it->second.GetPV01(), pv01_it->second.GetQuantity()), false);
+	PublishLadder(false);
+}
+
+template<typename T>
+void RiskService<T>::UpdateCurve(const DiscountCurve& curve)
+{
+	universe.Reprice(curve);
+	hasCurve = true;
+	
+	// Only the risk that moved is sent: a curve move from one tenor on leaves the shorter bonds as they were
+	bool moved = false;
+	for (typename map<string, PV01<T>>::iterator it = pv01s.begin(); it != pv01s.end(); it++)
+	{
+		int index = universe.GetIndex(it->first);
+		if (index < 0 || universe.GetPV01(index) == it->second.GetPV01()) continue;
+		PublishRisk(ApplyRisk(it->second.GetProduct(), universe.GetPV01(index), it->second.GetQuantity()), false);
+		moved = true;
+	}
+	if (moved) PublishLadder(false);
+}
+
+template<typename T>
+double RiskService<T>::GetLivePV01(const string& productId)
+{
+	int index = universe.GetIndex(productId);
+	if (hasCurve && index >= 0) return universe.GetPV01(index);
+	
+	typename unordered_map<string, BondAnalytics>::iterator it = analytics.find(productId);
+	if (it != analytics.end() && it->second.GetPV01() > 0.0) return it->second.GetPV01();
+	return GetPV01(productId);
+}
 	
 template<typename T>
-const PV01<BucketedSector<T>>& RiskService<T>::GetBucketedRisk(const BucketedSector<T>& sector) const
+void RiskService<T>::AddBucketedSector(const BucketedSector<T>& sector)
 {
-    BucketedSector<T> curr_bs = sector;
-	vector<T> curr_products = sector.GetProducts();
-	double pv01Value = 0.0;
-	long quantity = 0;
+	if (bucketIndices.find(sector.GetName()) != bucketIndices.end()) return;
+	
+	int bucketIndex = bucketedRisks.size();
+	bucketIndices[sector.GetName()] = bucketIndex;
+	bucketedRisks.push_back(PV01<BucketedSector<T>>(sector, 0.0, 0));
 	
-	for (vector<T>::iterator it = curr_products.begin(); it != curr_products.end(); it++)
+	const vector<T>& curr_products = sector.GetProducts();
+	for (typename vector<T>::const_iterator it = curr_products.begin(); it != curr_products.end(); it++)
 	{
 		string productId = it->GetProductId();
-		pv01Value = pv01s[productId].GetPV01() * pv01s[productId].GetQuantity();
-		quantity += pv01s[productId].GetQuantity();
+		productBuckets[productId].push_back(bucketIndex);
+		
+		// Seed the bucket with any risk already held in this product
+		typename map<string, PV01<T>>::iterator pv01_it = pv01s.find(productId);
+		if (pv01_it != pv01s.end())
+		{
+			long quantity = pv01_it->second.GetQuantity();
+			bucketedRisks[bucketIndex].AddDelta(pv01_it->second.GetPV01() * quantity, quantity);
+		}
 	}
+}
 	
-    return PV01<BucketedSector<T> >(curr_bs, pv01Value, quantity);
+template<typename T>
+const PV01<BucketedSector<T>>& RiskService<T>::GetBucketedRisk(const BucketedSector<T>& sector)
+{
+	unordered_map<string, int>::iterator it = bucketIndices.find(sector.GetName());
+	if (it == bucketIndices.end())
+	{
+		AddBucketedSector(sector);
+		it = bucketIndices.find(sector.GetName());
+	}
+	
+    return bucketedRisks[it->second];
+}
+
+template<typename T>
+PV01<T>& RiskService<T>::ApplyRisk(const T& product, double pv01Value, long quantity)
+{
+    string productId = product.GetProductId();
+	
+	// Risk previously held in this product
+	double oldRisk = 0.0;
+	long oldQuantity = 0;
+	typename map<string, PV01<T>>::iterator pv01_it = pv01s.find(productId);
+	if (pv01_it != pv01s.end())
+	{
+		oldQuantity = pv01_it->second.GetQuantity();
+		oldRisk = pv01_it->second.GetPV01() * oldQuantity;
+	}
+	
+	// Update pv01 value
+    PV01<T>& new_pv01 = pv01s[productId];
+	new_pv01 = PV01<T>(product, pv01Value, quantity);
+	PV01Record record = { pv01Value, quantity };
+	snapshots->Write(productId, record);
+	
+	// Apply only the change in this product to the buckets it belongs to and to the key rate ladder
+	double riskDelta = pv01Value * quantity - oldRisk;
+	long quantityDelta = quantity - oldQuantity;
+	unordered_map<string, vector<int>>::iterator bucket_it = productBuckets.find(productId);
+	if (bucket_it != productBuckets.end())
+	{
+		for (vector<int>::iterator it = bucket_it->second.begin(); it != bucket_it->second.end(); it++)
+			bucketedRisks[*it].AddDelta(riskDelta, quantityDelta);
+	}
+	ladder.AddDelta(GetKeyRateWeights(product).data(), riskDelta);
+	
+	return new_pv01;
 }
 
 template<typename T>
@@ -149,15 +372,39 @@ void RiskService<T>::AddPosition(Position<T>& position)
 {
     T curr_product = position.GetProduct();
     string productId = curr_product.GetProductId();
-    double pv01Value = GetPV01Value(productId);
+    double pv01Value = GetLivePV01(productId);
     long quantity = position.GetAggregatePosition();
 	
-	// Update pv01 value
-    PV01<T> new_pv01(curr_product, pv01Value, quantity);
-    pv01s[productId] = new_pv01;
-    
-    for (vector<ServiceListener<PV01<T>>*>::iterator it = listeners.begin(); it != listeners.end(); it++)
-        (*it)->ProcessAdd(new_pv01);
+    PublishRisk(ApplyRisk(curr_product, pv01Value, quantity), true);
+	PublishLadder(true);
+}
+
+template<typename T>
+void RiskService<T>::PublishRisk(PV01<T>& pv01, bool isNewPosition)
+{
+	// Listeners get a copy, as the stored risk may move under them
+	PV01<T> new_pv01 = pv01;
+	for (typename vector<ServiceListener<PV01<T>>*>::iterator it = listeners.begin(); it != listeners.end(); it++)
+	{
+		if (isNewPosition) (*it)->ProcessAdd(new_pv01);
+		else (*it)->ProcessUpdate(new_pv01);
+	}
+}
+
+template<typename T>
+void RiskService<T>::PublishLadder(bool isNewPosition)
+{
+	for (typename vector<ServiceListener<KeyRateLadder<T>>*>::iterator it = ladderListeners.begin(); it != ladderListeners.end(); it++)
+	{
+		if (isNewPosition) (*it)->ProcessAdd(ladder);
+		else (*it)->ProcessUpdate(ladder);
+	}
+}
+
+template<typename T>
+bool RiskService<T>::GetSnapshot(const string& key, PV01Record& record) const
+{
+	return snapshots->Read(key, record);
 }
 
 
@@ -175,4 +422,62 @@ void RiskToPositionListener<T>::ProcessAdd(Position<T>& _data)
 	service->AddPosition(_data);
 }
 
+template<typename T>
+void RiskToPositionListener<T>::ProcessRemove(Position<T>& _data)
+{
+}
+
+template<typename T>
+void RiskToPositionListener<T>::ProcessUpdate(Position<T>& _data)
+{
+}
+
+
+
+
+template<typename T>
+RiskToPricingListener<T>::RiskToPricingListener(RiskService<T>* _service)
+{
+	service = _service;
+}
+
+template<typename T>
+void RiskToPricingListener<T>::ProcessAdd(Price<T>& _data)
+{
+	service->UpdatePrice(_data);
+}
+
+template<typename T>
+void RiskToPricingListener<T>::ProcessRemove(Price<T>& _data)
+{
+}
+
+template<typename T>
+void RiskToPricingListener<T>::ProcessUpdate(Price<T>& _data)
+{
+}
+
+
+
+
+template<typename T>
+RiskToCurveListener<T>::RiskToCurveListener(RiskService<T>* _service)
+{
+	service = _service;
+}
+
+template<typename T>
+void RiskToCurveListener<T>::ProcessAdd(DiscountCurve& _data)
+{
+	service->UpdateCurve(_data);
+}
+
+template<typename T>
+void RiskToCurveListener<T>::ProcessRemove(DiscountCurve& _data)
+{
+}
 
+template<typename T>
+void RiskToCurveListener<T>::ProcessUpdate(DiscountCurve& _data)
+{
+}
@@ -9,6 +9,10 @@
 #include "soa.hpp"
 #include "my functions.hpp"
 #include "BondPositionService.hpp"
+#include "BondPricingService.hpp"
+#include "BondAnalytics.hpp"
+#include "BondBatchAnalytics.hpp"
+#include "SeqlockTable.hpp"
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -49,6 +53,9 @@ public:
 	
 	// Set the quantity that this risk value is associated with
 	void SetQuantity(long _quantity);
+	
+	// Apply a change in pv01 value and quantity (used by bucketed risk)
+	void AddDelta(double _pv01Delta, long _quantityDelta);
 
 	// Convert pv01 data -> vector<string> format
 	vector<string> GetPV01_pv2s();
@@ -83,6 +90,9 @@ public:
 
     // Get the name of the bucket
     const string& GetName() const;
+	
+	// Get the identifier of the bucket (its name), so that bucketed risk is persisted like product risk
+	const string& GetProductId() const;
 
 private:
     vector<T> products;
@@ -93,15 +103,78 @@ private:
 
 
 
+/* Key rates of the risk ladder, in years */
+const int KEY_RATE_COUNT = 7;
+const double KEY_RATE_TENORS[KEY_RATE_COUNT] = { 2.0, 3.0, 5.0, 7.0, 10.0, 20.0, 30.0 };
+
+/**
+ * Key rate risk ladder of a bucket sector.
+ * The PV01 of each bond is split between the two key rates around its maturity,
+ * linearly in maturity, and summed in a flat array.
+ * Type T is the product type.
+ */
+template<typename T>
+class KeyRateLadder
+{
+
+public:
+	// default ctor
+	KeyRateLadder() = default;
+	
+	// ctor for an empty ladder
+	KeyRateLadder(const BucketedSector<T> &_sector);
+	
+	// Get the bucket sector of the ladder
+	const BucketedSector<T>& GetProduct() const;
+	
+	// Get the PV01 at a key rate
+	double GetPV01(int keyRate) const;
+	
+	// Add a change in PV01 split across the key rates by weights
+	void AddDelta(const double* weights, double _pv01Delta);
+	
+	// Convert key rate ladder data -> vector<string> format
+	vector<string> GetKeyRateLadder_k2s() const;
+	
+private:
+	BucketedSector<T> sector;
+	double pv01s[KEY_RATE_COUNT];
+};
+
+
+
+
+/**
+ * Flat copy of the risk of a product, read from any thread through RiskService::GetSnapshot.
+ */
+struct PV01Record
+{
+	double pv01;				// PV01 per unit
+	long quantity;				// quantity held
+};
+
+
+
+
 /* Listener of BondRiskService to BondPositionService */
 template<typename T>
 class RiskToPositionListener;
 
+/* Listener of BondRiskService to PricingService */
+template<typename T>
+class RiskToPricingListener;
+
+/* Listener of BondRiskService to CurveService */
+template<typename T>
+class RiskToCurveListener;
+
 
 
 
 /**
  * Risk Service to vend out risk for a particular security and across a risk bucketed sector.
+ * GetData is for the service thread; other threads read the risk of a product through GetSnapshot,
+ * which copies a seqlock-versioned record and never blocks the service thread.
  * Keyed on product identifier.
  * Type T is the product type.
  */
@@ -127,16 +200,73 @@ public:
 	// Get the listener to BondPositionService
 	RiskToPositionListener<T>* GetListener();
 	
-    // Get the bucketed risk for the bucket sector
-    const PV01< BucketedSector<T>>& GetBucketedRisk(const BucketedSector<T>& sector) const;
+	// Get the listener to PricingService
+	RiskToPricingListener<T>* GetPricingListener();
+	
+	// Get the listener to CurveService
+	RiskToCurveListener<T>* GetCurveListener();
+	
+	// Add a listener for the key rate ladder published after every new position
+	void AddLadderListener(ServiceListener<KeyRateLadder<T>>* listener);
+	
+	// Get the key rate ladder
+	const KeyRateLadder<T>& GetKeyRateLadder() const;
+	
+	// Set the settlement date used to compute PV01 from prices
+	void SetSettlementDate(const date& _settlementDate);
+	
+	// Update the live PV01 of a product from its latest mid price, and send the risk of a held product and the ladder as updates
+	void UpdatePrice(Price<T>& price);
+	
+	// Reprice the whole bond universe off a new curve, refresh the risk of every position and send it with the ladder as updates
+	void UpdateCurve(const DiscountCurve& curve);
+	
+	// Get the live PV01 of a product, from the curve once there is one, else from its latest mid
+	// (falls back to the static PV01 table before any price is seen)
+	double GetLivePV01(const string& productId);
+	
+	// Register a bucket sector so that its risk is aggregated on every new position
+	void AddBucketedSector(const BucketedSector<T>& sector);
+	
+    // Get the bucketed risk for the bucket sector (registered on first use)
+    const PV01< BucketedSector<T>>& GetBucketedRisk(const BucketedSector<T>& sector);
 
     // Add a position that the service will risk
     void AddPosition(Position<T>& position);
+	
+	// Copy the latest risk of a product from any thread (false if there is none yet)
+	bool GetSnapshot(const string& key, PV01Record& record) const;
 
 private:
     map<string, PV01<T>> pv01s;						// a map of {product identifier -> pv01 value}
     vector<ServiceListener<PV01<T>>*> listeners;	// all listeners on BondRiskService 
     RiskToPositionListener<T>* listener;			// listener to BondPositionService
+	RiskToPricingListener<T>* pricingListener;		// listener to PricingService
+	RiskToCurveListener<T>* curveListener;			// listener to CurveService
+	date settlementDate;							// settlement date for the bond analytics
+	unordered_map<string, BondAnalytics> analytics;	// a map of {product identifier -> bond analytics}
+	BondUniverse universe;							// batch analytics over all bonds from GetBonds
+	bool hasCurve;									// whether the universe has been priced off a curve
+	KeyRateLadder<T> ladder;						// key rate ladder of the whole book
+	vector<ServiceListener<KeyRateLadder<T>>*> ladderListeners;	// all listeners on the key rate ladder
+	unordered_map<string, vector<double>> keyRateWeights;	// a map of {product identifier -> weight of each key rate}
+	SeqlockTable<PV01Record>* snapshots;			// latest risk of each product for other threads
+	vector<PV01<BucketedSector<T>>> bucketedRisks;	// aggregated risk of each registered bucket sector
+	unordered_map<string, int> bucketIndices;		// a map of {bucket name -> index in bucketedRisks}
+	unordered_map<string, vector<int>> productBuckets;	// a map of {product identifier -> indices of its buckets}
+	
+	// Get the weight of each key rate for a product, from its maturity
+	const vector<double>& GetKeyRateWeights(const T& product);
+	
+	// Store the risk of a product and apply its change to the buckets it belongs to
+	PV01<T>& ApplyRisk(const T& product, double pv01Value, long quantity);
+	
+	// Send the risk of a product to the listeners, as an add on a new position and as an update on a market move
+	// (so that the historical data listeners only persist the risk of new positions)
+	void PublishRisk(PV01<T>& pv01, bool isNewPosition);
+	
+	// Send the key rate ladder to the ladder listeners, as an add on a new position and as an update on a market move
+	void PublishLadder(bool isNewPosition);
 };
 
 
@@ -166,4 +296,52 @@ private:
 
 
 
+/* Listener of BondRiskService to PricingService */
+template<typename T>
+class RiskToPricingListener : public ServiceListener<Price<T>>
+{
+public:
+	// ctor
+    RiskToPricingListener(RiskService<T>* _service);
+
+    // Listener callback to process an add event to BondRiskService
+    void ProcessAdd(Price<T>& _data);
+	
+    // Listener callback to process a remove event to BondRiskService
+    void ProcessRemove(Price<T>& _data);
+	
+    // Listener callback to process an update event to BondRiskService
+    void ProcessUpdate(Price<T>& _data);
+	
+private:
+    RiskService<T>* service;						// a pointer to BondRiskService
+};
+
+
+
+
+/* Listener of BondRiskService to CurveService */
+template<typename T>
+class RiskToCurveListener : public ServiceListener<DiscountCurve>
+{
+public:
+	// ctor
+    RiskToCurveListener(RiskService<T>* _service);
+
+    // Listener callback to process an add event to BondRiskService
+    void ProcessAdd(DiscountCurve& _data);
+	
+    // Listener callback to process a remove event to BondRiskService
+    void ProcessRemove(DiscountCurve& _data);
+	
+    // Listener callback to process an update event to BondRiskService
+    void ProcessUpdate(DiscountCurve& _data);
+	
+private:
+    RiskService<T>* service;						// a pointer to BondRiskService
+};
+
+
+
+
 #endif
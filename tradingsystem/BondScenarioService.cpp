@@ -0,0 +1,306 @@
+/**
+ * BondScenarioService.cpp
+ * Defines the data types and Service for scenario and stress risk on the current positions.
+ *
+ * @author Jordan Wang
+ */
+
+#include "BondScenarioService.hpp"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+using namespace std;
+
+
+
+
+CurveScenario::CurveScenario(string _name, const vector<double> &_shifts) :
+	shifts(_shifts)
+{
+	name = _name;
+}
+
+const string& CurveScenario::GetName() const
+{
+	return name;
+}
+
+const string& CurveScenario::GetProductId() const
+{
+	return name;
+}
+
+const vector<double>& CurveScenario::GetShifts() const
+{
+	return shifts;
+}
+
+DiscountCurve CurveScenario::Apply(const DiscountCurve &curve) const
+{
+	vector<double> zeroRates = curve.GetZeroRates();
+	int tenorCount = min(zeroRates.size(), shifts.size());
+	for (int i = 0; i < tenorCount; i++)
+		zeroRates[i] += shifts[i];
+	return DiscountCurve(curve.GetTenors(), zeroRates);
+}
+
+
+
+
+CurveScenario GetParallelScenario(string name, const vector<double> &tenors, double shift)
+{
+	return CurveScenario(name, vector<double>(tenors.size(), shift));
+}
+
+CurveScenario GetTwistScenario(string name, const vector<double> &tenors, double shortShift, double longShift)
+{
+	vector<double> shifts;
+	double span = tenors.back() - tenors.front();
+	for (vector<double>::const_iterator it = tenors.begin(); it != tenors.end(); it++)
+	{
+		double x = (span > 0.0) ? (*it - tenors.front()) / span : 0.0;
+		shifts.push_back(shortShift + x * (longShift - shortShift));
+	}
+	return CurveScenario(name, shifts);
+}
+
+CurveScenario GetButterflyScenario(string name, const vector<double> &tenors, double wingShift, double bellyShift)
+{
+	vector<double> shifts;
+	double span = tenors.back() - tenors.front();
+	for (vector<double>::const_iterator it = tenors.begin(); it != tenors.end(); it++)
+	{
+		double x = (span > 0.0) ? (*it - tenors.front()) / span : 0.0;
+		shifts.push_back(wingShift + (1.0 - fabs(2.0 * x - 1.0)) * (bellyShift - wingShift));
+	}
+	return CurveScenario(name, shifts);
+}
+
+CurveScenario GetHistoricalScenario(string name, const DiscountCurve &startCurve, const DiscountCurve &endCurve)
+{
+	const vector<double>& startRates = startCurve.GetZeroRates();
+	const vector<double>& endRates = endCurve.GetZeroRates();
+	vector<double> shifts;
+	for (int i = 0; i < (int)min(startRates.size(), endRates.size()); i++)
+		shifts.push_back(endRates[i] - startRates[i]);
+	return CurveScenario(name, shifts);
+}
+
+
+
+
+ScenarioPnL::ScenarioPnL(const CurveScenario &_scenario, double _baseValue, double _pnl) :
+	scenario(_scenario)
+{
+	baseValue = _baseValue;
+	pnl = _pnl;
+}
+
+const CurveScenario& ScenarioPnL::GetProduct() const
+{
+	return scenario;
+}
+
+double ScenarioPnL::GetBaseValue() const
+{
+	return baseValue;
+}
+
+double ScenarioPnL::GetPnL() const
+{
+	return pnl;
+}
+
+vector<string> ScenarioPnL::GetScenarioPnL_s2s() const
+{
+	vector<string> res;
+	res.push_back(scenario.GetName());		// Append scenario name
+	res.push_back(to_string(baseValue));	// Append base value
+	res.push_back(to_string(pnl));			// Append P&L
+	return res;
+}
+
+
+
+
+template<typename T>
+ScenarioService<T>::ScenarioService(int _threadCount) :
+	pool(_threadCount)
+{
+	scenarioPnLs = map<string, ScenarioPnL>();
+	listeners = vector<ServiceListener<ScenarioPnL>*>();
+	listener = new ScenarioToPositionListener<T>(this);
+	curveListener = new ScenarioToCurveListener<T>(this);
+	universe = BondUniverse(GetBonds(), day_clock::local_day());
+	quantities = vector<double>(universe.GetSize(), 0.0);
+}
+
+template<typename T>
+ScenarioPnL& ScenarioService<T>::GetData(string key)
+{
+	return scenarioPnLs[key];
+}
+
+template<typename T>
+void ScenarioService<T>::OnMessage(ScenarioPnL& data)
+{
+	scenarioPnLs[data.GetProduct().GetName()] = data;
+}
+
+template<typename T>
+void ScenarioService<T>::AddListener(ServiceListener<ScenarioPnL>* listener)
+{
+	listeners.push_back(listener);
+}
+
+template<typename T>
+const vector<ServiceListener<ScenarioPnL>*>& ScenarioService<T>::GetListeners() const
+{
+	return listeners;
+}
+
+template<typename T>
+ScenarioToPositionListener<T>* ScenarioService<T>::GetListener()
+{
+	return listener;
+}
+
+template<typename T>
+ScenarioToCurveListener<T>* ScenarioService<T>::GetCurveListener()
+{
+	return curveListener;
+}
+
+template<typename T>
+void ScenarioService<T>::SetSettlementDate(const date& _settlementDate)
+{
+	universe = BondUniverse(GetBonds(), _settlementDate);
+}
+
+template<typename T>
+void ScenarioService<T>::AddScenario(const CurveScenario& scenario)
+{
+	scenarios.push_back(scenario);
+}
+
+template<typename T>
+const vector<CurveScenario>& ScenarioService<T>::GetScenarios() const
+{
+	return scenarios;
+}
+
+template<typename T>
+void ScenarioService<T>::UpdatePosition(Position<T>& position)
+{
+	int index = universe.GetIndex(position.GetProduct().GetProductId());
+	if (index >= 0) quantities[index] = position.GetAggregatePosition();
+}
+
+template<typename T>
+void ScenarioService<T>::UpdateCurve(const DiscountCurve& curve)
+{
+	baseCurve = curve;
+	if (openingCurve.GetZeroRates().empty()) openingCurve = curve;
+}
+
+template<typename T>
+const DiscountCurve& ScenarioService<T>::GetOpeningCurve() const
+{
+	return openingCurve;
+}
+
+template<typename T>
+void ScenarioService<T>::RunScenarios()
+{
+	if (baseCurve.GetZeroRates().empty() || scenarios.empty()) return;
+	
+	// Value the portfolio on the base curve (prices are per 100 face)
+	int bondCount = universe.GetSize();
+	universe.Reprice(baseCurve);
+	double baseValue = 0.0;
+	for (int i = 0; i < bondCount; i++)
+		baseValue += quantities[i] * universe.GetPrice(i) / 100.0;
+	
+	// Revalue under every scenario, each worker on its own copy of the universe
+	vector<BondUniverse> workerUniverses(pool.GetThreadCount(), universe);
+	vector<double> pnls(scenarios.size(), 0.0);
+	pool.ParallelFor(scenarios.size(), 16, [&](int begin, int end, int worker)
+	{
+		BondUniverse& workerUniverse = workerUniverses[worker];
+		for (int s = begin; s < end; s++)
+		{
+			workerUniverse.Reprice(scenarios[s].Apply(baseCurve));
+			double value = 0.0;
+			for (int i = 0; i < bondCount; i++)
+				value += quantities[i] * workerUniverse.GetPrice(i) / 100.0;
+			pnls[s] = value - baseValue;
+		}
+	});
+	
+	// Publish the results in scenario order
+	for (int s = 0; s < (int)scenarios.size(); s++)
+	{
+		ScenarioPnL scenarioPnL(scenarios[s], baseValue, pnls[s]);
+		scenarioPnLs[scenarios[s].GetName()] = scenarioPnL;
+		for (vector<ServiceListener<ScenarioPnL>*>::iterator it = listeners.begin(); it != listeners.end(); it++)
+			(*it)->ProcessAdd(scenarioPnL);
+	}
+}
+
+
+
+
+template<typename T>
+ScenarioToPositionListener<T>::ScenarioToPositionListener(ScenarioService<T>* _service)
+{
+	service = _service;
+}
+
+template<typename T>
+void ScenarioToPositionListener<T>::ProcessAdd(Position<T>& _data)
+{
+	service->UpdatePosition(_data);
+}
+
+template<typename T>
+void ScenarioToPositionListener<T>::ProcessRemove(Position<T>& _data)
+{
+}
+
+template<typename T>
+void ScenarioToPositionListener<T>::ProcessUpdate(Position<T>& _data)
+{
+}
+
+
+
+
+template<typename T>
+ScenarioToCurveListener<T>::ScenarioToCurveListener(ScenarioService<T>* _service)
+{
+	service = _service;
+}
+
+template<typename T>
+void ScenarioToCurveListener<T>::ProcessAdd(DiscountCurve& _data)
+{
+	service->UpdateCurve(_data);
+}
+
+template<typename T>
+void ScenarioToCurveListener<T>::ProcessRemove(DiscountCurve& _data)
+{
+}
+
+template<typename T>
+void ScenarioToCurveListener<T>::ProcessUpdate(DiscountCurve& _data)
+{
+}
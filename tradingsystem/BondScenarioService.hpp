@@ -0,0 +1,239 @@
+/**
+ * BondScenarioService.hpp
+ * Defines the data types and Service for scenario and stress risk on the current positions.
+ *
+ * @author Jordan Wang
+ */
+#ifndef BondScenarioService_hpp
+#define BondScenarioService_hpp
+#include "soa.hpp"
+#include "my functions.hpp"
+#include "BondPositionService.hpp"
+#include "BondBatchAnalytics.hpp"
+#include "DiscountCurve.hpp"
+#include "WorkStealingPool.hpp"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <map>
+#include <unordered_map>
+using namespace std;
+
+
+
+
+/**
+ * A curve scenario shifting the zero rate at each tenor of the curve.
+ */
+class CurveScenario
+{
+
+public:
+	// default ctor
+	CurveScenario() = default;
+
+	// ctor for a scenario from the zero rate shift at each tenor (in decimal, i.e. 0.0001 is 1bp)
+	CurveScenario(string _name, const vector<double> &_shifts);
+
+	// Get the name of the scenario
+	const string& GetName() const;
+
+	// Get the scenario identifier, so that scenario results are persisted like products
+	const string& GetProductId() const;
+
+	// Get the zero rate shift at each tenor
+	const vector<double>& GetShifts() const;
+
+	// Apply the scenario to a curve
+	DiscountCurve Apply(const DiscountCurve &curve) const;
+
+private:
+	string name;
+	vector<double> shifts;
+};
+
+
+
+
+// Build a parallel shift of every tenor
+CurveScenario GetParallelScenario(string name, const vector<double> &tenors, double shift);
+
+// Build a twist moving the shortest tenor by shortShift and the longest by longShift, linear in between
+CurveScenario GetTwistScenario(string name, const vector<double> &tenors, double shortShift, double longShift);
+
+// Build a butterfly moving both wings by wingShift and the middle of the curve by bellyShift, linear in between
+CurveScenario GetButterflyScenario(string name, const vector<double> &tenors, double wingShift, double bellyShift);
+
+// Build a historical scenario from two curves observed on different days
+CurveScenario GetHistoricalScenario(string name, const DiscountCurve &startCurve, const DiscountCurve &endCurve);
+
+
+
+
+/**
+ * P&L of the portfolio under a curve scenario.
+ */
+class ScenarioPnL
+{
+
+public:
+	// default ctor
+	ScenarioPnL() = default;
+
+	// ctor for the P&L of a scenario
+	ScenarioPnL(const CurveScenario &_scenario, double _baseValue, double _pnl);
+
+	// Get the scenario
+	const CurveScenario& GetProduct() const;
+
+	// Get the portfolio value on the base curve
+	double GetBaseValue() const;
+
+	// Get the portfolio P&L under the scenario
+	double GetPnL() const;
+
+	// Convert scenario P&L data -> vector<string> format
+	vector<string> GetScenarioPnL_s2s() const;
+
+private:
+	CurveScenario scenario;
+	double baseValue;
+	double pnl;
+};
+
+
+
+
+/* Listener of ScenarioService to PositionService */
+template<typename T>
+class ScenarioToPositionListener;
+
+/* Listener of ScenarioService to CurveService */
+template<typename T>
+class ScenarioToCurveListener;
+
+
+
+
+/**
+ * Scenario Service revaluing the current positions under a set of curve scenarios.
+ * Scenarios are split in chunks over a work stealing thread pool, each worker repricing
+ * its own copy of the bond universe, and the results are published to the listeners.
+ * Keyed on scenario name.
+ * Type T is the product type.
+ */
+template<typename T>
+class ScenarioService : public Service<string, ScenarioPnL>
+{
+public:
+	// ctor for a service running on a # of threads (0 for one per core)
+	ScenarioService(int _threadCount);
+
+    // Get data on our service given a key
+    ScenarioPnL& GetData(string key);
+
+    // The callback that a Connector should invoke for any new or updated data
+    void OnMessage(ScenarioPnL& data);
+
+    // Add a listener to ScenarioService for callbacks on add, remove, and update events for data to ScenarioService
+    void AddListener(ServiceListener<ScenarioPnL>* listener);
+
+    // Get all listeners on ScenarioService
+    const vector<ServiceListener<ScenarioPnL>*>& GetListeners() const;
+
+	// Get the listener to PositionService
+	ScenarioToPositionListener<T>* GetListener();
+
+	// Get the listener to CurveService
+	ScenarioToCurveListener<T>* GetCurveListener();
+
+	// Set the settlement date used to revalue the bonds
+	void SetSettlementDate(const date& _settlementDate);
+
+	// Add a scenario to run
+	void AddScenario(const CurveScenario& scenario);
+
+	// Get the scenarios to run
+	const vector<CurveScenario>& GetScenarios() const;
+
+	// Update the position held in a product
+	void UpdatePosition(Position<T>& position);
+
+	// Update the base curve
+	void UpdateCurve(const DiscountCurve& curve);
+
+	// Get the first curve of the day, the start of the day's historical move
+	const DiscountCurve& GetOpeningCurve() const;
+
+	// Revalue the portfolio under every scenario and publish the P&Ls
+	void RunScenarios();
+
+private:
+    map<string, ScenarioPnL> scenarioPnLs;					// a map of {scenario name -> scenario P&L}
+    vector<ServiceListener<ScenarioPnL>*> listeners;		// all listeners on ScenarioService
+    ScenarioToPositionListener<T>* listener;				// a pointer to a listener to PositionService
+    ScenarioToCurveListener<T>* curveListener;				// a pointer to a listener to CurveService
+	WorkStealingPool pool;									// thread pool running the scenarios
+	BondUniverse universe;									// bond universe to revalue
+	vector<double> quantities;								// position quantity of each bond in the universe
+	DiscountCurve baseCurve;								// latest curve
+	DiscountCurve openingCurve;								// first curve of the day
+	vector<CurveScenario> scenarios;						// scenarios to run
+};
+
+
+
+
+/* Listener of ScenarioService to PositionService */
+template<typename T>
+class ScenarioToPositionListener : public ServiceListener<Position<T>>
+{
+public:
+	// ctor
+    ScenarioToPositionListener(ScenarioService<T>* _service);
+
+    // Listener callback to process an add event to ScenarioService
+    void ProcessAdd(Position<T>& _data);
+
+    // Listener callback to process a remove event to ScenarioService
+    void ProcessRemove(Position<T>& _data);
+
+    // Listener callback to process an update event to ScenarioService
+    void ProcessUpdate(Position<T>& _data);
+
+private:
+    ScenarioService<T>* service;					// a pointer to ScenarioService
+};
+
+
+
+
+/* Listener of ScenarioService to CurveService */
+template<typename T>
+class ScenarioToCurveListener : public ServiceListener<DiscountCurve>
+{
+public:
+	// ctor
+    ScenarioToCurveListener(ScenarioService<T>* _service);
+
+    // Listener callback to process an add event to ScenarioService
+    void ProcessAdd(DiscountCurve& _data);
+
+    // Listener callback to process a remove event to ScenarioService
+    void ProcessRemove(DiscountCurve& _data);
+
+    // Listener callback to process an update event to ScenarioService
+    void ProcessUpdate(DiscountCurve& _data);
+
+private:
+    ScenarioService<T>* service;					// a pointer to ScenarioService
+};
+
+
+
+
+#endif
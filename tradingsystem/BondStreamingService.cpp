@@ -15,6 +15,10 @@
 #include <chrono>
 #include <map>
 #include <unordered_map>
+#include <deque>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 using namespace std;
 
 
@@ -50,7 +54,7 @@ PricingSide PriceStreamOrder::GetSide() const
 
 vector<string> PriceStreamOrder::GetPriceStreamOrder_pso2s() const
 {
-	return GetPriceStreamOrder_pso2s<T>(price, visibleQuantity, hiddenQuantity, side);
+	return ::GetPriceStreamOrder_pso2s(price, visibleQuantity, hiddenQuantity, side);
 }
 
 
@@ -83,7 +87,51 @@ const PriceStreamOrder& PriceStream<T>::GetOfferOrder() const
 template<typename T>
 vector<string> PriceStream<T>::GetPriceStream_ps2s() const
 {
-	return GetPriceStream_ps2s<T>(product, bidOrder.GetPriceStreamOrder_pso2s(), offerOrder.GetPriceStreamOrder_pso2s());
+	return ::GetPriceStream_ps2s<T>(product, bidOrder.GetPriceStreamOrder_pso2s(), offerOrder.GetPriceStreamOrder_pso2s());
+}
+
+
+
+
+template<typename T>
+PriceStreamDelta<T>::PriceStreamDelta(const PriceStream<T>& _priceStream, int _changedFields) :
+	priceStream(_priceStream), changedFields(_changedFields)
+{
+}
+
+template<typename T>
+const T& PriceStreamDelta<T>::GetProduct() const
+{
+	return priceStream.GetProduct();
+}
+
+template<typename T>
+int PriceStreamDelta<T>::GetChangedFields() const
+{
+	return changedFields;
+}
+
+template<typename T>
+const PriceStream<T>& PriceStreamDelta<T>::GetPriceStream() const
+{
+	return priceStream;
+}
+
+template<typename T>
+vector<string> PriceStreamDelta<T>::GetPriceStream_ps2s() const
+{
+	const PriceStreamOrder& bidOrder = priceStream.GetBidOrder();
+	const PriceStreamOrder& offerOrder = priceStream.GetOfferOrder();
+	
+	vector<string> res;
+	res.push_back(priceStream.GetProduct().GetProductId());
+	if (changedFields & PRICE_STREAM_BID_PRICE) res.push_back("BID=" + GetPrice_d2s(bidOrder.GetPrice()));
+	if (changedFields & PRICE_STREAM_BID_VISIBLE) res.push_back("BIDVISIBLE=" + to_string(bidOrder.GetVisibleQuantity()));
+	if (changedFields & PRICE_STREAM_BID_HIDDEN) res.push_back("BIDHIDDEN=" + to_string(bidOrder.GetHiddenQuantity()));
+	if (changedFields & PRICE_STREAM_OFFER_PRICE) res.push_back("OFFER=" + GetPrice_d2s(offerOrder.GetPrice()));
+	if (changedFields & PRICE_STREAM_OFFER_VISIBLE) res.push_back("OFFERVISIBLE=" + to_string(offerOrder.GetVisibleQuantity()));
+	if (changedFields & PRICE_STREAM_OFFER_HIDDEN) res.push_back("OFFERHIDDEN=" + to_string(offerOrder.GetHiddenQuantity()));
+	return res;
 }
 
 
@@ -111,6 +159,19 @@ AlgoStreamingService<T>::AlgoStreamingService()
     listeners = vector<ServiceListener<AlgoStream<T> >*>();
     listener = new AlgoStreamingToPricingListener<T>(this);
     count = 0;
+	visibleQuantities[0] = 10000000;
+	visibleQuantities[1] = 2000000;
+	hiddenRatio = 2.0;
+	maxSkew = 1.0 / 128.0;
+	positionLimit = 100000000;
+	positionListener = new AlgoStreamingToPositionListener<T>(this);
+	positionService = nullptr;
+	marketDataService = nullptr;
+	timers = nullptr;
+	timerListener = new AlgoStreamingToTimerListener<T>(this);
+	requoteTimerId = -1;
+	requoteBudget = 64;
+	suppressedCount = 0;
 }
 
 template<typename T>
@@ -122,8 +183,8 @@ AlgoStream<T>&  AlgoStreamingService<T>::GetData(string key)
 template<typename T>
 void AlgoStreamingService<T>::OnMessage(AlgoStream<T>& data)
 {
-	PriceStream<T> priceStream = data.GetPriceStream();
-	T curr_product = priceStream.GetProduct();
+	PriceStream<T>* priceStream = data.GetPriceStream();
+	T curr_product = priceStream->GetProduct();
 	string productId = curr_product.GetProductId();
     algoStreams[productId] = data;
 }
@@ -146,28 +207,181 @@ AlgoStreamingToPricingListener<T>* AlgoStreamingService<T>::GetListener()
 	return listener;
 }
 
+template<typename T>
+AlgoStreamingToPositionListener<T>* AlgoStreamingService<T>::GetPositionListener()
+{
+	return positionListener;
+}
+
 template<typename T>
 void AlgoStreamingService<T>::PublishPrice(Price<T>& price)
 {
-    T curr_product = price.GetProduct();
-    string productId = curr_product.GetProductId();
-    
-    double mid = price.GetMid();
-    double bidOfferSpread = price.GetBidOfferSpread();
-    double bidPrice = mid - bidOfferSpread / 2.0;
-    double offerPrice = mid + bidOfferSpread / 2.0;
-	long visibleQuantity = (count % 2 == 0) ? 10000000 : 2000000;
-    long hiddenQuantity = visibleQuantity * 2;
+	int slot = GetQuoteSlot(price.GetProduct().GetProductId());
+	latestPrices[slot] = price;
+	quoteStates[slot].hasPrice = true;
+	MarkDirty(slot);
+}
+
+template<typename T>
+void AlgoStreamingService<T>::OnPosition(Position<T>& position)
+{
+	// The product is in the position snapshots from its first position on, so its slot is looked up once
+	string productId = position.GetProduct().GetProductId();
+	int slot = GetQuoteSlot(productId);
+	if (positionService != nullptr && quoteStates[slot].positionSlot < 0) quoteStates[slot].positionSlot = positionService->GetSnapshotSlot(productId);
+	MarkDirty(slot);
+}
+
+template<typename T>
+void AlgoStreamingService<T>::SetQuoteSizes(long firstVisibleQuantity, long secondVisibleQuantity, double _hiddenRatio)
+{
+	visibleQuantities[0] = firstVisibleQuantity;
+	visibleQuantities[1] = secondVisibleQuantity;
+	hiddenRatio = _hiddenRatio;
+}
+
+template<typename T>
+void AlgoStreamingService<T>::SetInventorySkew(double _maxSkew, long _positionLimit)
+{
+	maxSkew = _maxSkew;
+	positionLimit = _positionLimit;
+}
+
+template<typename T>
+void AlgoStreamingService<T>::SetPositionService(PositionService<T>* _positionService)
+{
+	positionService = _positionService;
+}
+
+template<typename T>
+void AlgoStreamingService<T>::SetMarketDataService(MarketDataService<T>* _marketDataService)
+{
+	marketDataService = _marketDataService;
+}
+
+template<typename T>
+void AlgoStreamingService<T>::SetTimerWheel(TimerWheel* _timers)
+{
+	if (timers != nullptr) timers->Cancel(requoteTimerId);
+	timers = _timers;
+	requoteTimerId = -1;
+	if (timers != nullptr && !dirtySlots.empty()) requoteTimerId = timers->Schedule(timers->GetTime() + 1, timerListener, 0);
+}
+
+template<typename T>
+void AlgoStreamingService<T>::SetRequoteBudget(int _requoteBudget)
+{
+	requoteBudget = _requoteBudget;
+}
+
+template<typename T>
+void AlgoStreamingService<T>::OnRequote()
+{
+	for (int i = 0; i < requoteBudget && !dirtySlots.empty(); i++)
+	{
+		int slot = dirtySlots.front();
+		dirtySlots.pop_front();
+		quoteStates[slot].dirty = false;
+		Requote(slot);
+	}
+	requoteTimerId = dirtySlots.empty() ? -1 : timers->Schedule(timers->GetTime() + 1, timerListener, 0);
+}
+
+template<typename T>
+long AlgoStreamingService<T>::GetStreamCount() const
+{
+	return count;
+}
+
+template<typename T>
+long AlgoStreamingService<T>::GetSuppressedCount() const
+{
+	return suppressedCount;
+}
+
+template<typename T>
+int AlgoStreamingService<T>::GetQuoteSlot(const string& productId)
+{
+	unordered_map<string, int>::iterator it = quoteIndices.find(productId);
+	if (it != quoteIndices.end()) return it->second;
+	
+	int slot = quoteStates.size();
+	quoteIndices[productId] = slot;
+	latestPrices.push_back(Price<T>());
+	quoteStates.push_back(QuoteState{ -1, -1, false, false, false, 0, 0, 0, 0, 0 });
+	return slot;
+}
+
+template<typename T>
+void AlgoStreamingService<T>::MarkDirty(int slot)
+{
+	QuoteState& state = quoteStates[slot];
+	if (timers == nullptr) Requote(slot);
+	else if (!state.dirty)
+	{
+		state.dirty = true;
+		dirtySlots.push_back(slot);
+		if (requoteTimerId < 0) requoteTimerId = timers->Schedule(timers->GetTime() + 1, timerListener, 0);
+	}
+}
+
+template<typename T>
+void AlgoStreamingService<T>::Requote(int slot)
+{
+	QuoteState& state = quoteStates[slot];
+	if (!state.hasPrice) return;
+	Price<T>& price = latestPrices[slot];
+	T curr_product = price.GetProduct();
+	string productId = curr_product.GetProductId();
+	
+	// Position across all books, off the snapshot slot cached on its first position (none before it)
+	long inventory = 0;
+	PositionRecord positionRecord;
+	if (positionService != nullptr && state.positionSlot >= 0 && positionService->GetSnapshot(state.positionSlot, positionRecord)) inventory = positionRecord.aggregatePosition;
 	
+	// Lean both prices against the position: a long position lowers them to sell, a short one raises them to buy
+	double ratio = max(-1.0, min(1.0, (double)inventory / positionLimit));
+	double mid = price.GetMid() - ratio * maxSkew;
+	double bidPrice = mid - price.GetBidOfferSpread() / 2.0;
+	double offerPrice = mid + price.GetBidOfferSpread() / 2.0;
+	
+	// Never cross the top of the book
+	OrderBookRecord bookRecord;
+	if (marketDataService != nullptr && state.bookSlot < 0) state.bookSlot = marketDataService->GetSnapshotSlot(productId);
+	if (marketDataService != nullptr && marketDataService->GetSnapshot(state.bookSlot, bookRecord) && bookRecord.bidDepth > 0 && bookRecord.offerDepth > 0)
+	{
+		double bestBid = *max_element(bookRecord.bidPrices, bookRecord.bidPrices + bookRecord.bidDepth);
+		double bestOffer = *min_element(bookRecord.offerPrices, bookRecord.offerPrices + bookRecord.offerDepth);
+		bidPrice = min(bidPrice, bestOffer - 1.0 / MARKET_DATA_TICKS);
+		offerPrice = max(offerPrice, bestBid + 1.0 / MARKET_DATA_TICKS);
+	}
+	long bidTicks = (long)floor(bidPrice * MARKET_DATA_TICKS + 1e-9);
+	long offerTicks = (long)ceil(offerPrice * MARKET_DATA_TICKS - 1e-9);
+	
+	// Move on to the other visible size when the prices move, and keep a full fill of either side, visible and hidden, within the limit
+	if (state.quoted && (bidTicks != state.bidTicks || offerTicks != state.offerTicks)) state.sizeIndex = 1 - state.sizeIndex;
+	long visibleQuantity = visibleQuantities[state.sizeIndex];
+	long bidQuantity = max(0L, min(visibleQuantity, (long)((positionLimit - inventory) / (1.0 + hiddenRatio))));
+	long offerQuantity = max(0L, min(visibleQuantity, (long)((positionLimit + inventory) / (1.0 + hiddenRatio))));
+	if (state.quoted && bidTicks == state.bidTicks && offerTicks == state.offerTicks && bidQuantity == state.bidQuantity && offerQuantity == state.offerQuantity)
+	{
+		suppressedCount++;
+		return;
+	}
+	state.quoted = true;
+	state.bidTicks = bidTicks;
+	state.offerTicks = offerTicks;
+	state.bidQuantity = bidQuantity;
+	state.offerQuantity = offerQuantity;
 	count++;
 	
-    PriceStreamOrder bidOrder(bidPrice, visibleQuantity, hiddenQuantity, BID);
-    PriceStreamOrder offerOrder(offerPrice, visibleQuantity, hiddenQuantity, OFFER);
+    PriceStreamOrder bidOrder((double)bidTicks / MARKET_DATA_TICKS, bidQuantity, (long)(bidQuantity * hiddenRatio), BID);
+    PriceStreamOrder offerOrder((double)offerTicks / MARKET_DATA_TICKS, offerQuantity, (long)(offerQuantity * hiddenRatio), OFFER);
     AlgoStream<T> algoStream(curr_product, bidOrder, offerOrder);
     algoStreams[productId] = algoStream;
     
-    for (vector<ServiceListener<AlgoStream<T>>*>::iterator it = listeners.begin(); it != listeners.end(); it++)
-        (*it)->ProcessAdd(_algoStream);
+    for (typename vector<ServiceListener<AlgoStream<T>>*>::iterator it = listeners.begin(); it != listeners.end(); it++)
+        (*it)->ProcessAdd(algoStream);
 }
 
 
@@ -185,6 +399,56 @@ void AlgoStreamingToPricingListener<T>::ProcessAdd(Price<T>& _data)
 	service->PublishPrice(_data); 
 }
 
+template<typename T>
+void AlgoStreamingToPricingListener<T>::ProcessRemove(Price<T>& _data)
+{
+}
+
+template<typename T>
+void AlgoStreamingToPricingListener<T>::ProcessUpdate(Price<T>& _data)
+{
+}
+
+
+
+
+template<typename T>
+AlgoStreamingToPositionListener<T>::AlgoStreamingToPositionListener(AlgoStreamingService<T>* _service)
+{ 
+	service = _service; 
+}
+
+template<typename T>
+void AlgoStreamingToPositionListener<T>::ProcessAdd(Position<T>& _data) 
+{ 
+	service->OnPosition(_data); 
+}
+
+template<typename T>
+void AlgoStreamingToPositionListener<T>::ProcessRemove(Position<T>& _data)
+{
+}
+
+template<typename T>
+void AlgoStreamingToPositionListener<T>::ProcessUpdate(Position<T>& _data)
+{
+}
+
+
+
+
+template<typename T>
+AlgoStreamingToTimerListener<T>::AlgoStreamingToTimerListener(AlgoStreamingService<T>* _service)
+{ 
+	service = _service; 
+}
+
+template<typename T>
+void AlgoStreamingToTimerListener<T>::ProcessTimeout(long data) 
+{ 
+	service->OnRequote(); 
+}
+
 
 
 
@@ -194,6 +458,7 @@ StreamingService<T>::StreamingService()
     priceStreams = map<string, PriceStream<T> >();
     listeners = vector<ServiceListener<PriceStream<T> >*>();
     listener = new StreamingToAlgoStreamingListener<T>(this);
+	suppressedCount = 0;
 }
 
 template<typename T>
@@ -231,8 +496,74 @@ ServiceListener<AlgoStream<T>>* StreamingService<T>::GetListener()
 template<typename T>
 void StreamingService<T>::PublishPrice(PriceStream<T>& priceStream)
 {
-    for (vector<ServiceListener<PriceStream<T>>*>::iterator it = listeners.begin(); it != listeners.end(); it++)
-        (*it)->ProcessAdd(priceStream);
+	string productId = priceStream.GetProduct().GetProductId();
+	int index;
+	unordered_map<string, int>::iterator index_it = streamIndices.find(productId);
+	if (index_it != streamIndices.end()) index = index_it->second;
+	else
+	{
+		index = lastStreams.size();
+		streamIndices[productId] = index;
+		lastStreams.push_back(PackedPriceStream{ 0, 0, 0 });
+		packedFlags.push_back(false);
+	}
+	
+	// Compare packed: three words tell an unchanged stream, and the halves that differ are the fields that changed
+	PackedPriceStream packed;
+	bool isPacked = PackPriceStream(priceStream, packed);
+	int changedFields = PRICE_STREAM_ALL_FIELDS;
+	if (isPacked && packedFlags[index])
+	{
+		const PackedPriceStream& last = lastStreams[index];
+		uint64_t prices = packed.prices ^ last.prices;
+		uint64_t bidQuantities = packed.bidQuantities ^ last.bidQuantities;
+		uint64_t offerQuantities = packed.offerQuantities ^ last.offerQuantities;
+		if ((prices | bidQuantities | offerQuantities) == 0)
+		{
+			suppressedCount++;
+			return;
+		}
+		changedFields = ((prices >> 32) ? PRICE_STREAM_BID_PRICE : 0) | ((uint32_t)prices ? PRICE_STREAM_OFFER_PRICE : 0)
+			| ((bidQuantities >> 32) ? PRICE_STREAM_BID_VISIBLE : 0) | ((uint32_t)bidQuantities ? PRICE_STREAM_BID_HIDDEN : 0)
+			| ((offerQuantities >> 32) ? PRICE_STREAM_OFFER_VISIBLE : 0) | ((uint32_t)offerQuantities ? PRICE_STREAM_OFFER_HIDDEN : 0);
+	}
+	lastStreams[index] = packed;
+	packedFlags[index] = isPacked;
+	
+	for (typename vector<ServiceListener<PriceStream<T>>*>::iterator it = listeners.begin(); it != listeners.end(); it++)
+		(*it)->ProcessAdd(priceStream);
+	if (deltaListeners.empty()) return;
+	PriceStreamDelta<T> delta(priceStream, changedFields);
+	for (typename vector<ServiceListener<PriceStreamDelta<T>>*>::iterator it = deltaListeners.begin(); it != deltaListeners.end(); it++)
+		(*it)->ProcessAdd(delta);
+}
+
+template<typename T>
+void StreamingService<T>::AddDeltaListener(ServiceListener<PriceStreamDelta<T>>* listener)
+{
+	deltaListeners.push_back(listener);
+}
+
+template<typename T>
+long StreamingService<T>::GetSuppressedCount() const
+{
+	return suppressedCount;
+}
+
+template<typename T>
+bool StreamingService<T>::PackPriceStream(const PriceStream<T>& priceStream, PackedPriceStream& packed) const
+{
+	const PriceStreamOrder& bidOrder = priceStream.GetBidOrder();
+	const PriceStreamOrder& offerOrder = priceStream.GetOfferOrder();
+	long fields[6] = { llround(bidOrder.GetPrice() * MARKET_DATA_TICKS), llround(offerOrder.GetPrice() * MARKET_DATA_TICKS),
+		bidOrder.GetVisibleQuantity(), bidOrder.GetHiddenQuantity(), offerOrder.GetVisibleQuantity(), offerOrder.GetHiddenQuantity() };
+	for (int i = 0; i < 6; i++)
+		if (fields[i] < 0 || fields[i] > (long)UINT32_MAX) return false;
+	
+	packed.prices = ((uint64_t)fields[0] << 32) | (uint64_t)fields[1];
+	packed.bidQuantities = ((uint64_t)fields[2] << 32) | (uint64_t)fields[3];
+	packed.offerQuantities = ((uint64_t)fields[4] << 32) | (uint64_t)fields[5];
+	return true;
 }
 
 
@@ -253,5 +584,15 @@ void StreamingToAlgoStreamingListener<T>::ProcessAdd(AlgoStream<T>& _data)
     service->PublishPrice(*priceStream);
 }
 
+template<typename T>
+void StreamingToAlgoStreamingListener<T>::ProcessRemove(AlgoStream<T>& _data)
+{
+}
+
+template<typename T>
+void StreamingToAlgoStreamingListener<T>::ProcessUpdate(AlgoStream<T>& _data)
+{
+}
+
 
 
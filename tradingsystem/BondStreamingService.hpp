@@ -10,6 +10,8 @@
 #include "my functions.hpp"
 #include "BondPricingService.hpp"
 #include "BondMarketDataService.hpp"
+#include "BondPositionService.hpp"
+#include "TimerWheel.hpp"
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -19,6 +21,8 @@
 #include <chrono>
 #include <map>
 #include <unordered_map>
+#include <deque>
+#include <cstdint>
 using namespace std;
 
 
@@ -48,9 +52,6 @@ public:
     // Get the hidden quantity on this order
     long GetHiddenQuantity() const;
 	
-	// Get the bid / offer side
-    PricingSide GetSide() const;
-	
 	// Convert price stream order data -> vector<string> format
 	vector<string> GetPriceStreamOrder_pso2s() const;
 	
@@ -100,6 +101,68 @@ private:
 
 
 
+const int PRICE_STREAM_BID_PRICE = 1 << 0;				// fields of a price stream, as flags of a delta record
+const int PRICE_STREAM_BID_VISIBLE = 1 << 1;
+const int PRICE_STREAM_BID_HIDDEN = 1 << 2;
+const int PRICE_STREAM_OFFER_PRICE = 1 << 3;
+const int PRICE_STREAM_OFFER_VISIBLE = 1 << 4;
+const int PRICE_STREAM_OFFER_HIDDEN = 1 << 5;
+const int PRICE_STREAM_ALL_FIELDS = (1 << 6) - 1;
+
+
+
+
+/**
+ * Delta record of a price stream, with the fields that changed since the last stream of the product.
+ * The first stream of a product has all its fields changed.
+ * Type T is the product type.
+ */
+template<typename T>
+class PriceStreamDelta
+{
+
+public:
+	// default ctor
+	PriceStreamDelta() = default;
+	
+	// ctor
+	PriceStreamDelta(const PriceStream<T>& _priceStream, int _changedFields);
+	
+	// Get the product
+	const T& GetProduct() const;
+	
+	// Get the fields that changed, as PRICE_STREAM_* flags
+	int GetChangedFields() const;
+	
+	// Get the whole price stream
+	const PriceStream<T>& GetPriceStream() const;
+	
+	// Convert price stream delta data -> vector<string> format, with only the fields that changed
+	vector<string> GetPriceStream_ps2s() const;
+	
+private:
+	PriceStream<T> priceStream;
+	int changedFields;
+};
+
+
+
+
+/**
+ * Quote of a price stream packed into three words, so that an unchanged quote is found in three compares.
+ * Prices are in ticks of 1/MARKET_DATA_TICKS, the bid in the high half of prices and the offer in the low half;
+ * the quantities of a side hold the visible quantity in the high half and the hidden quantity in the low half.
+ */
+struct PackedPriceStream
+{
+	uint64_t prices;
+	uint64_t bidQuantities;
+	uint64_t offerQuantities;
+};
+
+
+
+
 /* AlgoStream */
 template<typename T>
 class AlgoStream
@@ -121,15 +184,53 @@ private:
 
 
 
+/**
+ * Quoting state of a product in AlgoStreamingService, with the last quote published in ticks.
+ */
+struct QuoteState
+{
+	int positionSlot;					// snapshot slot of the product in PositionService (-1 until it has a position)
+	int bookSlot;						// snapshot slot of the product in MarketDataService (-1 until it has a book)
+	bool hasPrice;						// whether a price has come in
+	bool dirty;							// whether the product waits in the requote queue
+	bool quoted;						// whether a quote has been published
+	int sizeIndex;						// index of the visible size the quotes are on
+	long bidTicks;						// last bid published
+	long offerTicks;					// last offer published
+	long bidQuantity;					// last visible bid size published
+	long offerQuantity;					// last visible offer size published
+};
+
+
+
+
 /* Listener of AlgoStreamingService to PricingService */
 template<typename T>
 class AlgoStreamingToPricingListener;
 
+/* Listener of AlgoStreamingService to PositionService */
+template<typename T>
+class AlgoStreamingToPositionListener;
+
+/* Listener of AlgoStreamingService on its requote timer */
+template<typename T>
+class AlgoStreamingToTimerListener;
 
 
 
-/* AloStreamingService */
 
+/**
+ * Algo Streaming Service quoting two-way prices around the mid of PricingService, skewed by inventory.
+ * A long position shifts both prices down and a short one up, in proportion to the position over the
+ * position limit, and the size on the side that adds to the position shrinks so that a full fill of the visible
+ * and hidden sizes together stays within the limit. Quotes never cross the top of the book of MarketDataService. The position and the top of book are
+ * read from the snapshots of the services, through slots cached per product.
+ * A new price or position marks its product for a requote. With a timer wheel, the requote queue is worked
+ * through at most requoteBudget products per tick, oldest first, with the timer armed only while the queue is not empty, so every product is requoted within a bounded
+ * # of ticks; without one, products are requoted at once. A quote identical to the last one published is dropped.
+ * Keyed on product identifier.
+ * Type T is the product type.
+ */
 template<typename T>
 class AlgoStreamingService : public Service<string, AlgoStream<T> >
 {
@@ -152,16 +253,75 @@ public:
 	// Get the listener to PricingService
 	AlgoStreamingToPricingListener<T>* GetListener();
 	
-	// Send bid/offer prices
-	// Alternate visible sizes between 1000000 and 2000000 on subsequent updates for both sizes
+	// Get the listener to PositionService
+	AlgoStreamingToPositionListener<T>* GetPositionListener();
+	
+	// Take a new price of a product, and requote the product
+	// Alternate visible sizes between 1000000 and 2000000 on subsequent price changes for both sizes
     // Hidden size should be twice the visible size at all times
 	void PublishPrice(Price<T>& price);
 	
+	// Take a new position of a product, caching its snapshot slot, and requote the product
+	void OnPosition(Position<T>& position);
+	
+	// Set the two visible sizes the quotes alternate between, and the hidden size as a multiple of the visible size
+	void SetQuoteSizes(long firstVisibleQuantity, long secondVisibleQuantity, double _hiddenRatio);
+	
+	// Set the price shift of a position at the limit, and the position limit
+	void SetInventorySkew(double _maxSkew, long _positionLimit);
+	
+	// Set the service the positions are read from
+	void SetPositionService(PositionService<T>* _positionService);
+	
+	// Set the service the top of the books is read from
+	void SetMarketDataService(MarketDataService<T>* _marketDataService);
+	
+	// Set the timer wheel the requote timer is scheduled on, driven by the owner's clock in ms
+	void SetTimerWheel(TimerWheel* _timers);
+	
+	// Set the # of products requoted per tick
+	void SetRequoteBudget(int _requoteBudget);
+	
+	// Requote the oldest products of the requote queue, up to the budget, and schedule the next tick if some are left
+	void OnRequote();
+	
+	// Get the # of quotes published
+	long GetStreamCount() const;
+	
+	// Get the # of quotes dropped as identical to the last one published
+	long GetSuppressedCount() const;
+	
 private:
+	// Get the quoting slot of a product, adding it on first sight
+	int GetQuoteSlot(const string& productId);
+	
+	// Requote a product at once, or queue it for the next tick
+	void MarkDirty(int slot);
+	
+	// Work out the quote of a product, and publish it unless it is the last one published
+	void Requote(int slot);
+	
+
     map<string, AlgoStream<T>> algoStreams;					// a map of {}
     vector<ServiceListener<AlgoStream<T>>*> listeners;		// all listeners on AlgoStreamingService
     AlgoStreamingToPricingListener<T>* listener;			// a pointer to a listener to PricingService
     long count;												// stream count
+	long visibleQuantities[2];								// visible sizes the quotes alternate between
+	double hiddenRatio;										// hidden size over visible size
+	double maxSkew;											// price shift of a position at the limit
+	long positionLimit;										// position limit, either way
+	AlgoStreamingToPositionListener<T>* positionListener;	// a pointer to a listener to PositionService
+	PositionService<T>* positionService;					// a pointer to the service positions are read from (nullptr for flat)
+	MarketDataService<T>* marketDataService;				// a pointer to the service the top of the books is read from
+	TimerWheel* timers;										// a pointer to the timer wheel of the requote timer
+	AlgoStreamingToTimerListener<T>* timerListener;			// a pointer to the listener on the requote timer
+	long requoteTimerId;									// identifier of the pending requote timer (-1 if none)
+	int requoteBudget;										// # of products requoted per tick
+	unordered_map<string, int> quoteIndices;				// a map of {product identifier -> quoting slot}
+	vector<Price<T>> latestPrices;							// latest price of each slot
+	vector<QuoteState> quoteStates;							// quoting state of each slot
+	deque<int> dirtySlots;									// requote queue, oldest first
+	long suppressedCount;									// # of quotes dropped as unchanged
 };
 
 
@@ -191,6 +351,48 @@ private:
 
 
 
+/* Listener of AlgoStreamingService to PositionService */
+template<typename T>
+class AlgoStreamingToPositionListener : public ServiceListener<Position<T>>
+{
+public:
+    // ctor
+	AlgoStreamingToPositionListener(AlgoStreamingService<T>* _service);
+	
+    // Listener callback to process an add event to AlgoStreamingService
+	void ProcessAdd(Position<T>& _data);
+	
+    // Listener callback to process a remove event to AlgoStreamingService
+    void ProcessRemove(Position<T>& _data);
+	
+    // Listener callback to process an update event to AlgoStreamingService
+    void ProcessUpdate(Position<T>& _data);
+	
+private:
+    AlgoStreamingService<T>* service;				// a pointer to AlgoStreamingService
+};
+
+
+
+
+/* Listener of AlgoStreamingService on its requote timer */
+template<typename T>
+class AlgoStreamingToTimerListener : public TimerListener
+{
+public:
+	// ctor
+	AlgoStreamingToTimerListener(AlgoStreamingService<T>* _service);
+	
+	// Timer callback at each requote tick
+	void ProcessTimeout(long data);
+	
+private:
+    AlgoStreamingService<T>* service;				// a pointer to AlgoStreamingService
+};
+
+
+
+
 /* Listener of StreamingService to AlgoStreamingService */
 template<typename T>
 class StreamingToAlgoStreamingListener;
@@ -200,6 +402,9 @@ class StreamingToAlgoStreamingListener;
 
 /**
  * Streaming service to publish two-way prices.
+ * The last stream published of each product is kept packed (see PackedPriceStream), and a stream identical to it
+ * is dropped, so quiet books cost nothing downstream. Listeners get every stream that changed in full, and
+ * delta listeners (such as the history) a delta record of the fields that changed.
  * Keyed on product identifier.
  * Type T is the product type.
  */
@@ -226,13 +431,27 @@ public:
 	// Get the listener to AlgoStreamingService
 	ServiceListener<AlgoStream<T>>* GetListener(); 
 	
-    // Publish two-way prices
-    void PublishPrice(const PriceStream<T>& priceStream);
+    // Publish two-way prices, unless they are the last ones published for the product
+    void PublishPrice(PriceStream<T>& priceStream);
+	
+	// Add a listener to the delta records of the streams published
+	void AddDeltaListener(ServiceListener<PriceStreamDelta<T>>* listener);
+	
+	// Get the # of streams dropped as identical to the last one published
+	long GetSuppressedCount() const;
 
 private:
+	// Pack the quote of a stream (false if a price or quantity does not fit its half word)
+	bool PackPriceStream(const PriceStream<T>& priceStream, PackedPriceStream& packed) const;
+	
     map<string, PriceStream<T> > priceStreams;				// a map of {product identifier -> price stream}
     vector<ServiceListener<PriceStream<T>>*> listeners;		// all listeners on StreamingService
     StreamingToAlgoStreamingListener<T>* listener;			// a pointer to a listener to 
+	vector<ServiceListener<PriceStreamDelta<T>>*> deltaListeners;	// all delta listeners on StreamingService
+	unordered_map<string, int> streamIndices;				// a map of {product identifier -> index in lastStreams}
+	vector<PackedPriceStream> lastStreams;					// last stream published of each product, packed
+	vector<char> packedFlags;								// whether the last stream of each product could be packed
+	long suppressedCount;									// # of streams dropped as unchanged
 };
 
 
@@ -14,16 +14,12 @@
 #include <string>
 #include <map>
 #include <unordered_map>
+#include <type_traits>
 using namespace std;
 
 
 
 
-template<typename T>
-Trade::Trade()
-{
-}
-
 template<typename T>
 Trade<T>::Trade(const T &_product, string _tradeId, double _price, string _book, long _quantity, Side _side) :
     product(_product)
@@ -92,9 +88,8 @@ Trade<T>& TradeBookingService<T>::GetData(string key)
 template<typename T>
 void TradeBookingService<T>::OnMessage(Trade<T>& data)
 {
-	string _tradeId = trades[data.GetTradeId()];
-	for (vector<ServiceListener<Trade<T>>*>::iterator it = listeners.begin(); it != listeners.end(); it++)
-		(*it)->ProcessAdd(_tradeId);
+	trades[data.GetTradeId()] = data;
+	BookTrade(data);
 }
 
 template<typename T>
@@ -124,8 +119,9 @@ TradeBookingToExecutionListener<T>* TradeBookingService<T>::GetListener()
 template<typename T>
 void TradeBookingService<T>::BookTrade(const Trade<T>& trade)
 {
-	for (vector<ServiceListener<Trade<T>>*>::iterator it = listeners.begin(); it != listeners.end(); it++)
-		(*it)->ProcessAdd(trade);
+	Trade<T> bookedTrade = trade;
+	for (typename vector<ServiceListener<Trade<T>>*>::iterator it = listeners.begin(); it != listeners.end(); it++)
+		(*it)->ProcessAdd(bookedTrade);
 }
 
 
@@ -137,30 +133,45 @@ TradeBookingConnector<T>::TradeBookingConnector(TradeBookingService<T>* _service
 	service = _service;
 }
 
+template<typename T>
+void TradeBookingConnector<T>::Publish(Trade<T>& data)
+{
+}
+
 template<typename T>
 void TradeBookingConnector<T>::Subscribe(fstream& data_stream)
 {
 	// Read trade data from an input stream
 	vector<vector<string>> trade_data = ReadDataStream(data_stream);
 	for (vector<vector<string>>::iterator it = trade_data.begin(); it != trade_data.end(); it++)
+		SubscribeLine(*it);
+}
+
+template<typename T>
+void TradeBookingConnector<T>::SubscribeLine(const vector<string>& words)
+{
+	SubscribeLine(words, words.size());
+}
+
+template<typename T>
+void TradeBookingConnector<T>::SubscribeLine(const vector<string>& words, int wordCount)
+{
+	string productId = words[0];
+	string tradeId = words[1];
+	long ticks = ParseTickPrice(words[2]);
+	if (ticks < 0) return;		// an unreadable price is a parse error
+	double price = (double)ticks / MARKET_DATA_TICKS;
+	string book = words[3];
+	long quantity = stol(words[4]);
+	Side side = (words[5] == "BUY") ? BUY : SELL;
+	
+	// Bond
+	if constexpr (is_same<T, Bond>::value)
 	{
-		string productId = (*it)[0];
-		string tradeId = (*it)[1];
-		double price = GetPrice_d2s((*it)[2]);
-		string book = (*it)[3];
-		long quantity = stol((*it)[4]);
-		string tradeId = (*it)[1];
-		Side side = ((*it)[5] == "BUY") ? BUY : SELL;
-		
-		// Bond
-		if (T == BOND)
-		{
-			T curr_product = GetBond(productId);
-			Trade<T> curr_trade(curr_product, tradeId, price, book, quantity, side);
-			service->OnMessage(curr_trade);
-		}
+		T curr_product = GetBond(productId);
+		Trade<T> curr_trade(curr_product, tradeId, price, book, quantity, side);
+		service->OnMessage(curr_trade);
 	}
-	
 }
 
 
@@ -178,12 +189,12 @@ void TradeBookingToExecutionListener<T>::ProcessAdd(ExecutionOrder<T>& _data)
 {
 	count++;
 	
-	T curr_product = data.GetProduct();
-	PricingSide pricingSide = data.GetPricingSide();
-	string orderId = data.GetOrderId();
-	double price = data.GetPrice();
-	long visibleQuantity = data.GetVisibleQuantity();
-	long hiddenQuantity = data.GetHiddenQuantity();
+	T curr_product = _data.GetProduct();
+	PricingSide pricingSide = _data.GetSide();
+	string orderId = _data.GetOrderId();
+	double price = _data.GetPrice();
+	long visibleQuantity = _data.GetVisibleQuantity();
+	long hiddenQuantity = _data.GetHiddenQuantity();
 	long quantity = visibleQuantity + hiddenQuantity;
 	
 	string book;
@@ -196,7 +207,16 @@ void TradeBookingToExecutionListener<T>::ProcessAdd(ExecutionOrder<T>& _data)
 	if (pricingSide == OFFER) side = BUY;
 			
 	Trade<T> curr_trade(curr_product, orderId, price, book, quantity, side);
-	service->BookTrade(curr_trade);
 	service->OnMessage(curr_trade);
 }
 
+template<typename T>
+void TradeBookingToExecutionListener<T>::ProcessRemove(ExecutionOrder<T>& _data)
+{
+}
+
+template<typename T>
+void TradeBookingToExecutionListener<T>::ProcessUpdate(ExecutionOrder<T>& _data)
+{
+}
+
@@ -138,6 +138,12 @@ public:
     // Subscribe data from the Connector
     void Subscribe(fstream& data_stream);
 
+    // Subscribe one line of data from the Connector, split into words
+    void SubscribeLine(const vector<string>& words);
+
+	// Subscribe the first # of words of a word buffer reused across lines
+	void SubscribeLine(const vector<string>& words, int wordCount);
+
 private:
     TradeBookingService<T>* service;
 };
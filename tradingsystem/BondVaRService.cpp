@@ -0,0 +1,265 @@
+/**
+ * BondVaRService.cpp
+ * Defines the data types and Service for historical simulation VaR.
+ *
+ * @author Jordan Wang
+ */
+
+#include "BondVaRService.hpp"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+using namespace std;
+
+
+
+
+// y += a * x over n doubles
+static inline void AddScaledColumn(double* y, const double* x, double a, int n)
+{
+	int i = 0;
+#if defined(__AVX512F__)
+	__m512d a8 = _mm512_set1_pd(a);
+	for (; i + 8 <= n; i += 8)
+		_mm512_storeu_pd(y + i, _mm512_fmadd_pd(a8, _mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i)));
+#elif defined(__AVX2__)
+	__m256d a4 = _mm256_set1_pd(a);
+	for (; i + 4 <= n; i += 4)
+		_mm256_storeu_pd(y + i, _mm256_add_pd(_mm256_loadu_pd(y + i), _mm256_mul_pd(a4, _mm256_loadu_pd(x + i))));
+#endif
+	for (; i < n; i++)
+		y[i] += a * x[i];
+}
+
+
+
+
+ValueAtRisk::ValueAtRisk(string _name, double _confidence, int _observations, double _var, double _expectedShortfall)
+{
+	name = _name;
+	confidence = _confidence;
+	observations = _observations;
+	var = _var;
+	expectedShortfall = _expectedShortfall;
+}
+
+const string& ValueAtRisk::GetName() const
+{
+	return name;
+}
+
+double ValueAtRisk::GetConfidence() const
+{
+	return confidence;
+}
+
+int ValueAtRisk::GetObservations() const
+{
+	return observations;
+}
+
+double ValueAtRisk::GetVaR() const
+{
+	return var;
+}
+
+double ValueAtRisk::GetExpectedShortfall() const
+{
+	return expectedShortfall;
+}
+
+const ValueAtRisk& ValueAtRisk::GetProduct() const
+{
+	return *this;
+}
+
+const string& ValueAtRisk::GetProductId() const
+{
+	return name;
+}
+
+vector<string> ValueAtRisk::GetValueAtRisk_v2s() const
+{
+	vector<string> res;
+	res.push_back(name);							// Append portfolio name
+	res.push_back(to_string(confidence));			// Append confidence level
+	res.push_back(to_string(observations));			// Append # of days
+	res.push_back(to_string(var));					// Append VaR
+	res.push_back(to_string(expectedShortfall));	// Append expected shortfall
+	return res;
+}
+
+
+
+
+template<typename T>
+VaRService<T>::VaRService(string _name, int _window, double _confidence)
+{
+	vars = map<string, ValueAtRisk>();
+	listeners = vector<ServiceListener<ValueAtRisk>*>();
+	listener = new VaRToRiskListener<T>(this);
+	name = _name;
+	window = _window;
+	confidence = _confidence;
+	
+	vector<Bond> bonds = GetBonds();
+	int productCount = bonds.size();
+	for (int i = 0; i < productCount; i++)
+		productIndices[bonds[i].GetProductId()] = i;
+	exposures = vector<double>(productCount, 0.0);
+	yieldChanges = vector<double>(productCount * window, 0.0);
+	pnl = vector<double>(window, 0.0);
+	sortedPnL = vector<double>(window, 0.0);
+	observations = 0;
+	nextDay = 0;
+}
+
+template<typename T>
+ValueAtRisk& VaRService<T>::GetData(string key)
+{
+	return vars[key];
+}
+
+template<typename T>
+void VaRService<T>::OnMessage(ValueAtRisk& data)
+{
+	vars[data.GetName()] = data;
+}
+
+template<typename T>
+void VaRService<T>::AddListener(ServiceListener<ValueAtRisk>* listener)
+{
+	listeners.push_back(listener);
+}
+
+template<typename T>
+const vector<ServiceListener<ValueAtRisk>*>& VaRService<T>::GetListeners() const
+{
+	return listeners;
+}
+
+template<typename T>
+VaRToRiskListener<T>* VaRService<T>::GetListener()
+{
+	return listener;
+}
+
+template<typename T>
+const vector<double>& VaRService<T>::GetPnL() const
+{
+	return pnl;
+}
+
+template<typename T>
+void VaRService<T>::AddYieldChanges(const vector<double>& _yieldChanges)
+{
+	// Overwrite the oldest day of the window
+	int day = nextDay;
+	double dayPnL = 0.0;
+	bool isHeld = false;
+	int productCount = exposures.size();
+	for (int i = 0; i < productCount && i < (int)_yieldChanges.size(); i++)
+	{
+		yieldChanges[i * window + day] = _yieldChanges[i];
+		dayPnL += exposures[i] * _yieldChanges[i];
+		isHeld = isHeld || exposures[i] != 0.0;
+	}
+	pnl[day] = dayPnL;
+	
+	// Once a pass over the window, rebuild the P&L so that the rounding of the incremental updates does not build up
+	nextDay = (nextDay + 1) % window;
+	observations = min(observations + 1, window);
+	if (nextDay == 0) RecomputePnL();
+	if (isHeld) PublishVaR();
+}
+
+template<typename T>
+void VaRService<T>::UpdateRisk(PV01<T>& pv01)
+{
+	UpdateExposure(pv01);
+	PublishVaR();
+}
+
+template<typename T>
+void VaRService<T>::UpdateExposure(PV01<T>& pv01)
+{
+	unordered_map<string, int>::iterator it = productIndices.find(pv01.GetProduct().GetProductId());
+	if (it == productIndices.end()) return;
+	
+	// P&L of a 1bp rise in yield on the position (PV01 is the price change of 1bp per 10,000 face)
+	int index = it->second;
+	double exposure = -pv01.GetPV01() * pv01.GetQuantity() * 0.0001;
+	double exposureDelta = exposure - exposures[index];
+	exposures[index] = exposure;
+	
+	// Only this product's contribution to the P&L vector changes
+	if (exposureDelta != 0.0)
+		AddScaledColumn(pnl.data(), &yieldChanges[index * window], exposureDelta, window);
+}
+
+template<typename T>
+void VaRService<T>::RecomputePnL()
+{
+	fill(pnl.begin(), pnl.end(), 0.0);
+	int productCount = exposures.size();
+	for (int i = 0; i < productCount; i++)
+		AddScaledColumn(pnl.data(), &yieldChanges[i * window], exposures[i], window);
+}
+
+template<typename T>
+void VaRService<T>::PublishVaR()
+{
+	if (observations == 0) return;
+	
+	// The days filled so far are the first rows of the window
+	copy(pnl.begin(), pnl.begin() + observations, sortedPnL.begin());
+	int tailCount = max(1, (int)((1.0 - confidence) * observations));
+	nth_element(sortedPnL.begin(), sortedPnL.begin() + tailCount - 1, sortedPnL.begin() + observations);
+	
+	double var = -sortedPnL[tailCount - 1];
+	double tailSum = 0.0;
+	for (int i = 0; i < tailCount; i++)
+		tailSum += sortedPnL[i];
+	double expectedShortfall = -tailSum / tailCount;
+	
+	ValueAtRisk valueAtRisk(name, confidence, observations, var, expectedShortfall);
+	vars[name] = valueAtRisk;
+	for (vector<ServiceListener<ValueAtRisk>*>::iterator it = listeners.begin(); it != listeners.end(); it++)
+		(*it)->ProcessAdd(valueAtRisk);
+}
+
+
+
+
+template<typename T>
+VaRToRiskListener<T>::VaRToRiskListener(VaRService<T>* _service)
+{
+	service = _service;
+}
+
+template<typename T>
+void VaRToRiskListener<T>::ProcessAdd(PV01<T>& _data)
+{
+	service->UpdateRisk(_data);
+}
+
+template<typename T>
+void VaRToRiskListener<T>::ProcessRemove(PV01<T>& _data)
+{
+}
+
+template<typename T>
+void VaRToRiskListener<T>::ProcessUpdate(PV01<T>& _data)
+{
+	service->UpdateExposure(_data);
+}
@@ -0,0 +1,174 @@
+/**
+ * BondVaRService.hpp
+ * Defines the data types and Service for historical simulation VaR.
+ *
+ * @author Jordan Wang
+ */
+#ifndef BondVaRService_hpp
+#define BondVaRService_hpp
+#include "soa.hpp"
+#include "my functions.hpp"
+#include "BondRiskService.hpp"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <map>
+#include <unordered_map>
+using namespace std;
+
+
+
+
+/**
+ * Value at risk and expected shortfall of a portfolio.
+ */
+class ValueAtRisk
+{
+
+public:
+	// default ctor
+	ValueAtRisk() = default;
+
+	// ctor for a VaR value
+	ValueAtRisk(string _name, double _confidence, int _observations, double _var, double _expectedShortfall);
+
+	// Get the name of the portfolio
+	const string& GetName() const;
+
+	// Get the confidence level
+	double GetConfidence() const;
+
+	// Get the # of historical days the VaR is computed on
+	int GetObservations() const;
+
+	// Get the VaR (as a positive loss)
+	double GetVaR() const;
+
+	// Get the expected shortfall beyond the VaR (as a positive loss)
+	double GetExpectedShortfall() const;
+
+	// Get the VaR itself, so that VaR figures are persisted like products
+	const ValueAtRisk& GetProduct() const;
+
+	// Get the portfolio name as the identifier of the VaR
+	const string& GetProductId() const;
+
+	// Convert VaR data -> vector<string> format
+	vector<string> GetValueAtRisk_v2s() const;
+
+private:
+	string name;
+	double confidence;
+	int observations;
+	double var;
+	double expectedShortfall;
+};
+
+
+
+
+/* Listener of VaRService to BondRiskService */
+template<typename T>
+class VaRToRiskListener;
+
+
+
+
+/**
+ * VaR Service computing historical simulation VaR and expected shortfall on the current risk.
+ * Daily yield changes (in bp) of the last window days are held in a column-major matrix with
+ * one contiguous column per product, rolled as a ring buffer. The portfolio P&L of each day is kept
+ * as a vector equal to the matrix times the dollar PV01 of each product, so a change in one product
+ * only adds its PV01 change times its column (a SIMD axpy) instead of recomputing the product.
+ * Keyed on portfolio name.
+ * Type T is the product type.
+ */
+template<typename T>
+class VaRService : public Service<string, ValueAtRisk>
+{
+public:
+	// ctor for a VaR over a window of days at a confidence level
+	VaRService(string _name, int _window, double _confidence);
+
+    // Get data on our service given a key
+    ValueAtRisk& GetData(string key);
+
+    // The callback that a Connector should invoke for any new or updated data
+    void OnMessage(ValueAtRisk& data);
+
+    // Add a listener to VaRService for callbacks on add, remove, and update events for data to VaRService
+    void AddListener(ServiceListener<ValueAtRisk>* listener);
+
+    // Get all listeners on VaRService
+    const vector<ServiceListener<ValueAtRisk>*>& GetListeners() const;
+
+	// Get the listener to BondRiskService
+	VaRToRiskListener<T>* GetListener();
+
+	// Roll in the yield changes (in bp) of a new day, one per bond in GetBonds order, and publish the new VaR
+	// if any risk is held
+	void AddYieldChanges(const vector<double>& yieldChanges);
+
+	// Update the risk held in a product and publish the new VaR
+	void UpdateRisk(PV01<T>& pv01);
+
+	// Update the risk held in a product on a market move, to be in the next VaR published
+	void UpdateExposure(PV01<T>& pv01);
+
+	// Recompute the P&L vector from scratch as one matrix-vector product
+	void RecomputePnL();
+
+	// Get the P&L of each historical day held in the window
+	const vector<double>& GetPnL() const;
+
+private:
+	// Compute the VaR and expected shortfall off the P&L vector and publish them
+	void PublishVaR();
+
+    map<string, ValueAtRisk> vars;						// a map of {portfolio name -> VaR}
+    vector<ServiceListener<ValueAtRisk>*> listeners;	// all listeners on VaRService
+    VaRToRiskListener<T>* listener;						// a pointer to a listener to BondRiskService
+	string name;										// portfolio name
+	int window;											// # of days in the window
+	double confidence;									// confidence level
+	unordered_map<string, int> productIndices;			// a map of {product identifier -> column}
+	vector<double> exposures;							// P&L per bp yield change of each product
+	vector<double> yieldChanges;						// column-major [product * window + day] yield changes
+	vector<double> pnl;									// portfolio P&L of each day in the window
+	vector<double> sortedPnL;							// scratch space for the quantile
+	int observations;									// # of days filled in the window
+	int nextDay;										// row the next day is rolled into
+};
+
+
+
+
+/* Listener of VaRService to BondRiskService */
+template<typename T>
+class VaRToRiskListener : public ServiceListener<PV01<T>>
+{
+public:
+	// ctor
+    VaRToRiskListener(VaRService<T>* _service);
+
+    // Listener callback to process an add event to VaRService
+    void ProcessAdd(PV01<T>& _data);
+
+    // Listener callback to process a remove event to VaRService
+    void ProcessRemove(PV01<T>& _data);
+
+    // Listener callback to process an update event to VaRService
+    void ProcessUpdate(PV01<T>& _data);
+
+private:
+    VaRService<T>* service;					// a pointer to VaRService
+};
+
+
+
+
+#endif
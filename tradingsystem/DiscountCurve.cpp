@@ -0,0 +1,79 @@
+/**
+ * DiscountCurve.cpp
+ * Defines a zero coupon discount curve.
+ *
+ * @author Jordan Wang
+ */
+ 
+#include "DiscountCurve.hpp"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+using namespace std;
+
+
+
+
+DiscountCurve::DiscountCurve(const vector<double> &_tenors, const vector<double> &_zeroRates) :
+	tenors(_tenors), zeroRates(_zeroRates)
+{
+}
+
+const vector<double>& DiscountCurve::GetTenors() const
+{
+	return tenors;
+}
+
+const vector<double>& DiscountCurve::GetZeroRates() const
+{
+	return zeroRates;
+}
+
+void DiscountCurve::SetZeroRate(int index, double zeroRate)
+{
+	zeroRates[index] = zeroRate;
+}
+
+void DiscountCurve::GetInterpolation(double time, int &lowerIndex, int &upperIndex, double &weight) const
+{
+	int tenorCount = tenors.size();
+	lowerIndex = 0;
+	upperIndex = 0;
+	weight = 0.0;
+	if (tenorCount == 0 || time <= tenors[0]) return;
+	
+	// Flat extrapolation beyond the last tenor
+	if (time >= tenors[tenorCount - 1])
+	{
+		lowerIndex = tenorCount - 1;
+		upperIndex = tenorCount - 1;
+		return;
+	}
+	
+	upperIndex = upper_bound(tenors.begin(), tenors.end(), time) - tenors.begin();
+	lowerIndex = upperIndex - 1;
+	weight = (time - tenors[lowerIndex]) / (tenors[upperIndex] - tenors[lowerIndex]);
+}
+
+double DiscountCurve::GetZeroRate(double time) const
+{
+	if (zeroRates.empty()) return 0.0;
+	
+	int lowerIndex, upperIndex;
+	double weight;
+	GetInterpolation(time, lowerIndex, upperIndex, weight);
+	return (1.0 - weight) * zeroRates[lowerIndex] + weight * zeroRates[upperIndex];
+}
+
+double DiscountCurve::GetDiscountFactor(double time) const
+{
+	return exp(-GetZeroRate(time) * time);
+}
@@ -0,0 +1,66 @@
+/**
+ * DiscountCurve.hpp
+ * Defines a zero coupon discount curve.
+ *
+ * @author Jordan Wang
+ */
+
+#ifndef DiscountCurve_hpp
+#define DiscountCurve_hpp
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <unordered_map>
+using namespace std;
+
+
+
+
+/**
+ * Discount curve of continuously compounded zero rates at a set of tenors (in years).
+ * Zero rates are linearly interpolated between tenors and flat extrapolated outside them.
+ */
+class DiscountCurve
+{
+
+public:
+	// default ctor
+	DiscountCurve() = default;
+
+	// ctor for a curve from tenors (in increasing order) and their zero rates
+	DiscountCurve(const vector<double> &_tenors, const vector<double> &_zeroRates);
+
+	// Get the tenors of the curve
+	const vector<double>& GetTenors() const;
+
+	// Get the zero rates at the tenors of the curve
+	const vector<double>& GetZeroRates() const;
+
+	// Set the zero rate at a tenor of the curve
+	void SetZeroRate(int index, double zeroRate);
+
+	// Get the interpolation knots and weight of a time, so that
+	// the zero rate is (1 - weight) * zeroRates[lowerIndex] + weight * zeroRates[upperIndex]
+	void GetInterpolation(double time, int &lowerIndex, int &upperIndex, double &weight) const;
+
+	// Get the zero rate at a time
+	double GetZeroRate(double time) const;
+
+	// Get the discount factor at a time
+	double GetDiscountFactor(double time) const;
+
+private:
+	vector<double> tenors;
+	vector<double> zeroRates;
+};
+
+
+
+
+#endif
@@ -0,0 +1,268 @@
+/**
+ * EventLoop.cpp
+ * Defines a single-threaded event loop dispatching connector input and timers.
+ *
+ * @author Jordan Wang
+ */
+
+#include "EventLoop.hpp"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/stat.h>
+using namespace std;
+
+
+
+
+// Get the monotonic clock in ms
+long GetMonotonicTime()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
+
+
+
+
+EventLoop::EventLoop(TimerWheel* _timers)
+{
+	timers = _timers;
+	clockOffset = timers->GetTime() - GetMonotonicTime();
+	armedExpiry = -1;
+	stopping = false;
+
+	epollFd = epoll_create1(EPOLL_CLOEXEC);
+	timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.fd = timerFd;
+	epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event);
+	event.data.fd = wakeFd;
+	epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+}
+
+EventLoop::~EventLoop()
+{
+	for (unordered_map<int, EventListener*>::iterator it = readers.begin(); it != readers.end(); it++)
+		close(it->first);
+	for (vector<pair<int, EventListener*>>::iterator it = fileReaders.begin(); it != fileReaders.end(); it++)
+		close(it->first);
+	close(wakeFd);
+	close(timerFd);
+	close(epollFd);
+}
+
+bool EventLoop::AddReader(int fd, EventListener* listener)
+{
+	if (fd < 0) return false;
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	// Regular files cannot be watched with epoll, they are always readable
+	struct stat status;
+	if (fstat(fd, &status) == 0 && S_ISREG(status.st_mode))
+	{
+		fileReaders.push_back(make_pair(fd, listener));
+		return true;
+	}
+
+	epoll_event event = {};
+	event.events = EPOLLIN | EPOLLRDHUP;
+	event.data.fd = fd;
+	if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) return false;
+	readers[fd] = listener;
+	return true;
+}
+
+void EventLoop::RemoveReader(int fd)
+{
+	if (readers.erase(fd) > 0) epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+	for (vector<pair<int, EventListener*>>::iterator it = fileReaders.begin(); it != fileReaders.end(); it++)
+	{
+		if (it->first == fd)
+		{
+			fileReaders.erase(it);
+			break;
+		}
+	}
+	close(fd);
+}
+
+int EventLoop::GetReaderCount() const
+{
+	return readers.size() + fileReaders.size();
+}
+
+long EventLoop::GetTime() const
+{
+	return GetMonotonicTime() + clockOffset;
+}
+
+TimerWheel* EventLoop::GetTimerWheel()
+{
+	return timers;
+}
+
+int EventLoop::RunOnce(int timeout)
+{
+	int dispatched = 0;
+	if (!fileReaders.empty()) timeout = 0;		// regular files are ready right away
+	ArmTimer();
+
+	int eventCount = epoll_wait(epollFd, events, EVENT_LOOP_MAX_EVENTS, timeout);
+	for (int i = 0; i < eventCount; i++)
+	{
+		int fd = events[i].data.fd;
+		uint64_t count;
+		if (fd == timerFd)
+		{
+			if (read(timerFd, &count, sizeof(count)) > 0) armedExpiry = -1;
+			continue;
+		}
+		if (fd == wakeFd)
+		{
+			if (read(wakeFd, &count, sizeof(count)) > 0) stopping = true;
+			continue;
+		}
+
+		// The reader may have been removed by an earlier callback of this wait
+		unordered_map<int, EventListener*>::iterator it = readers.find(fd);
+		if (it == readers.end()) continue;
+		if (!it->second->ProcessReadable(fd)) RemoveReader(fd);
+		dispatched++;
+	}
+
+	// One buffer of each regular file per turn, so that files do not starve the other feeds
+	for (int i = 0; i < (int)fileReaders.size(); )
+	{
+		int fd = fileReaders[i].first;
+		dispatched++;
+		if (fileReaders[i].second->ProcessReadable(fd)) i++;
+		else RemoveReader(fd);
+	}
+
+	dispatched += timers->Advance(GetTime());
+	return dispatched;
+}
+
+void EventLoop::Run()
+{
+	while (!stopping && GetReaderCount() > 0)
+		RunOnce(-1);
+	stopping = false;
+}
+
+void EventLoop::Stop()
+{
+	uint64_t count = 1;
+	if (write(wakeFd, &count, sizeof(count)) < 0) cout << "Cannot wake the event loop up: " << strerror(errno) << endl;
+}
+
+void EventLoop::ArmTimer()
+{
+	long nextExpiry = timers->GetNextExpiry();
+	if (nextExpiry == armedExpiry) return;
+
+	// Absolute monotonic expiry, or a zero itimerspec to disarm
+	itimerspec expiry = {};
+	if (nextExpiry >= 0)
+	{
+		long monotonicExpiry = max(nextExpiry - clockOffset, 1L);
+		expiry.it_value.tv_sec = monotonicExpiry / 1000;
+		expiry.it_value.tv_nsec = (monotonicExpiry % 1000) * 1000000L;
+	}
+	timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &expiry, nullptr);
+	armedExpiry = nextExpiry;
+}
+
+
+
+
+template<typename C>
+LineSubscriber<C>::LineSubscriber(C* _connector)
+{
+	connector = _connector;
+	buffer = vector<char>(LINE_SUBSCRIBER_BUFFER_SIZE);
+	length = 0;
+	lineCount = 0;
+}
+
+template<typename C>
+bool LineSubscriber<C>::ProcessReadable(int fd)
+{
+	ssize_t bytes = read(fd, &buffer[length], buffer.size() - length);
+	if (bytes < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	if (bytes == 0)
+	{
+		// End of the input: subscribe the last line even without its newline
+		if (length > 0) SubscribeLine(0, length);
+		length = 0;
+		return false;
+	}
+
+	// Subscribe every complete line, and keep the partial line at the front of the buffer
+	int begin = 0;
+	int end = length + bytes;
+	for (int i = length; i < end; i++)
+	{
+		if (buffer[i] != '\n') continue;
+		SubscribeLine(begin, i);
+		begin = i + 1;
+	}
+	length = end - begin;
+	if (begin > 0 && length > 0) memmove(&buffer[0], &buffer[begin], length);
+
+	// A line longer than the buffer is cut, so that the reader never stalls
+	if (length == (int)buffer.size())
+	{
+		SubscribeLine(0, length);
+		length = 0;
+	}
+	return true;
+}
+
+template<typename C>
+long LineSubscriber<C>::GetLineCount() const
+{
+	return lineCount;
+}
+
+template<typename C>
+void LineSubscriber<C>::SubscribeLine(int begin, int end)
+{
+	// Split on blanks and trim each word, as ReadDataLine does, without copying the line first
+	int wordCount = 0;
+	const char* line = &buffer[0];
+	for (int wordBegin = begin; wordBegin <= end; )
+	{
+		int wordEnd = wordBegin;
+		while (wordEnd < end && line[wordEnd] != ' ') wordEnd++;
+		int next = wordEnd + 1;
+		while (wordBegin < wordEnd && isspace((unsigned char)line[wordBegin])) wordBegin++;
+		while (wordEnd > wordBegin && isspace((unsigned char)line[wordEnd - 1])) wordEnd--;
+		if (wordCount == (int)words.size()) words.push_back(string());
+		words[wordCount++].assign(line + wordBegin, wordEnd - wordBegin);
+		if (next >= end) break;		// no word after a trailing blank, as with getline
+		wordBegin = next;
+	}
+	if (wordCount == 0 || words[0].empty()) return;		// blank line
+	
+	// The words past this line's are kept for longer lines to come
+	connector->SubscribeLine(words, wordCount);
+	lineCount++;
+}
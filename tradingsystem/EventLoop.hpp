@@ -0,0 +1,144 @@
+/**
+ * EventLoop.hpp
+ * Defines a single-threaded event loop dispatching connector input and timers.
+ *
+ * @author Jordan Wang
+ */
+
+#ifndef EventLoop_hpp
+#define EventLoop_hpp
+#include "TimerWheel.hpp"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <sys/epoll.h>
+using namespace std;
+
+
+
+
+const int EVENT_LOOP_MAX_EVENTS = 64;			// max # of events dispatched per wait
+const int LINE_SUBSCRIBER_BUFFER_SIZE = 65536;	// bytes read per readable event
+
+
+
+
+/**
+ * Callback of a file descriptor on an event loop.
+ */
+class EventListener
+{
+
+public:
+	// dtor
+	virtual ~EventListener() = default;
+
+	// Callback when a file descriptor is readable, returning false once its input has ended
+	virtual bool ProcessReadable(int fd) = 0;
+};
+
+
+
+
+/**
+ * Event loop running the connectors and timers of the process on one thread.
+ * Pipes, sockets and FIFOs are watched with epoll, and each is dispatched to its listener as it becomes
+ * readable, so every feed progresses as its data arrives. Regular files are always readable and cannot
+ * be watched, so they are dispatched once per turn of the loop, one buffer at a time, alongside the rest.
+ * The timer wheel is driven by the loop's monotonic clock in ms: a timerfd is armed for the wheel's
+ * next expiry, and the wheel is advanced on every turn. Stop may be called from any thread, and wakes
+ * the loop through an eventfd.
+ */
+class EventLoop
+{
+
+public:
+	// ctor for a loop driving a timer wheel, with the loop's clock starting at the wheel's time
+	EventLoop(TimerWheel* _timers);
+
+	// dtor closing the descriptors of the loop and of its readers
+	~EventLoop();
+
+	// Watch a file descriptor, made non-blocking, and dispatch its input to a listener (false if it cannot be watched)
+	// The loop owns the file descriptor from then on, and closes it once it is removed
+	bool AddReader(int fd, EventListener* listener);
+
+	// Stop watching a file descriptor and close it
+	void RemoveReader(int fd);
+
+	// Get the # of file descriptors watched
+	int GetReaderCount() const;
+
+	// Get the loop's clock in ms
+	long GetTime() const;
+
+	// Get the timer wheel driven by the loop
+	TimerWheel* GetTimerWheel();
+
+	// Wait up to a timeout in ms (-1 for no timeout) and dispatch what is ready, returning the # of dispatches
+	int RunOnce(int timeout);
+
+	// Run until Stop is called or the input of every reader has ended
+	void Run();
+
+	// Stop the loop (from any thread)
+	void Stop();
+
+private:
+	// Arm the timerfd for the next expiry of the timer wheel
+	void ArmTimer();
+
+	int epollFd;										// epoll instance
+	int timerFd;										// timerfd of the next expiry of the wheel
+	int wakeFd;											// eventfd waking the loop up to stop
+	TimerWheel* timers;									// a pointer to the timer wheel driven by the loop
+	long clockOffset;									// loop's clock minus the monotonic clock, in ms
+	long armedExpiry;									// expiry the timerfd is armed for (-1 if disarmed)
+	bool stopping;										// whether Stop has been called
+	unordered_map<int, EventListener*> readers;			// a map of {watched file descriptor -> listener}
+	vector<pair<int, EventListener*>> fileReaders;		// regular files, dispatched on every turn
+	epoll_event events[EVENT_LOOP_MAX_EVENTS];			// events of the last wait
+};
+
+
+
+
+/**
+ * Listener reading lines of data from a file descriptor into a connector.
+ * Input is read straight into a fixed buffer and each complete line is split into words, as ReadDataStream
+ * does, without copying the line first: each word is copied once from the buffer into a string of a reused
+ * word vector passed to the connector's SubscribeLine with the line's word count. The vector is never shrunk
+ * and the strings keep their storage across lines, so steady-state lines do not allocate. A partial line waits in the buffer for the rest of its bytes.
+ * Type C is the connector type.
+ */
+template<typename C>
+class LineSubscriber : public EventListener
+{
+
+public:
+	// ctor
+	LineSubscriber(C* _connector);
+
+	// Read what is available and subscribe every complete line, returning false at the end of the input
+	bool ProcessReadable(int fd);
+
+	// Get the # of lines subscribed
+	long GetLineCount() const;
+
+private:
+	// Subscribe the line of [begin, end) in the buffer
+	void SubscribeLine(int begin, int end);
+
+	C* connector;						// a pointer to the connector subscribing the lines
+	vector<char> buffer;				// bytes read but not yet subscribed
+	vector<string> words;				// words of the line being subscribed, reused across lines
+	int length;							// # of bytes in the buffer
+	long lineCount;						// # of lines subscribed
+};
+
+
+
+
+#endif
@@ -28,7 +28,18 @@ GUIService<T>::GUIService()
     connector = new GUIConnector<T>(this);
     listener = new GUIToPricingListener<T>(this);
     throttle = 300;
-    millisecond = GetMillisecond();
+	sharedPrices = new SharedPriceWriter("/gui_prices", 64);
+	timers = nullptr;
+	timerListener = new GUIToTimerListener<T>(this);
+	throttleTimerId = -1;
+}
+
+template<typename T>
+GUIService<T>::~GUIService()
+{
+	if (timers != nullptr) timers->Cancel(throttleTimerId);
+	Flush();		// publish the last prices
+	delete sharedPrices;
 }
 
 template<typename T>
@@ -43,8 +54,10 @@ void GUIService<T>::OnMessage(Price<T>& data)
 	T curr_product = data.GetProduct();
 	string productId = curr_product.GetProductId();
     guis[productId] = data;
+	sharedPrices->Publish(productId, data.GetMid(), data.GetBidOfferSpread());	// readers see every update
 	
-    connector->Publish(data);	// output to gui.txt
+	// Latest price wins until the next flush
+	pendingPrices[productId] = data;
 }
 
 template<typename T>
@@ -78,15 +91,38 @@ int GUIService<T>::GetThrottle()
 }
 
 template<typename T>
-int GUIService<T>::GetMillisecond() 
+SharedPriceWriter* GUIService<T>::GetSharedPrices()
 {
-	return millisecond;
+	return sharedPrices;
 }
 
 template<typename T>
-void GUIService<T>::SetMillisecond(int _millisecond) 
+void GUIService<T>::SetTimerWheel(TimerWheel* _timers)
 {
-	millisecond = _millisecond;
+	if (timers != nullptr) timers->Cancel(throttleTimerId);
+	timers = _timers;
+	throttleTimerId = -1;
+	if (timers == nullptr)
+	{
+		Flush();		// no more throttle ticks, so publish what is pending now
+		return;
+	}
+	throttleTimerId = timers->Schedule(timers->GetTime() + throttle, timerListener, 0);
+}
+
+template<typename T>
+void GUIService<T>::Flush()
+{
+	for (typename map<string, Price<T>>::iterator it = pendingPrices.begin(); it != pendingPrices.end(); it++)
+		connector->Publish(it->second);		// output to gui.txt
+	pendingPrices.clear();
+}
+
+template<typename T>
+void GUIService<T>::OnThrottle()
+{
+	Flush();
+	throttleTimerId = timers->Schedule(timers->GetTime() + throttle, timerListener, 0);
 }
 
 
@@ -101,15 +137,7 @@ GUIConnector<T>::GUIConnector(GUIService<T>* _service)
 template<typename T>
 void GUIConnector<T>::Publish(Price<T>& _data)
 {
-	int throttle = service->GetThrottle();
-	int millisecondStart = service->GetMillisecond();
-	int millisecondNow = GetMillisecond();
-	
-	if (millisecondNow - millisecondStart >= throttle) 
-	{
-		service->SetMillisec(millisecondNow);			// reset millisecond
-		OutputDataStream("gui.txt", _data.print());		// output to gui.txt
-	}
+	OutputDataStream("gui.txt", _data.print());		// output to gui.txt (throttled by GUIService)
 }
 	
 	
@@ -127,5 +155,30 @@ void GUIToPricingListener<T>::ProcessAdd(Price<T>& _data)
 	service->OnMessage(_data);
 }
 
+template<typename T>
+void GUIToPricingListener<T>::ProcessRemove(Price<T>& _data)
+{
+}
+
+template<typename T>
+void GUIToPricingListener<T>::ProcessUpdate(Price<T>& _data)
+{
+}
+
+
+
+
+template<typename T>
+GUIToTimerListener<T>::GUIToTimerListener(GUIService<T>* _service) 
+{
+	service = _service;
+}
+
+template<typename T>
+void GUIToTimerListener<T>::ProcessTimeout(long data) 
+{
+	service->OnThrottle();
+}
+
 
 
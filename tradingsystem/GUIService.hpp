@@ -10,6 +10,8 @@
 #include "my functions.hpp"
 #include "products.hpp"
 #include "BondPricingService.hpp"
+#include "SharedPriceTable.hpp"
+#include "TimerWheel.hpp"
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -32,11 +34,23 @@ class GUIConnector;
 template<typename T>
 class GUIToPricingListener; 
 
+/* Listener of GUIService on its throttle timer */
+template<typename T>
+class GUIToTimerListener;
 
 
 
-/* GUIService */
 
+/**
+ * GUI Service publishing prices to the GUI with a per-product throttle.
+ * A price update only replaces the pending price of its product, and a throttle timer on the
+ * shared timer wheel publishes the latest price of each product that changed once every throttle interval,
+ * so the GUI shows the freshest price of every bond while the output stays bounded.
+ * Every price update is also written straight to a shared memory table ("/gui_prices"),
+ * which GUI and monitor processes on the box read without syscalls (see guireader.cpp).
+ * Keyed on product identifier.
+ * Type T is the product type.
+ */
 template<typename T>
 class GUIService : Service<string, Price<T>>
 {
@@ -65,11 +79,20 @@ public:
 	// Get throttle
     int GetThrottle();
 	
-	// Get millisec
-    int GetMillisecond();
+	// Get the shared memory table of latest prices
+	SharedPriceWriter* GetSharedPrices();
+	
+	// Set the timer wheel the throttle timer is scheduled on, driven by the owner's clock in ms (nullptr to stop it)
+	void SetTimerWheel(TimerWheel* _timers);
+	
+	// Publish the latest price of every product that changed since the last flush
+	void Flush();
 	
-	// Set millisec
-    void SetMillisecond(int _millisecond);
+	// Flush at the end of a throttle interval, and schedule the next one
+	void OnThrottle();
+	
+	// dtor cancelling the throttle timer and flushing the last prices
+	~GUIService();
 	
 private:
     map<string, Price<T>> guis;						// a map of {product identifier -> price value}
@@ -77,7 +100,11 @@ private:
     GUIConnector<T>* connector;						// a pointer to GUIConnector
     GUIToPricingListener<T>* listener;				// a pointer to a listener to PricingService
     int throttle;									// 300ms throttle
-    int millisecond;								// millisecond (0~300)
+	SharedPriceWriter* sharedPrices;				// a pointer to the shared memory table of latest prices
+	map<string, Price<T>> pendingPrices;			// latest price of each product changed since the last flush
+	TimerWheel* timers;								// a pointer to the timer wheel of the throttle timer
+	GUIToTimerListener<T>* timerListener;			// a pointer to the listener on the throttle timer
+	long throttleTimerId;							// identifier of the pending throttle timer (-1 if none)
 };
 
 
@@ -128,4 +155,22 @@ private:
 
 
 
-#endif
\ No newline at end of file
+/* Listener of GUIService on its throttle timer */
+template<typename T>
+class GUIToTimerListener : public TimerListener
+{
+public:
+	// ctor
+    GUIToTimerListener(GUIService<T>* _service);
+	
+    // Timer callback at the end of a throttle interval
+    void ProcessTimeout(long data);
+	
+private:
+    GUIService<T>* service;				// a pointer to GUIService
+};
+
+
+
+
+#endif
@@ -0,0 +1,291 @@
+/**
+ * LimitOrderBook.cpp
+ * Defines an order-level (L3) limit order book on a fixed price ladder.
+ *
+ * @author Jordan Wang
+ */
+
+#include "LimitOrderBook.hpp"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+using namespace std;
+
+
+
+
+LimitOrderBook::LimitOrderBook(long _minPrice, long _maxPrice, int _capacity) :
+	orders(_capacity), minPrice(_minPrice), priceCount(_maxPrice - _minPrice + 1), freeHead(_capacity > 0 ? 0 : -1),
+	orderCount(0), nextPriority(0), tradedQuantity(0)
+{
+	levels = vector<PriceLevel>(2 * priceCount, PriceLevel{ 0, 0, -1, -1 });
+	for (int side = 0; side < 2; side++)
+	{
+		occupancy[side] = vector<uint64_t>((priceCount + 63) / 64, 0);
+		bestLevels[side] = -1;
+	}
+	for (int i = 0; i < _capacity; i++)
+		orders[i].next = (i + 1 < _capacity) ? i + 1 : -1;
+
+	// Keep the hash index at most half full, so that probes stay short
+	int hashSize = 16;
+	while (hashSize < 2 * _capacity)
+		hashSize <<= 1;
+	hashSlots = vector<int>(hashSize, -1);
+	hashMask = hashSize - 1;
+}
+
+bool LimitOrderBook::AddOrder(long orderId, int side, long price, long quantity)
+{
+	int level = GetLevel(side, price);
+	if (level < 0 || quantity <= 0 || freeHead < 0) return false;
+
+	// Probe for the identifier, stopping at the first empty slot
+	int slot = GetHashSlot(orderId);
+	while (hashSlots[slot] >= 0)
+	{
+		if (orders[hashSlots[slot]].orderId == orderId) return false;
+		slot = (slot + 1) & hashMask;
+	}
+
+	int index = freeHead;
+	freeHead = orders[index].next;
+	hashSlots[slot] = index;
+	BookOrder& order = orders[index];
+	order.orderId = orderId;
+	order.quantity = quantity;
+	order.priority = nextPriority++;
+	order.level = level;
+
+	// Queue at the tail of the level
+	PriceLevel& priceLevel = levels[level];
+	order.previous = priceLevel.tail;
+	order.next = -1;
+	if (priceLevel.tail >= 0) orders[priceLevel.tail].next = index;
+	else priceLevel.head = index;
+	priceLevel.tail = index;
+	priceLevel.quantity += quantity;
+	priceLevel.orderCount++;
+	orderCount++;
+
+	if (priceLevel.orderCount == 1)
+	{
+		int priceIndex = price - minPrice;
+		occupancy[side][priceIndex >> 6] |= 1ULL << (priceIndex & 63);
+		int& best = bestLevels[side];
+		if (best < 0 || (side == 0 ? priceIndex > best : priceIndex < best)) best = priceIndex;
+	}
+	return true;
+}
+
+long LimitOrderBook::CancelOrder(long orderId, long quantity)
+{
+	int slot = FindSlot(orderId);
+	if (slot < 0) return 0;
+	return ReduceOrder(slot, quantity);
+}
+
+long LimitOrderBook::ExecuteOrder(long orderId, long quantity)
+{
+	int slot = FindSlot(orderId);
+	if (slot < 0) return 0;
+	long executed = ReduceOrder(slot, quantity);
+	tradedQuantity += executed;
+	return executed;
+}
+
+long LimitOrderBook::Match(int side, long limitPrice, long quantity, BookFillListener* listener)
+{
+	long filled = 0;
+	while (filled < quantity && bestLevels[side] >= 0)
+	{
+		// Stop at the first price worse than the limit: selling into bids takes at least it, buying offers at most it
+		long price = minPrice + bestLevels[side];
+		if (limitPrice > 0 && (side == 0 ? price < limitPrice : price > limitPrice)) break;
+
+		const PriceLevel& priceLevel = levels[side * priceCount + bestLevels[side]];
+		const BookOrder& order = orders[priceLevel.head];
+		long fill = min(quantity - filled, order.quantity);
+		if (listener) listener->ProcessFill(order.orderId, price, fill);
+		ReduceOrder(FindSlot(order.orderId), fill);
+		filled += fill;
+	}
+	tradedQuantity += filled;
+	return filled;
+}
+
+long LimitOrderBook::GetBestPrice(int side) const
+{
+	return bestLevels[side] < 0 ? -1 : minPrice + bestLevels[side];
+}
+
+long LimitOrderBook::GetLevelQuantity(int side, long price) const
+{
+	int level = GetLevel(side, price);
+	return level < 0 ? 0 : levels[level].quantity;
+}
+
+int LimitOrderBook::GetLevelOrderCount(int side, long price) const
+{
+	int level = GetLevel(side, price);
+	return level < 0 ? 0 : levels[level].orderCount;
+}
+
+long LimitOrderBook::GetAvailableQuantity(int side, long limitPrice) const
+{
+	// Walk the levels with orders from the best, a bitmap word at a time
+	long available = 0;
+	for (int word = (bestLevels[side] < 0) ? -1 : bestLevels[side] >> 6; word >= 0 && word < (int)occupancy[side].size(); word += (side == 0) ? -1 : 1)
+	{
+		uint64_t bits = occupancy[side][word];
+		while (bits)
+		{
+			int bit = (side == 0) ? 63 - __builtin_clzll(bits) : __builtin_ctzll(bits);
+			bits &= ~(1ULL << bit);
+			long price = minPrice + 64 * word + bit;
+			if (limitPrice > 0 && (side == 0 ? price < limitPrice : price > limitPrice)) return available;
+			available += levels[side * priceCount + 64 * word + bit].quantity;
+		}
+	}
+	return available;
+}
+
+bool LimitOrderBook::HasOrder(long orderId) const
+{
+	return FindSlot(orderId) >= 0;
+}
+
+int LimitOrderBook::GetOrderSide(long orderId) const
+{
+	int slot = FindSlot(orderId);
+	return slot < 0 ? -1 : orders[hashSlots[slot]].level / priceCount;
+}
+
+long LimitOrderBook::GetOrderPrice(long orderId) const
+{
+	int slot = FindSlot(orderId);
+	return slot < 0 ? -1 : minPrice + orders[hashSlots[slot]].level % priceCount;
+}
+
+long LimitOrderBook::GetOrderQuantity(long orderId) const
+{
+	int slot = FindSlot(orderId);
+	return slot < 0 ? 0 : orders[hashSlots[slot]].quantity;
+}
+
+long LimitOrderBook::GetOrderPriority(long orderId) const
+{
+	int slot = FindSlot(orderId);
+	return slot < 0 ? -1 : orders[hashSlots[slot]].priority;
+}
+
+int LimitOrderBook::GetOrderCount() const
+{
+	return orderCount;
+}
+
+int LimitOrderBook::GetCapacity() const
+{
+	return orders.size();
+}
+
+long LimitOrderBook::GetTradedQuantity() const
+{
+	return tradedQuantity;
+}
+
+int LimitOrderBook::GetLevel(int side, long price) const
+{
+	if (side < 0 || side > 1 || price < minPrice || price >= minPrice + priceCount) return -1;
+	return side * priceCount + (price - minPrice);
+}
+
+long LimitOrderBook::ReduceOrder(int slot, long quantity)
+{
+	BookOrder& order = orders[hashSlots[slot]];
+	long reduced = max(min(quantity, order.quantity), 0L);
+	order.quantity -= reduced;
+	levels[order.level].quantity -= reduced;
+	if (order.quantity == 0) RemoveOrder(slot);
+	return reduced;
+}
+
+void LimitOrderBook::RemoveOrder(int slot)
+{
+	int index = hashSlots[slot];
+	BookOrder& order = orders[index];
+	PriceLevel& priceLevel = levels[order.level];
+	if (order.previous >= 0) orders[order.previous].next = order.next;
+	else priceLevel.head = order.next;
+	if (order.next >= 0) orders[order.next].previous = order.previous;
+	else priceLevel.tail = order.previous;
+	priceLevel.quantity -= order.quantity;
+	priceLevel.orderCount--;
+
+	if (priceLevel.orderCount == 0)
+	{
+		int side = order.level / priceCount;
+		int priceIndex = order.level % priceCount;
+		occupancy[side][priceIndex >> 6] &= ~(1ULL << (priceIndex & 63));
+		if (bestLevels[side] == priceIndex) UpdateBestLevel(side, (side == 0) ? priceIndex - 1 : priceIndex + 1);
+	}
+
+	order.next = freeHead;
+	freeHead = index;
+	UnindexOrder(slot);
+	orderCount--;
+}
+
+void LimitOrderBook::UpdateBestLevel(int side, int start)
+{
+	// The best bid is the highest price with orders at or below start, the best offer the lowest at or above it
+	bestLevels[side] = -1;
+	if (start < 0 || start >= priceCount) return;
+
+	const vector<uint64_t>& bits = occupancy[side];
+	int word = start >> 6;
+	uint64_t mask = (side == 0) ? (2ULL << (start & 63)) - 1 : ~0ULL << (start & 63);
+	for (uint64_t curr = bits[word] & mask; word >= 0 && word < (int)bits.size(); )
+	{
+		if (curr)
+		{
+			bestLevels[side] = 64 * word + ((side == 0) ? 63 - __builtin_clzll(curr) : __builtin_ctzll(curr));
+			return;
+		}
+		word += (side == 0) ? -1 : 1;
+		if (word >= 0 && word < (int)bits.size()) curr = bits[word];
+	}
+}
+
+int LimitOrderBook::GetHashSlot(long orderId) const
+{
+	// Fibonacci hashing spreads sequential identifiers over the table
+	return (int)(((uint64_t)orderId * 0x9E3779B97F4A7C15ULL) >> 32) & hashMask;
+}
+
+int LimitOrderBook::FindSlot(long orderId) const
+{
+	for (int slot = GetHashSlot(orderId); hashSlots[slot] >= 0; slot = (slot + 1) & hashMask)
+		if (orders[hashSlots[slot]].orderId == orderId) return slot;
+	return -1;
+}
+
+void LimitOrderBook::UnindexOrder(int slot)
+{
+	// Backward shift deletion: move up every later entry of the probe run that may live in the hole,
+	// so lookups never need tombstones
+	int hole = slot;
+	for (int next = (slot + 1) & hashMask; hashSlots[next] >= 0; next = (next + 1) & hashMask)
+	{
+		int home = GetHashSlot(orders[hashSlots[next]].orderId);
+		if (((next - home) & hashMask) >= ((next - hole) & hashMask))
+		{
+			hashSlots[hole] = hashSlots[next];
+			hole = next;
+		}
+	}
+	hashSlots[hole] = -1;
+}
@@ -0,0 +1,158 @@
+/**
+ * LimitOrderBook.hpp
+ * Defines an order-level (L3) limit order book on a fixed price ladder.
+ *
+ * @author Jordan Wang
+ */
+
+#ifndef LimitOrderBook_hpp
+#define LimitOrderBook_hpp
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+using namespace std;
+
+
+
+
+/**
+ * Callback of the resting orders filled when an order is matched against a limit order book.
+ */
+class BookFillListener
+{
+
+public:
+	// dtor
+	virtual ~BookFillListener() = default;
+
+	// Callback when a resting order is filled at its price (before it leaves the book if it is done)
+	virtual void ProcessFill(long orderId, long price, long quantity) = 0;
+};
+
+
+
+
+/**
+ * Order-level limit order book of one product, with prices in integer ticks on a fixed ladder.
+ * Every price of the ladder has a level on each side holding its orders in time priority, as an
+ * intrusive doubly linked list through a pool of orders allocated once. Orders are found by identifier
+ * through an open-addressing hash index, so adding, cancelling and executing an order are O(1) and never
+ * allocate; the best level of a side moves on through a bitmap of the levels with orders, a word at a time.
+ * Sides are 0 for BID and 1 for OFFER, as on the market data wire.
+ */
+class LimitOrderBook
+{
+
+public:
+	// ctor for a book of prices in [minPrice, maxPrice] ticks with room for capacity orders
+	LimitOrderBook(long _minPrice, long _maxPrice, int _capacity);
+
+	// Add an order at the back of the queue of its price (false if the identifier is live, the price is off the ladder or the pool is full)
+	bool AddOrder(long orderId, int side, long price, long quantity);
+
+	// Cancel part of an order, leaving its time priority, and remove it once nothing is left (returns the quantity cancelled)
+	long CancelOrder(long orderId, long quantity);
+
+	// Execute part of an order, and remove it once nothing is left (returns the quantity executed)
+	long ExecuteOrder(long orderId, long quantity);
+
+	// Match an incoming order against a side of the book, best price then time first, up to a limit price
+	// (0 for any price); returns the quantity filled, reporting each resting order filled to the listener
+	long Match(int side, long limitPrice, long quantity, BookFillListener* listener);
+
+	// Get the best price of a side (-1 if the side is empty)
+	long GetBestPrice(int side) const;
+
+	// Get the quantity resting at a price of a side
+	long GetLevelQuantity(int side, long price) const;
+
+	// Get the # of orders resting at a price of a side
+	int GetLevelOrderCount(int side, long price) const;
+
+	// Get the quantity a side offers up to a limit price (0 for any price)
+	long GetAvailableQuantity(int side, long limitPrice) const;
+
+	// Whether an order is live in the book
+	bool HasOrder(long orderId) const;
+
+	// Get the side of a live order (-1 if it is unknown)
+	int GetOrderSide(long orderId) const;
+
+	// Get the price of a live order (-1 if it is unknown)
+	long GetOrderPrice(long orderId) const;
+
+	// Get the quantity left on a live order (0 if it is unknown)
+	long GetOrderQuantity(long orderId) const;
+
+	// Get the time priority of a live order, lower first (-1 if it is unknown)
+	long GetOrderPriority(long orderId) const;
+
+	// Get the # of live orders
+	int GetOrderCount() const;
+
+	// Get the # of orders the pool has room for
+	int GetCapacity() const;
+
+	// Get the total quantity executed or matched
+	long GetTradedQuantity() const;
+
+private:
+	struct BookOrder
+	{
+		long orderId;					// order identifier
+		long quantity;					// quantity left
+		long priority;					// arrival number, for time priority across levels
+		int level;						// level of the order, side-major
+		int previous;					// previous order of the level (-1 at the head)
+		int next;						// next order of the level, or in the free list (-1 at the tail)
+	};
+
+	struct PriceLevel
+	{
+		long quantity;					// quantity of the orders of the level
+		int orderCount;					// # of orders of the level
+		int head;						// oldest order (-1 if empty)
+		int tail;						// newest order (-1 if empty)
+	};
+
+	// Get the level of a price of a side (-1 if it is off the ladder)
+	int GetLevel(int side, long price) const;
+
+	// Take quantity off the order of a hash slot, removing it once nothing is left
+	long ReduceOrder(int slot, long quantity);
+
+	// Unlink the order of a hash slot from its level, return it to the pool and unindex it
+	void RemoveOrder(int slot);
+
+	// Move the best level of a side on to the next level with orders, from a price index on
+	void UpdateBestLevel(int side, int start);
+
+	// Get the hash slot of an order identifier
+	int GetHashSlot(long orderId) const;
+
+	// Find the hash slot of a live order (-1 if it is unknown)
+	int FindSlot(long orderId) const;
+
+	// Remove an order identifier from the hash index, shifting back the entries after it
+	void UnindexOrder(int slot);
+
+	vector<BookOrder> orders;			// order pool
+	vector<PriceLevel> levels;			// level of each price of each side, side-major
+	vector<uint64_t> occupancy[2];		// bitmap of the levels with orders, per side
+	vector<int> hashSlots;				// pool index of the order in each hash slot (-1 if empty)
+	int hashMask;						// # of hash slots - 1
+	int bestLevels[2];					// price index of the best level of each side (-1 if empty)
+	long minPrice;						// lowest price of the ladder
+	int priceCount;						// # of prices of the ladder
+	int freeHead;						// head of the free list
+	int orderCount;						// # of live orders
+	long nextPriority;					// arrival number of the next order
+	long tradedQuantity;				// total quantity executed or matched
+};
+
+
+
+
+#endif
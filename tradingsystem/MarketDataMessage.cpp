@@ -0,0 +1,333 @@
+/**
+ * MarketDataMessage.cpp
+ * Defines the fixed-layout binary wire format of market data, with zero-copy views to decode it.
+ *
+ * @author Jordan Wang
+ */
+
+#include "MarketDataMessage.hpp"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <unistd.h>
+using namespace std;
+
+
+
+
+// Write a little endian field at an offset of a buffer
+void WriteField(char* buffer, int offset, uint64_t value, int size)
+{
+	for (int i = 0; i < size; i++)
+		buffer[offset + i] = (char)((value >> (8 * i)) & 0xFF);
+}
+
+// Write the message header at the start of a buffer
+void WriteHeader(char* buffer, int messageLength, int templateId)
+{
+	WriteField(buffer, 0, messageLength, 2);
+	WriteField(buffer, 2, templateId, 2);
+	WriteField(buffer, 4, MARKET_DATA_SCHEMA_ID, 2);
+	WriteField(buffer, 6, MARKET_DATA_SCHEMA_VERSION, 2);
+}
+
+// Write a product identifier, null padded, at an offset of a buffer
+void WriteProductId(char* buffer, int offset, const string& productId)
+{
+	memset(buffer + offset, 0, MARKET_DATA_PRODUCT_ID_LENGTH);
+	memcpy(buffer + offset, productId.data(), min((int)productId.size(), MARKET_DATA_PRODUCT_ID_LENGTH));
+}
+
+long ParseTickPrice(const string& price)
+{
+	// <points>-<32nds, 2 digits><8ths of a 32nd, a digit or + for 4>
+	size_t dash = price.find('-');
+	if (dash == string::npos || dash == 0 || price.size() != dash + 4) return -1;
+
+	long points = 0;
+	for (size_t i = 0; i < dash; i++)
+	{
+		if (!isdigit((unsigned char)price[i])) return -1;
+		points = 10 * points + (price[i] - '0');
+	}
+	if (!isdigit((unsigned char)price[dash + 1]) || !isdigit((unsigned char)price[dash + 2])) return -1;
+	int thirtySeconds = 10 * (price[dash + 1] - '0') + (price[dash + 2] - '0');
+	int eighths = (price[dash + 3] == '+') ? 4 : price[dash + 3] - '0';
+	if (thirtySeconds >= 32 || eighths < 0 || eighths >= 8) return -1;
+
+	return points * MARKET_DATA_TICKS + thirtySeconds * 8 + eighths;
+}
+
+int EncodeLevelUpdate(char* buffer, unsigned long sequence, const string& productId, int side, int venue, int level,
+	long price, long quantity)
+{
+	WriteHeader(buffer, MARKET_DATA_LEVEL_UPDATE_SIZE, MARKET_DATA_LEVEL_UPDATE);
+	char* block = buffer + MARKET_DATA_HEADER_SIZE;
+	WriteField(block, 0, sequence, 8);
+	WriteProductId(block, 8, productId);
+	WriteField(block, 20, side, 1);
+	WriteField(block, 21, venue, 1);
+	WriteField(block, 22, level, 1);
+	WriteField(block, 23, 0, 1);
+	WriteField(block, 24, price, 8);
+	WriteField(block, 32, quantity, 8);
+	return MARKET_DATA_LEVEL_UPDATE_SIZE;
+}
+
+int EncodeBookSnapshot(char* buffer, unsigned long sequence, const string& productId, int venue, int entryCount)
+{
+	int messageLength = MARKET_DATA_HEADER_SIZE + MARKET_DATA_SNAPSHOT_BLOCK_SIZE + MARKET_DATA_GROUP_HEADER_SIZE
+		+ entryCount * MARKET_DATA_SNAPSHOT_ENTRY_SIZE;
+	WriteHeader(buffer, messageLength, MARKET_DATA_BOOK_SNAPSHOT);
+	char* block = buffer + MARKET_DATA_HEADER_SIZE;
+	WriteField(block, 0, sequence, 8);
+	WriteProductId(block, 8, productId);
+	WriteField(block, 20, venue, 1);
+	WriteField(block, 21, 0, 3);
+	WriteField(block, MARKET_DATA_SNAPSHOT_BLOCK_SIZE, MARKET_DATA_SNAPSHOT_ENTRY_SIZE, 2);
+	WriteField(block, MARKET_DATA_SNAPSHOT_BLOCK_SIZE + 2, entryCount, 2);
+	return MARKET_DATA_HEADER_SIZE + MARKET_DATA_SNAPSHOT_BLOCK_SIZE + MARKET_DATA_GROUP_HEADER_SIZE;
+}
+
+int EncodeBookSnapshotEntry(char* buffer, int offset, long price, long quantity, int side)
+{
+	WriteField(buffer, offset, price, 8);
+	WriteField(buffer, offset + 8, quantity, 8);
+	WriteField(buffer, offset + 16, side, 1);
+	WriteField(buffer, offset + 17, 0, 7);
+	return offset + MARKET_DATA_SNAPSHOT_ENTRY_SIZE;
+}
+
+int EncodeSnapshotRequest(char* buffer, unsigned long lastSequence, const string& productId)
+{
+	WriteHeader(buffer, MARKET_DATA_SNAPSHOT_REQUEST_SIZE, MARKET_DATA_SNAPSHOT_REQUEST);
+	char* block = buffer + MARKET_DATA_HEADER_SIZE;
+	WriteField(block, 0, lastSequence, 8);
+	WriteProductId(block, 8, productId);
+	return MARKET_DATA_SNAPSHOT_REQUEST_SIZE;
+}
+
+void SetMessageSequence(char* buffer, unsigned long sequence)
+{
+	WriteField(buffer, MARKET_DATA_HEADER_SIZE, sequence, 8);
+}
+
+
+
+
+MarketDataMessageView::MarketDataMessageView(const char* _data)
+{
+	data = _data;
+}
+
+int MarketDataMessageView::GetMessageLength() const
+{
+	return ReadField(0, 2);
+}
+
+int MarketDataMessageView::GetTemplateId() const
+{
+	return ReadField(2, 2);
+}
+
+int MarketDataMessageView::GetSchemaId() const
+{
+	return ReadField(4, 2);
+}
+
+int MarketDataMessageView::GetVersion() const
+{
+	return ReadField(6, 2);
+}
+
+unsigned long MarketDataMessageView::GetSequence() const
+{
+	return ReadField(MARKET_DATA_HEADER_SIZE, 8);
+}
+
+string MarketDataMessageView::GetProductId() const
+{
+	const char* productId = data + MARKET_DATA_HEADER_SIZE + 8;
+	return string(productId, strnlen(productId, MARKET_DATA_PRODUCT_ID_LENGTH));
+}
+
+uint64_t MarketDataMessageView::ReadField(int offset, int size) const
+{
+	// Fields are little endian on the wire as in memory on x86, so one unaligned load reads them
+	uint64_t value = 0;
+	memcpy(&value, data + offset, size);
+	return value;
+}
+
+
+
+
+LevelUpdateView::LevelUpdateView(const char* _data) :
+	MarketDataMessageView(_data)
+{
+}
+
+int LevelUpdateView::GetSide() const
+{
+	return ReadField(MARKET_DATA_HEADER_SIZE + 20, 1);
+}
+
+int LevelUpdateView::GetVenue() const
+{
+	return ReadField(MARKET_DATA_HEADER_SIZE + 21, 1);
+}
+
+int LevelUpdateView::GetLevel() const
+{
+	return ReadField(MARKET_DATA_HEADER_SIZE + 22, 1);
+}
+
+long LevelUpdateView::GetPriceTicks() const
+{
+	return ReadField(MARKET_DATA_HEADER_SIZE + 24, 8);
+}
+
+double LevelUpdateView::GetPrice() const
+{
+	return (double)GetPriceTicks() / MARKET_DATA_TICKS;
+}
+
+long LevelUpdateView::GetQuantity() const
+{
+	return ReadField(MARKET_DATA_HEADER_SIZE + 32, 8);
+}
+
+
+
+
+BookSnapshotView::BookSnapshotView(const char* _data) :
+	MarketDataMessageView(_data)
+{
+}
+
+int BookSnapshotView::GetVenue() const
+{
+	return ReadField(MARKET_DATA_HEADER_SIZE + 20, 1);
+}
+
+int BookSnapshotView::GetEntryLength() const
+{
+	return ReadField(MARKET_DATA_HEADER_SIZE + MARKET_DATA_SNAPSHOT_BLOCK_SIZE, 2);
+}
+
+int BookSnapshotView::GetEntryCount() const
+{
+	return ReadField(MARKET_DATA_HEADER_SIZE + MARKET_DATA_SNAPSHOT_BLOCK_SIZE + 2, 2);
+}
+
+int BookSnapshotView::GetEntrySide(int index) const
+{
+	return ReadField(GetEntryOffset(index) + 16, 1);
+}
+
+double BookSnapshotView::GetEntryPrice(int index) const
+{
+	return (double)(long)ReadField(GetEntryOffset(index), 8) / MARKET_DATA_TICKS;
+}
+
+long BookSnapshotView::GetEntryQuantity(int index) const
+{
+	return ReadField(GetEntryOffset(index) + 8, 8);
+}
+
+int BookSnapshotView::GetEntryOffset(int index) const
+{
+	// Entries are laid out at the entry length of the group header, so that later versions may extend them
+	return MARKET_DATA_HEADER_SIZE + MARKET_DATA_SNAPSHOT_BLOCK_SIZE + MARKET_DATA_GROUP_HEADER_SIZE + index * GetEntryLength();
+}
+
+
+
+
+template<typename C>
+MarketDataMessageSubscriber<C>::MarketDataMessageSubscriber(C* _connector)
+{
+	connector = _connector;
+	buffer = vector<char>(MARKET_DATA_SUBSCRIBER_BUFFER_SIZE);
+	length = 0;
+	messageCount = 0;
+	skippedCount = 0;
+}
+
+template<typename C>
+bool MarketDataMessageSubscriber<C>::ProcessReadable(int fd)
+{
+	ssize_t bytes = read(fd, &buffer[length], buffer.size() - length);
+	if (bytes < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	if (bytes == 0)
+	{
+		if (length > 0) skippedCount++;		// truncated last message
+		length = 0;
+		return false;
+	}
+
+	// Subscribe every complete message, and keep the partial message at the front of the buffer
+	int begin = 0;
+	int end = length + bytes;
+	while (end - begin >= MARKET_DATA_HEADER_SIZE)
+	{
+		int messageLength = MarketDataMessageView(&buffer[begin]).GetMessageLength();
+		if (messageLength < MARKET_DATA_HEADER_SIZE)
+		{
+			// A corrupt length leaves no way to find the next message
+			skippedCount++;
+			length = 0;
+			return false;
+		}
+		if (begin + messageLength > end) break;
+		if (!SubscribeMessage(begin, messageLength)) skippedCount++;
+		begin += messageLength;
+	}
+	length = end - begin;
+	if (begin > 0 && length > 0) memmove(&buffer[0], &buffer[begin], length);
+	return true;
+}
+
+template<typename C>
+long MarketDataMessageSubscriber<C>::GetMessageCount() const
+{
+	return messageCount;
+}
+
+template<typename C>
+long MarketDataMessageSubscriber<C>::GetSkippedCount() const
+{
+	return skippedCount;
+}
+
+template<typename C>
+bool MarketDataMessageSubscriber<C>::SubscribeMessage(int offset, int messageLength)
+{
+	const char* message = &buffer[offset];
+	MarketDataMessageView view(message);
+	if (view.GetSchemaId() != MARKET_DATA_SCHEMA_ID) return false;
+
+	if (view.GetTemplateId() == MARKET_DATA_LEVEL_UPDATE && messageLength >= MARKET_DATA_LEVEL_UPDATE_SIZE)
+	{
+		connector->SubscribeLevelUpdate(LevelUpdateView(message));
+		messageCount++;
+		return true;
+	}
+	if (view.GetTemplateId() == MARKET_DATA_BOOK_SNAPSHOT && messageLength >= MARKET_DATA_HEADER_SIZE + MARKET_DATA_SNAPSHOT_BLOCK_SIZE + MARKET_DATA_GROUP_HEADER_SIZE)
+	{
+		BookSnapshotView snapshot(message);
+		int entryLength = snapshot.GetEntryLength();
+		int entriesOffset = MARKET_DATA_HEADER_SIZE + MARKET_DATA_SNAPSHOT_BLOCK_SIZE + MARKET_DATA_GROUP_HEADER_SIZE;
+		if (entryLength < MARKET_DATA_SNAPSHOT_ENTRY_SIZE || entriesOffset + snapshot.GetEntryCount() * entryLength > messageLength) return false;
+		connector->SubscribeBookSnapshot(snapshot);
+		messageCount++;
+		return true;
+	}
+	return false;
+}
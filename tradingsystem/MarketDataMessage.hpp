@@ -0,0 +1,241 @@
+/**
+ * MarketDataMessage.hpp
+ * Defines the fixed-layout binary wire format of market data, with zero-copy views to decode it.
+ *
+ * @author Jordan Wang
+ */
+
+#ifndef MarketDataMessage_hpp
+#define MarketDataMessage_hpp
+#include "EventLoop.hpp"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+using namespace std;
+
+
+
+
+/**
+ * Wire format (little endian, fixed offsets in the style of SBE):
+ *
+ * Message header, 8 bytes
+ *   0  uint16  message length, header included
+ *   2  uint16  template identifier (MARKET_DATA_LEVEL_UPDATE, MARKET_DATA_BOOK_SNAPSHOT or MARKET_DATA_SNAPSHOT_REQUEST)
+ *   4  uint16  schema identifier
+ *   6  uint16  schema version
+ *
+ * Level update, 40 byte block: one order of a book changed
+ *   0  uint64  sequence number of the product
+ *   8  char12  product identifier, null padded
+ *   20 uint8   side (0 BID, 1 OFFER)
+ *   21 uint8   venue (Market, or MARKET_DATA_CONSOLIDATED)
+ *   22 uint8   level in the book side
+ *   24 int64   price in ticks of 1/256
+ *   32 int64   quantity
+ *
+ * Book snapshot, 24 byte block then a repeating group: a whole book
+ *   0  uint64  sequence number of the product
+ *   8  char12  product identifier, null padded
+ *   20 uint8   venue (Market, or MARKET_DATA_CONSOLIDATED)
+ *   24 uint16  group entry length, then uint16 # of entries
+ *   28 entries of 24 bytes: int64 price in ticks of 1/256, int64 quantity, uint8 side
+ *
+ * Snapshot request, 20 byte block, sent back up the feed by a subscriber that detected a sequence gap
+ *   0  uint64  last sequence number of the product applied by the subscriber
+ *   8  char12  product identifier, null padded
+ *
+ * Sequence numbers run per product from 1, so that a subscriber finds a gap in a product as soon as
+ * its next update arrives; the snapshot answering a request carries the sequence number it is as of.
+ */
+const int MARKET_DATA_SCHEMA_ID = 1;
+const int MARKET_DATA_SCHEMA_VERSION = 1;
+const int MARKET_DATA_LEVEL_UPDATE = 1;				// template identifier of level updates
+const int MARKET_DATA_BOOK_SNAPSHOT = 2;			// template identifier of book snapshots
+const int MARKET_DATA_SNAPSHOT_REQUEST = 3;			// template identifier of snapshot requests
+const int MARKET_DATA_HEADER_SIZE = 8;
+const int MARKET_DATA_PRODUCT_ID_LENGTH = 12;
+const int MARKET_DATA_LEVEL_UPDATE_SIZE = MARKET_DATA_HEADER_SIZE + 40;
+const int MARKET_DATA_SNAPSHOT_BLOCK_SIZE = 24;
+const int MARKET_DATA_GROUP_HEADER_SIZE = 4;
+const int MARKET_DATA_SNAPSHOT_ENTRY_SIZE = 24;
+const int MARKET_DATA_SNAPSHOT_REQUEST_SIZE = MARKET_DATA_HEADER_SIZE + 20;
+const int MARKET_DATA_MAX_SIZE = 65535;				// max message size, in bytes
+const int MARKET_DATA_CONSOLIDATED = 255;			// venue of books consolidated across venues
+const int MARKET_DATA_TICKS = 256;					// price ticks per point
+const int MARKET_DATA_SUBSCRIBER_BUFFER_SIZE = 2 * MARKET_DATA_MAX_SIZE;
+
+
+
+
+// Parse a fractional price (e.g. 99-102 or 99-10+) into ticks of 1/256 (-1 if it is malformed)
+long ParseTickPrice(const string& price);
+
+// Encode a level update into a buffer, returning the message size
+int EncodeLevelUpdate(char* buffer, unsigned long sequence, const string& productId, int side, int venue, int level,
+	long price, long quantity);
+
+// Encode the header and block of a book snapshot into a buffer, returning the offset of its first entry
+int EncodeBookSnapshot(char* buffer, unsigned long sequence, const string& productId, int venue, int entryCount);
+
+// Encode an entry of a book snapshot at an offset, returning the offset of the next entry (the message size after the last)
+int EncodeBookSnapshotEntry(char* buffer, int offset, long price, long quantity, int side);
+
+// Encode a snapshot request into a buffer, returning the message size
+int EncodeSnapshotRequest(char* buffer, unsigned long lastSequence, const string& productId);
+
+// Set the sequence number of an encoded level update or book snapshot in place
+void SetMessageSequence(char* buffer, unsigned long sequence);
+
+
+
+
+/**
+ * View over a market data message in a buffer.
+ * The view only holds a pointer: every field is read from its fixed offset when it is asked for, so
+ * decoding copies nothing and costs nothing for the fields left unread. The buffer must outlive the view.
+ */
+class MarketDataMessageView
+{
+
+public:
+	// ctor for a view over a message starting at a pointer
+	MarketDataMessageView(const char* _data);
+
+	// Get the message length, header included
+	int GetMessageLength() const;
+
+	// Get the template identifier
+	int GetTemplateId() const;
+
+	// Get the schema identifier
+	int GetSchemaId() const;
+
+	// Get the schema version
+	int GetVersion() const;
+
+	// Get the sequence number of the product (the last one applied, for a snapshot request)
+	unsigned long GetSequence() const;
+
+	// Get the product identifier
+	string GetProductId() const;
+
+protected:
+	// Read a little endian field at an offset of the message
+	uint64_t ReadField(int offset, int size) const;
+
+	const char* data;					// a pointer to the start of the message
+};
+
+
+
+
+/**
+ * View over a level update.
+ */
+class LevelUpdateView : public MarketDataMessageView
+{
+
+public:
+	// ctor for a view over a message starting at a pointer
+	LevelUpdateView(const char* _data);
+
+	// Get the side (0 BID, 1 OFFER)
+	int GetSide() const;
+
+	// Get the venue (MARKET_DATA_CONSOLIDATED if consolidated)
+	int GetVenue() const;
+
+	// Get the level in the book side
+	int GetLevel() const;
+
+	// Get the price in ticks of 1/256
+	long GetPriceTicks() const;
+
+	// Get the price
+	double GetPrice() const;
+
+	// Get the quantity
+	long GetQuantity() const;
+};
+
+
+
+
+/**
+ * View over a book snapshot.
+ */
+class BookSnapshotView : public MarketDataMessageView
+{
+
+public:
+	// ctor for a view over a message starting at a pointer
+	BookSnapshotView(const char* _data);
+
+	// Get the venue (MARKET_DATA_CONSOLIDATED if consolidated)
+	int GetVenue() const;
+
+	// Get the length of each entry
+	int GetEntryLength() const;
+
+	// Get the # of entries
+	int GetEntryCount() const;
+
+	// Get the side of an entry (0 BID, 1 OFFER)
+	int GetEntrySide(int index) const;
+
+	// Get the price of an entry
+	double GetEntryPrice(int index) const;
+
+	// Get the quantity of an entry
+	long GetEntryQuantity(int index) const;
+
+private:
+	// Get the offset of an entry in the message
+	int GetEntryOffset(int index) const;
+};
+
+
+
+
+/**
+ * Listener reading binary market data messages from a file descriptor into a connector.
+ * Input is read straight into a fixed buffer and each complete message is passed to the connector in
+ * place, as a LevelUpdateView to SubscribeLevelUpdate or a BookSnapshotView to SubscribeBookSnapshot.
+ * Messages of another schema or of an unknown template are skipped over by their length.
+ * Type C is the connector type.
+ */
+template<typename C>
+class MarketDataMessageSubscriber : public EventListener
+{
+
+public:
+	// ctor
+	MarketDataMessageSubscriber(C* _connector);
+
+	// Read what is available and subscribe every complete message, returning false at the end of the input
+	bool ProcessReadable(int fd);
+
+	// Get the # of messages subscribed
+	long GetMessageCount() const;
+
+	// Get the # of messages skipped
+	long GetSkippedCount() const;
+
+private:
+	// Subscribe the message at an offset of the buffer (false if it is skipped)
+	bool SubscribeMessage(int offset, int messageLength);
+
+	C* connector;						// a pointer to the connector subscribing the messages
+	vector<char> buffer;				// bytes read but not yet subscribed
+	int length;							// # of bytes in the buffer
+	long messageCount;					// # of messages subscribed
+	long skippedCount;					// # of messages skipped
+};
+
+
+
+
+#endif
@@ -0,0 +1,211 @@
+/**
+ * MatchingSimulator.cpp
+ * Defines a local matching simulator filling execution orders against an order-level book replayed from a feed.
+ *
+ * @author Jordan Wang
+ */
+
+#include "MatchingSimulator.hpp"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+using namespace std;
+
+
+
+
+template<typename T>
+MatchingSimulator<T>::MatchingSimulator(const T& _product, double _minPrice, double _maxPrice, int _capacity) :
+	product(_product), book(GetTicks(_minPrice), GetTicks(_maxPrice), _capacity)
+{
+	matchingOrder = nullptr;
+	fillCount = 0;
+	filledQuantity = 0;
+}
+
+template<typename T>
+bool MatchingSimulator<T>::OnAdd(long orderId, PricingSide side, double price, long quantity)
+{
+	// An order crossing resting children trades with them first, as it would have on the venue
+	int bookSide = (side == BID) ? 0 : 1;
+	long ticks = GetTicks(price);
+	if (!activeSlots[1 - bookSide].empty()) quantity -= FillAhead(1 - bookSide, ticks, LONG_MAX, quantity);
+	if (quantity <= 0) return true;
+	return book.AddOrder(orderId, bookSide, ticks, quantity);
+}
+
+template<typename T>
+long MatchingSimulator<T>::OnCancel(long orderId, long quantity)
+{
+	return book.CancelOrder(orderId, quantity);
+}
+
+template<typename T>
+long MatchingSimulator<T>::OnExecute(long orderId, long quantity)
+{
+	int side = book.GetOrderSide(orderId);
+	if (side < 0) return 0;
+	if (!activeSlots[side].empty()) FillAhead(side, book.GetOrderPrice(orderId), book.GetOrderPriority(orderId), quantity);
+	return book.ExecuteOrder(orderId, quantity);
+}
+
+template<typename T>
+long MatchingSimulator<T>::SubmitOrder(const ExecutionOrder<T>& order)
+{
+	if (slotIndices.find(order.GetOrderId()) != slotIndices.end()) return 0;
+	long quantity = order.GetVisibleQuantity() + order.GetHiddenQuantity();
+	int side = (order.GetSide() == BID) ? 0 : 1;
+	long limitPrice = (order.GetOrderType() == MARKET) ? 0 : GetTicks(order.GetPrice());
+	if (order.GetOrderType() == FOK && book.GetAvailableQuantity(side, limitPrice) < quantity) return 0;
+
+	matchingOrder = &order;
+	long filled = book.Match(side, limitPrice, quantity, this);
+	matchingOrder = nullptr;
+	if (filled == quantity || order.GetOrderType() != LIMIT) return filled;
+
+	// Rest the rest of a limit order at the back of the queue of its price, on the other side
+	int slot;
+	if (freeSlots.empty())
+	{
+		slot = restingOrders.size();
+		restingOrders.push_back(order);
+		restingStates.push_back(SimulatedOrder());
+	}
+	else
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+		restingOrders[slot] = order;
+	}
+	long bookOrderId = SIMULATED_ORDER_ID_BASE + slot;
+	if (!book.AddOrder(bookOrderId, 1 - side, limitPrice, quantity - filled))
+	{
+		freeSlots.push_back(slot);
+		return filled;
+	}
+	SimulatedOrder& state = restingStates[slot];
+	state.side = 1 - side;
+	state.price = limitPrice;
+	state.priority = book.GetOrderPriority(bookOrderId);
+	state.quantity = quantity - filled;
+	slotIndices[order.GetOrderId()] = slot;
+
+	// Keep the side best price then time first, bids highest first and offers lowest first
+	vector<int>& active = activeSlots[state.side];
+	vector<int>::iterator it = active.begin();
+	while (it != active.end() && (restingStates[*it].price == state.price || (state.side == 0 ? restingStates[*it].price > state.price : restingStates[*it].price < state.price)))
+		it++;
+	active.insert(it, slot);
+	return filled;
+}
+
+template<typename T>
+bool MatchingSimulator<T>::CancelOrder(const string& orderId)
+{
+	unordered_map<string, int>::iterator it = slotIndices.find(orderId);
+	if (it == slotIndices.end()) return false;
+
+	int slot = it->second;
+	SimulatedOrder& state = restingStates[slot];
+	book.CancelOrder(SIMULATED_ORDER_ID_BASE + slot, state.quantity);
+	vector<int>& active = activeSlots[state.side];
+	active.erase(find(active.begin(), active.end(), slot));
+	slotIndices.erase(it);
+	freeSlots.push_back(slot);
+	return true;
+}
+
+template<typename T>
+void MatchingSimulator<T>::AddListener(ServiceListener<ExecutionOrder<T>>* listener)
+{
+	listeners.push_back(listener);
+}
+
+template<typename T>
+const LimitOrderBook& MatchingSimulator<T>::GetBook() const
+{
+	return book;
+}
+
+template<typename T>
+int MatchingSimulator<T>::GetRestingCount() const
+{
+	return slotIndices.size();
+}
+
+template<typename T>
+long MatchingSimulator<T>::GetFillCount() const
+{
+	return fillCount;
+}
+
+template<typename T>
+long MatchingSimulator<T>::GetFilledQuantity() const
+{
+	return filledQuantity;
+}
+
+template<typename T>
+void MatchingSimulator<T>::ProcessFill(long orderId, long price, long quantity)
+{
+	// A child resting on the other side is filled too (the book takes it off after this callback)
+	if (orderId >= SIMULATED_ORDER_ID_BASE) FillResting(orderId - SIMULATED_ORDER_ID_BASE, price, quantity);
+	ReportFill(*matchingOrder, price, quantity);
+}
+
+template<typename T>
+long MatchingSimulator<T>::FillAhead(int side, long price, long priority, long quantity)
+{
+	// The side is kept best first, so only its front can be ahead
+	long used = 0;
+	vector<int>& active = activeSlots[side];
+	while (used < quantity && !active.empty())
+	{
+		int slot = active.front();
+		const SimulatedOrder& state = restingStates[slot];
+		bool betterPrice = (side == 0) ? state.price > price : state.price < price;
+		if (!betterPrice && (state.price != price || state.priority > priority)) break;
+
+		long fill = min(quantity - used, state.quantity);
+		book.CancelOrder(SIMULATED_ORDER_ID_BASE + slot, fill);
+		FillResting(slot, state.price, fill);
+		used += fill;
+	}
+	return used;
+}
+
+template<typename T>
+void MatchingSimulator<T>::FillResting(int slot, long price, long quantity)
+{
+	SimulatedOrder& state = restingStates[slot];
+	state.quantity -= quantity;
+	ReportFill(restingOrders[slot], price, quantity);
+	if (state.quantity > 0) return;
+
+	vector<int>& active = activeSlots[state.side];
+	active.erase(find(active.begin(), active.end(), slot));
+	slotIndices.erase(restingOrders[slot].GetOrderId());
+	freeSlots.push_back(slot);
+}
+
+template<typename T>
+void MatchingSimulator<T>::ReportFill(const ExecutionOrder<T>& order, long price, long quantity)
+{
+	fillCount++;
+	filledQuantity += quantity;
+	ExecutionOrder<T> fill(product, order.GetSide(), order.GetOrderId(), order.GetOrderType(), (double)price / MARKET_DATA_TICKS,
+		quantity, 0, order.GetParentOrderId(), order.IsChildOrder());
+	for (typename vector<ServiceListener<ExecutionOrder<T>>*>::iterator it = listeners.begin(); it != listeners.end(); it++)
+		(*it)->ProcessAdd(fill);
+}
+
+template<typename T>
+long MatchingSimulator<T>::GetTicks(double price) const
+{
+	return llround(price * MARKET_DATA_TICKS);
+}
@@ -0,0 +1,128 @@
+/**
+ * MatchingSimulator.hpp
+ * Defines a local matching simulator filling execution orders against an order-level book replayed from a feed.
+ *
+ * @author Jordan Wang
+ */
+
+#ifndef MatchingSimulator_hpp
+#define MatchingSimulator_hpp
+#include "soa.hpp"
+#include "my functions.hpp"
+#include "BondExecutionService.hpp"
+#include "LimitOrderBook.hpp"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+using namespace std;
+
+
+
+
+const long SIMULATED_ORDER_ID_BASE = 1L << 62;		// book identifier of the resting child of slot 0, clear of the feed's
+
+
+
+
+/**
+ * A child order resting in the book of the simulator.
+ */
+struct SimulatedOrder
+{
+	int side;							// side of the book the order rests on (0 BID, 1 OFFER)
+	long price;							// price in ticks
+	long priority;						// time priority in the book
+	long quantity;						// quantity left
+};
+
+
+
+
+/**
+ * Local matching simulator of one product for backtesting the execution algos.
+ * The book is replayed order by order from an L3 feed through OnAdd, OnCancel and OnExecute.
+ * Child orders sent through SubmitOrder take the liquidity resting in the book, best price then time
+ * first; the rest of a limit order joins the back of the queue of its price in the same book, so it keeps
+ * a real queue position. A resting child fills when the feed executes an order it is ahead of, by price or
+ * by time at the same price, or when the feed adds an order crossing it. Fills are reported to the listeners
+ * as execution orders carrying the fill price and quantity, as ExecutionService reports them.
+ * The replayed orders still trade in full, so the simulation never takes liquidity back out of the replay.
+ * Prices are converted into ticks of 1/MARKET_DATA_TICKS for the book.
+ * Type T is the product type.
+ */
+template<typename T>
+class MatchingSimulator : public BookFillListener
+{
+
+public:
+	// ctor for a book of prices in [minPrice, maxPrice] with room for capacity orders
+	MatchingSimulator(const T& _product, double _minPrice, double _maxPrice, int _capacity);
+
+	// Replay a new order of the feed (false if the book does not take it), filling the resting children it crosses first
+	bool OnAdd(long orderId, PricingSide side, double price, long quantity);
+
+	// Replay a cancel of the feed, returning the quantity cancelled
+	long OnCancel(long orderId, long quantity);
+
+	// Replay an execution of the feed, filling the resting children ahead of the executed order first,
+	// and returning the quantity executed
+	long OnExecute(long orderId, long quantity);
+
+	// Match a child order against the book and rest what is left of a limit order, returning the quantity filled at once
+	// (a FOK order fills in full or not at all, and IOC and market orders never rest)
+	long SubmitOrder(const ExecutionOrder<T>& order);
+
+	// Cancel what is left of a resting child order (false if it is not resting)
+	bool CancelOrder(const string& orderId);
+
+	// Add a listener to the fills of the child orders
+	void AddListener(ServiceListener<ExecutionOrder<T>>* listener);
+
+	// Get the book
+	const LimitOrderBook& GetBook() const;
+
+	// Get the # of resting child orders
+	int GetRestingCount() const;
+
+	// Get the # of fills reported
+	long GetFillCount() const;
+
+	// Get the total quantity filled on the child orders
+	long GetFilledQuantity() const;
+
+	// Callback of the book for each resting order the matched child fills
+	void ProcessFill(long orderId, long price, long quantity);
+
+private:
+	// Fill the resting children of a side ahead of a price and time priority with quantity traded there,
+	// returning the quantity used
+	long FillAhead(int side, long price, long priority, long quantity);
+
+	// Record the fill of a resting child, and drop it once it is done
+	void FillResting(int slot, long price, long quantity);
+
+	// Report a fill of a child order to the listeners
+	void ReportFill(const ExecutionOrder<T>& order, long price, long quantity);
+
+	// Convert a price into ticks
+	long GetTicks(double price) const;
+
+	T product;												// product of the book
+	LimitOrderBook book;									// book of the replayed and resting child orders
+	vector<ServiceListener<ExecutionOrder<T>>*> listeners;	// listeners to the fills
+	vector<ExecutionOrder<T>> restingOrders;				// resting child order of each slot
+	vector<SimulatedOrder> restingStates;					// book state of the resting child of each slot
+	vector<int> freeSlots;									// slots free for reuse
+	unordered_map<string, int> slotIndices;					// a map of {child order identifier -> slot}
+	vector<int> activeSlots[2];								// slots resting on each side, best price then time first
+	const ExecutionOrder<T>* matchingOrder;					// child order being matched against the book
+	long fillCount;											// # of fills reported
+	long filledQuantity;									// total quantity filled
+};
+
+
+
+
+#endif
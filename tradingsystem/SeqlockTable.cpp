@@ -0,0 +1,115 @@
+/**
+ * SeqlockTable.cpp
+ * Defines a table of per-product records read from any thread through seqlocks.
+ *
+ * @author Jordan Wang
+ */
+
+#include "SeqlockTable.hpp"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstring>
+#include <unordered_map>
+using namespace std;
+
+
+
+
+template<typename R>
+SeqlockTable<R>::SeqlockTable(int _capacity) :
+	capacity(_capacity), slots(new Slot[_capacity]), count(0)
+{
+	for (int i = 0; i < capacity; i++)
+	{
+		slots[i].sequence.store(0, memory_order_relaxed);
+		slots[i].key[0] = '\0';
+		for (int j = 0; j < WORDS; j++)
+			slots[i].words[j].store(0, memory_order_relaxed);
+	}
+}
+
+template<typename R>
+int SeqlockTable<R>::GetCapacity() const
+{
+	return capacity;
+}
+
+template<typename R>
+int SeqlockTable<R>::GetCount() const
+{
+	return count.load(memory_order_acquire);
+}
+
+template<typename R>
+int SeqlockTable<R>::Find(const string &key) const
+{
+	int n = GetCount();
+	for (int i = 0; i < n; i++)
+	{
+		if (strncmp(slots[i].key, key.c_str(), SEQLOCK_KEY_LENGTH) == 0) return i;
+	}
+	return -1;
+}
+
+template<typename R>
+bool SeqlockTable<R>::Write(const string &key, const R &record)
+{
+	int index;
+	typename unordered_map<string, int>::iterator it = indices.find(key);
+	if (it != indices.end()) index = it->second;
+	else
+	{
+		// Claim the next slot, and count it once the key is in place
+		index = count.load(memory_order_relaxed);
+		if (index >= capacity || (int)key.size() >= SEQLOCK_KEY_LENGTH) return false;
+		memcpy(slots[index].key, key.c_str(), key.size() + 1);		// fits, terminator included
+		count.store(index + 1, memory_order_release);
+		indices[key] = index;
+	}
+
+	uint64_t buffer[WORDS] = {};
+	memcpy(buffer, &record, sizeof(R));
+
+	Slot& slot = slots[index];
+	uint64_t sequence = slot.sequence.load(memory_order_relaxed);
+	slot.sequence.store(sequence + 1, memory_order_relaxed);		// odd: write in progress
+	atomic_thread_fence(memory_order_release);
+	for (int i = 0; i < WORDS; i++)
+		slot.words[i].store(buffer[i], memory_order_relaxed);
+	slot.sequence.store(sequence + 2, memory_order_release);		// even: write done
+	return true;
+}
+
+template<typename R>
+bool SeqlockTable<R>::Read(int index, R &record) const
+{
+	if (index < 0 || index >= GetCount()) return false;
+
+	const Slot& slot = slots[index];
+	uint64_t buffer[WORDS];
+	while (true)
+	{
+		uint64_t before = slot.sequence.load(memory_order_acquire);
+		if (before & 1) continue;		// writer in the slot
+
+		for (int i = 0; i < WORDS; i++)
+			buffer[i] = slot.words[i].load(memory_order_relaxed);
+		atomic_thread_fence(memory_order_acquire);
+
+		if (slot.sequence.load(memory_order_relaxed) == before)
+		{
+			if (before == 0) return false;		// a slot counted but never written has no record yet
+			memcpy(&record, buffer, sizeof(R));
+			return true;
+		}
+	}
+}
+
+template<typename R>
+bool SeqlockTable<R>::Read(const string &key, R &record) const
+{
+	return Read(Find(key), record);
+}
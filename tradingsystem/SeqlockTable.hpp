@@ -0,0 +1,83 @@
+/**
+ * SeqlockTable.hpp
+ * Defines a table of per-product records read from any thread through seqlocks.
+ *
+ * @author Jordan Wang
+ */
+
+#ifndef SeqlockTable_hpp
+#define SeqlockTable_hpp
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include <unordered_map>
+using namespace std;
+
+
+
+
+const int SEQLOCK_KEY_LENGTH = 16;			// max key length (with the null)
+
+
+
+
+/**
+ * Table of the latest record of each key, written by one thread and read by any # of threads.
+ * Slots are allocated once and never move. A key is given the next slot on its first write, and the
+ * slot is counted only once the key is in place, so readers find keys without locks.
+ * Each slot is guarded by a seqlock: the writer makes the sequence odd, stores the record and makes it
+ * even again, and a reader retries whenever the sequence was odd or changed while it was copying.
+ * The record is copied through 64 bit atomic words, so it must be trivially copyable.
+ * Type R is the record type.
+ */
+template<typename R>
+class SeqlockTable
+{
+	static_assert(is_trivially_copyable<R>::value, "seqlock records must be trivially copyable");
+
+public:
+	// ctor for a table with room for a # of keys
+	SeqlockTable(int _capacity);
+
+	// Get the # of keys the table has room for
+	int GetCapacity() const;
+
+	// Get the # of keys in the table
+	int GetCount() const;
+
+	// Find the slot of a key (-1 if it is not in the table); readers may cache it
+	int Find(const string &key) const;
+
+	// Write the latest record of a key (writer thread only; false if the table is full or the key too long)
+	bool Write(const string &key, const R &record);
+
+	// Copy the record of a slot consistently (false if the slot is not in use)
+	bool Read(int index, R &record) const;
+
+	// Copy the record of a key consistently (false if the key is not in the table)
+	bool Read(const string &key, R &record) const;
+
+private:
+	static const int WORDS = (sizeof(R) + 7) / 8;		// # of 64 bit words per record
+
+	struct alignas(64) Slot
+	{
+		atomic<uint64_t> sequence;					// seqlock sequence (odd while the writer is in the slot)
+		char key[SEQLOCK_KEY_LENGTH];				// key of the slot
+		atomic<uint64_t> words[WORDS];				// record
+	};
+
+	int capacity;
+	unique_ptr<Slot[]> slots;
+	atomic<int> count;								// # of slots in use
+	unordered_map<string, int> indices;				// a map of {key -> slot}, writer thread only
+};
+
+
+
+
+#endif
@@ -0,0 +1,177 @@
+/**
+ * SharedPriceTable.cpp
+ * Defines a table of the latest prices in POSIX shared memory, read by GUI and monitor processes.
+ *
+ * @author Jordan Wang
+ */
+
+#include "SharedPriceTable.hpp"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+using namespace std;
+
+static_assert(atomic<uint64_t>::is_always_lock_free, "shared slots need lock free 64 bit atomics");
+static_assert(atomic<double>::is_always_lock_free, "shared slots need lock free double atomics");
+
+
+
+
+SharedPriceWriter::SharedPriceWriter(const string &_name, int _capacity) :
+	name(_name), size(sizeof(SharedPriceHeader) + _capacity * sizeof(SharedPriceSlot)), header(nullptr), slots(nullptr)
+{
+	int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+	if (fd < 0)
+	{
+		cout << "Cannot create shared memory " << name << endl;
+		return;
+	}
+
+	void* address = MAP_FAILED;
+	if (ftruncate(fd, size) == 0) address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);		// the mapping stays valid
+	if (address == MAP_FAILED)
+	{
+		cout << "Cannot map shared memory " << name << endl;
+		return;
+	}
+
+	// Lay out an empty table, and only then mark it initialized for the readers
+	header = new (address) SharedPriceHeader();
+	slots = reinterpret_cast<SharedPriceSlot*>(header + 1);
+	for (int i = 0; i < _capacity; i++) new (slots + i) SharedPriceSlot();
+	header->capacity = _capacity;
+	header->count.store(0, memory_order_relaxed);
+	header->magic.store(SHARED_PRICE_MAGIC, memory_order_release);
+}
+
+SharedPriceWriter::~SharedPriceWriter()
+{
+	if (header == nullptr) return;
+	munmap(header, size);
+	shm_unlink(name.c_str());
+}
+
+const string& SharedPriceWriter::GetName() const
+{
+	return name;
+}
+
+bool SharedPriceWriter::Publish(const string &productId, double mid, double bidOfferSpread)
+{
+	if (header == nullptr) return false;
+
+	int index;
+	unordered_map<string, int>::iterator it = slotIndices.find(productId);
+	if (it != slotIndices.end()) index = it->second;
+	else
+	{
+		// Claim the next slot, and count it once the identifier is in place
+		index = header->count.load(memory_order_relaxed);
+		if (index >= header->capacity) return false;
+		strncpy(slots[index].productId, productId.c_str(), SHARED_PRICE_ID_LENGTH - 1);
+		slots[index].productId[SHARED_PRICE_ID_LENGTH - 1] = '\0';
+		header->count.store(index + 1, memory_order_release);
+		slotIndices[productId] = index;
+	}
+
+	SharedPriceSlot& slot = slots[index];
+	int64_t timestamp = chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+	uint64_t sequence = slot.sequence.load(memory_order_relaxed);
+	slot.sequence.store(sequence + 1, memory_order_relaxed);		// odd: write in progress
+	atomic_thread_fence(memory_order_release);
+	slot.mid.store(mid, memory_order_relaxed);
+	slot.bidOfferSpread.store(bidOfferSpread, memory_order_relaxed);
+	slot.timestamp.store(timestamp, memory_order_relaxed);
+	slot.sequence.store(sequence + 2, memory_order_release);		// even: write done
+	return true;
+}
+
+
+
+
+SharedPriceReader::SharedPriceReader(const string &_name) :
+	size(0), header(nullptr), slots(nullptr)
+{
+	int fd = shm_open(_name.c_str(), O_RDONLY, 0);
+	if (fd < 0) return;
+
+	struct stat status;
+	void* address = MAP_FAILED;
+	if (fstat(fd, &status) == 0 && status.st_size >= (off_t)sizeof(SharedPriceHeader))
+	{
+		size = status.st_size;
+		address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	if (address == MAP_FAILED) return;
+
+	header = static_cast<const SharedPriceHeader*>(address);
+	if (header->magic.load(memory_order_acquire) != SHARED_PRICE_MAGIC || size < sizeof(SharedPriceHeader) + header->capacity * sizeof(SharedPriceSlot))
+	{
+		munmap(const_cast<SharedPriceHeader*>(header), size);
+		header = nullptr;
+		return;
+	}
+	slots = reinterpret_cast<const SharedPriceSlot*>(header + 1);
+}
+
+SharedPriceReader::~SharedPriceReader()
+{
+	if (header != nullptr) munmap(const_cast<SharedPriceHeader*>(header), size);
+}
+
+bool SharedPriceReader::IsOpen() const
+{
+	return header != nullptr;
+}
+
+int SharedPriceReader::GetCount() const
+{
+	return header == nullptr ? 0 : header->count.load(memory_order_acquire);
+}
+
+bool SharedPriceReader::Read(int index, PriceSnapshot &snapshot) const
+{
+	if (index < 0 || index >= GetCount()) return false;
+
+	const SharedPriceSlot& slot = slots[index];
+	snapshot.productId = slot.productId;
+	while (true)
+	{
+		uint64_t before = slot.sequence.load(memory_order_acquire);
+		if (before & 1) continue;		// writer in the slot
+
+		snapshot.mid = slot.mid.load(memory_order_relaxed);
+		snapshot.bidOfferSpread = slot.bidOfferSpread.load(memory_order_relaxed);
+		snapshot.timestamp = slot.timestamp.load(memory_order_relaxed);
+		atomic_thread_fence(memory_order_acquire);
+
+		if (slot.sequence.load(memory_order_relaxed) == before)
+		{
+			snapshot.sequence = before;
+			return before != 0;			// a slot counted but never written has no price yet
+		}
+	}
+}
+
+vector<PriceSnapshot> SharedPriceReader::ReadAll() const
+{
+	vector<PriceSnapshot> res;
+	int count = GetCount();
+	PriceSnapshot snapshot;
+	for (int i = 0; i < count; i++)
+	{
+		if (Read(i, snapshot)) res.push_back(snapshot);		// Append slot i
+	}
+	return res;
+}
@@ -0,0 +1,147 @@
+/**
+ * SharedPriceTable.hpp
+ * Defines a table of the latest prices in POSIX shared memory, read by GUI and monitor processes.
+ *
+ * @author Jordan Wang
+ */
+
+#ifndef SharedPriceTable_hpp
+#define SharedPriceTable_hpp
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+using namespace std;
+
+
+
+
+const uint64_t SHARED_PRICE_MAGIC = 0x5052494345544231ULL;	// "PRICETB1"
+const int SHARED_PRICE_ID_LENGTH = 16;						// max product identifier length (with the null)
+
+
+
+
+/**
+ * One product slot in the shared table, on its own cache line.
+ * The slot is guarded by a seqlock: the writer makes the sequence odd, writes the fields and makes it even again,
+ * and a reader retries whenever the sequence was odd or changed while it was copying the fields.
+ * The product identifier is written once, before the slot is counted in the header.
+ */
+struct alignas(64) SharedPriceSlot
+{
+	atomic<uint64_t> sequence;					// seqlock sequence (odd while the writer is in the slot)
+	char productId[SHARED_PRICE_ID_LENGTH];		// product identifier
+	atomic<double> mid;							// mid price
+	atomic<double> bidOfferSpread;				// bid/offer spread
+	atomic<int64_t> timestamp;					// time of the update in nanoseconds since epoch
+};
+
+
+
+
+/**
+ * Header of the shared table, followed by the slots.
+ */
+struct alignas(64) SharedPriceHeader
+{
+	atomic<uint64_t> magic;						// SHARED_PRICE_MAGIC once the table is initialized
+	int32_t capacity;							// # of slots
+	atomic<int32_t> count;						// # of slots in use
+};
+
+
+
+
+/**
+ * Consistent copy of one slot.
+ */
+struct PriceSnapshot
+{
+	string productId;
+	double mid;
+	double bidOfferSpread;
+	int64_t timestamp;
+	uint64_t sequence;							// sequence of the copy (grows by 2 per update)
+};
+
+
+
+
+/**
+ * Writer side of the shared table, owned by the trading process.
+ * Creates the shm segment and updates a product slot with plain stores, so publishing costs no syscall
+ * and never waits on the readers.
+ */
+class SharedPriceWriter
+{
+
+public:
+	// ctor creating a shm segment (e.g. "/gui_prices") with room for a # of products
+	SharedPriceWriter(const string &_name, int _capacity);
+
+	// dtor unmapping and unlinking the segment
+	~SharedPriceWriter();
+
+	// Get the name of the segment
+	const string& GetName() const;
+
+	// Write the latest price of a product (false if the table is full or the segment is not mapped)
+	bool Publish(const string &productId, double mid, double bidOfferSpread);
+
+private:
+	SharedPriceWriter(const SharedPriceWriter&) = delete;
+	SharedPriceWriter& operator=(const SharedPriceWriter&) = delete;
+
+	string name;
+	size_t size;								// size of the mapping in bytes
+	SharedPriceHeader* header;					// mapped header (nullptr if shm_open failed)
+	SharedPriceSlot* slots;						// mapped slots
+	unordered_map<string, int> slotIndices;		// a map of {product identifier -> slot}
+};
+
+
+
+
+/**
+ * Reader side of the shared table, for any process on the box.
+ * Maps the segment read-only and copies slots without locks or syscalls.
+ */
+class SharedPriceReader
+{
+
+public:
+	// ctor opening an existing shm segment
+	SharedPriceReader(const string &_name);
+
+	// dtor unmapping the segment
+	~SharedPriceReader();
+
+	// Whether the segment is mapped and initialized
+	bool IsOpen() const;
+
+	// Get the # of products in the table
+	int GetCount() const;
+
+	// Copy one slot consistently (false if the slot is not in use)
+	bool Read(int index, PriceSnapshot &snapshot) const;
+
+	// Copy every slot in use
+	vector<PriceSnapshot> ReadAll() const;
+
+private:
+	SharedPriceReader(const SharedPriceReader&) = delete;
+	SharedPriceReader& operator=(const SharedPriceReader&) = delete;
+
+	size_t size;								// size of the mapping in bytes
+	const SharedPriceHeader* header;			// mapped header (nullptr if the segment is not there)
+	const SharedPriceSlot* slots;				// mapped slots
+};
+
+
+
+
+#endif
@@ -0,0 +1,204 @@
+/**
+ * SocketConnector.cpp
+ * Defines the sockets and binary framing of live feeds subscribed on the event loop.
+ *
+ * @author Jordan Wang
+ */
+
+#include "SocketConnector.hpp"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+using namespace std;
+
+
+
+
+int ListenUnixSocket(const string& path)
+{
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) return -1;
+	strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) return -1;
+	unlink(path.c_str());
+	if (bind(fd, (sockaddr*)&address, sizeof(address)) < 0 || listen(fd, 16) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int ConnectUnixSocket(const string& path)
+{
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) return -1;
+	strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) return -1;
+	if (connect(fd, (sockaddr*)&address, sizeof(address)) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int ListenLoopback(int port)
+{
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) return -1;
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if (bind(fd, (sockaddr*)&address, sizeof(address)) < 0 || listen(fd, 16) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int ConnectLoopback(int port)
+{
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) return -1;
+	if (connect(fd, (sockaddr*)&address, sizeof(address)) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+	int on = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	return fd;
+}
+
+int AcceptConnection(int listenFd)
+{
+	int fd;
+	do fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+	while (fd < 0 && errno == EINTR);
+	return fd;
+}
+
+int EncodeDataFrame(const vector<string>& words, char* frame)
+{
+	if (words.size() > 255) return -1;
+
+	int size = DATA_FRAME_HEADER_SIZE;
+	frame[size++] = (char)words.size();
+	for (vector<string>::const_iterator it = words.begin(); it != words.end(); it++)
+	{
+		if (it->size() > 255 || size + 1 + (int)it->size() > DATA_FRAME_MAX_SIZE) return -1;
+		frame[size++] = (char)it->size();
+		memcpy(frame + size, it->data(), it->size());
+		size += it->size();
+	}
+
+	int payloadLength = size - DATA_FRAME_HEADER_SIZE;
+	frame[0] = (char)(payloadLength & 0xFF);
+	frame[1] = (char)(payloadLength >> 8);
+	return size;
+}
+
+
+
+
+template<typename C>
+FrameSubscriber<C>::FrameSubscriber(C* _connector)
+{
+	connector = _connector;
+	buffer = vector<char>(FRAME_SUBSCRIBER_BUFFER_SIZE);
+	length = 0;
+	frameCount = 0;
+	errorCount = 0;
+}
+
+template<typename C>
+bool FrameSubscriber<C>::ProcessReadable(int fd)
+{
+	ssize_t bytes = read(fd, &buffer[length], buffer.size() - length);
+	if (bytes < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	if (bytes == 0)
+	{
+		if (length > 0) errorCount++;		// truncated last frame
+		length = 0;
+		return false;
+	}
+
+	// Subscribe every complete frame, and keep the partial frame at the front of the buffer
+	const unsigned char* data = (const unsigned char*)&buffer[0];
+	int begin = 0;
+	int end = length + bytes;
+	while (end - begin >= DATA_FRAME_HEADER_SIZE)
+	{
+		int payloadLength = data[begin] | (data[begin + 1] << 8);
+		int frameEnd = begin + DATA_FRAME_HEADER_SIZE + payloadLength;
+		if (frameEnd > end) break;
+		if (!SubscribeFrame(begin + DATA_FRAME_HEADER_SIZE, frameEnd)) errorCount++;
+		begin = frameEnd;
+	}
+	length = end - begin;
+	if (begin > 0 && length > 0) memmove(&buffer[0], &buffer[begin], length);
+	return true;
+}
+
+template<typename C>
+long FrameSubscriber<C>::GetFrameCount() const
+{
+	return frameCount;
+}
+
+template<typename C>
+long FrameSubscriber<C>::GetErrorCount() const
+{
+	return errorCount;
+}
+
+template<typename C>
+bool FrameSubscriber<C>::SubscribeFrame(int begin, int end)
+{
+	const unsigned char* data = (const unsigned char*)&buffer[0];
+	if (begin >= end) return false;
+
+	int wordCount = data[begin++];
+	if ((int)words.size() < wordCount) words.resize(wordCount);
+	for (int i = 0; i < wordCount; i++)
+	{
+		if (begin >= end) return false;
+		int wordLength = data[begin++];
+		if (begin + wordLength > end) return false;
+		words[i].assign(&buffer[begin], wordLength);
+		begin += wordLength;
+	}
+	if (wordCount == 0 || begin != end) return false;
+
+	// The words past this frame's are kept for longer frames to come
+	connector->SubscribeLine(words, wordCount);
+	frameCount++;
+	return true;
+}
@@ -0,0 +1,90 @@
+/**
+ * SocketConnector.hpp
+ * Defines the sockets and binary framing of live feeds subscribed on the event loop.
+ *
+ * @author Jordan Wang
+ */
+
+#ifndef SocketConnector_hpp
+#define SocketConnector_hpp
+#include "EventLoop.hpp"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+
+
+
+const int DATA_FRAME_HEADER_SIZE = 2;							// frame length prefix, in bytes
+const int DATA_FRAME_MAX_SIZE = DATA_FRAME_HEADER_SIZE + 65535;	// max frame size, in bytes
+const int FRAME_SUBSCRIBER_BUFFER_SIZE = 2 * DATA_FRAME_MAX_SIZE;
+
+
+
+
+// Listen on a Unix domain socket path, replacing a stale socket file (-1 on failure)
+int ListenUnixSocket(const string& path);
+
+// Connect to a Unix domain socket path (-1 on failure)
+int ConnectUnixSocket(const string& path);
+
+// Listen on a TCP port of the loopback interface (-1 on failure)
+int ListenLoopback(int port);
+
+// Connect to a TCP port of the loopback interface, with Nagle off (-1 on failure)
+int ConnectLoopback(int port);
+
+// Accept a connection on a listening socket, blocking until one comes (-1 on failure)
+int AcceptConnection(int listenFd);
+
+// Encode the words of a line of data as a binary frame, returning the frame size (-1 if a word or the frame is too long)
+// Frame: [uint16 payload length][uint8 word count] then [uint8 word length][word bytes] per word, little endian
+int EncodeDataFrame(const vector<string>& words, char* frame);
+
+
+
+
+/**
+ * Listener reading binary frames of data from a file descriptor into a connector.
+ * This is the length-prefixed variant of the line formats: each frame carries the words of one line, each
+ * word prefixed by its length, so that no byte has to be scanned for delimiters or blanks.
+ * Input is read straight into a fixed buffer, frames are decoded where they were received into a reused
+ * word vector passed to the connector's SubscribeLine with the frame's word count, and a partial frame waits
+ * for the rest of its bytes.
+ * Type C is the connector type.
+ */
+template<typename C>
+class FrameSubscriber : public EventListener
+{
+
+public:
+	// ctor
+	FrameSubscriber(C* _connector);
+
+	// Read what is available and subscribe every complete frame, returning false at the end of the input
+	bool ProcessReadable(int fd);
+
+	// Get the # of frames subscribed
+	long GetFrameCount() const;
+
+	// Get the # of malformed frames skipped
+	long GetErrorCount() const;
+
+private:
+	// Subscribe the frame payload of [begin, end) in the buffer (false if it is malformed)
+	bool SubscribeFrame(int begin, int end);
+
+	C* connector;						// a pointer to the connector subscribing the frames
+	vector<char> buffer;				// bytes read but not yet subscribed
+	vector<string> words;				// words of the frame being subscribed, reused across frames
+	int length;							// # of bytes in the buffer
+	long frameCount;					// # of frames subscribed
+	long errorCount;					// # of malformed frames skipped
+};
+
+
+
+
+#endif
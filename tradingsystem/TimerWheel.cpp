@@ -0,0 +1,203 @@
+/**
+ * TimerWheel.cpp
+ * Defines a hierarchical timer wheel scheduling callbacks in time.
+ *
+ * @author Jordan Wang
+ */
+
+#include "TimerWheel.hpp"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+using namespace std;
+
+
+
+
+TimerWheel::TimerWheel(long _tickDuration, int _capacity, long _startTime) :
+	nodes(_capacity), heads(TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS, -1), freeHead(_capacity > 0 ? 0 : -1),
+	tickDuration(_tickDuration), currentTick(_startTime / _tickDuration), pendingCount(0)
+{
+	dueTimers.reserve(_capacity);
+	for (int level = 0; level < TIMER_WHEEL_LEVELS; level++)
+		levelCounts[level] = 0;
+	for (int i = 0; i < _capacity; i++)
+	{
+		nodes[i].next = (i + 1 < _capacity) ? i + 1 : -1;
+		nodes[i].slot = FREE;
+		nodes[i].generation = 0;
+	}
+}
+
+long TimerWheel::Schedule(long expiryTime, TimerListener* listener, long data)
+{
+	if (freeHead < 0) return -1;
+
+	int index = freeHead;
+	freeHead = nodes[index].next;
+
+	// Round up to the next tick, and never schedule into a tick already processed
+	long expiryTick = (expiryTime + tickDuration - 1) / tickDuration;
+	if (expiryTick <= currentTick) expiryTick = currentTick + 1;
+
+	TimerNode& node = nodes[index];
+	node.expiryTick = expiryTick;
+	node.listener = listener;
+	node.data = data;
+	Link(index, GetSlot(expiryTick));
+	pendingCount++;
+	return ((long)node.generation << 32) | index;
+}
+
+bool TimerWheel::Cancel(long timerId)
+{
+	if (timerId < 0) return false;
+	int index = timerId & 0xFFFFFFFF;
+	int generation = (timerId >> 32) & 0x7FFFFFFF;
+	if (index >= (int)nodes.size() || nodes[index].generation != generation || nodes[index].slot == FREE) return false;
+
+	if (nodes[index].slot != FIRING) Unlink(index);
+	Release(index);
+	return true;
+}
+
+int TimerWheel::Advance(long now)
+{
+	int fired = 0;
+	long targetTick = now / tickDuration;
+	while (currentTick < targetTick)
+	{
+		// Skip to the last tick before the next cascade of the lowest wheel holding timers, as nothing fires until then
+		int lowest = 0;
+		while (lowest < TIMER_WHEEL_LEVELS && levelCounts[lowest] == 0)
+			lowest++;
+		if (lowest == TIMER_WHEEL_LEVELS)
+		{
+			currentTick = targetTick;		// nothing to fire on the way
+			break;
+		}
+		if (lowest > 0)
+		{
+			currentTick = min(currentTick | ((1L << (TIMER_WHEEL_SLOT_BITS * lowest)) - 1), targetTick);
+			if (currentTick == targetTick) break;
+		}
+		currentTick++;
+
+		// Cascade the upper wheels whose lower wheel has turned round, the highest first
+		int level = 0;
+		while (level + 1 < TIMER_WHEEL_LEVELS && ((currentTick >> (TIMER_WHEEL_SLOT_BITS * level)) & (TIMER_WHEEL_SLOTS - 1)) == 0)
+			level++;
+		for (; level > 0; level--)
+			Cascade(level);
+
+		// Take the due timers out of the slot first, so that callbacks may schedule and cancel freely
+		dueTimers.clear();
+		int index = heads[currentTick & (TIMER_WHEEL_SLOTS - 1)];
+		while (index >= 0)
+		{
+			int next = nodes[index].next;
+			if (nodes[index].expiryTick <= currentTick)
+			{
+				Unlink(index);
+				nodes[index].slot = FIRING;
+				dueTimers.push_back(index);
+			}
+			index = next;
+		}
+
+		for (vector<int>::iterator it = dueTimers.begin(); it != dueTimers.end(); it++)
+		{
+			if (nodes[*it].slot != FIRING) continue;		// cancelled by an earlier callback
+			TimerListener* listener = nodes[*it].listener;
+			long data = nodes[*it].data;
+			Release(*it);
+			listener->ProcessTimeout(data);
+			fired++;
+		}
+	}
+	return fired;
+}
+
+long TimerWheel::GetTime() const
+{
+	return currentTick * tickDuration;
+}
+
+long TimerWheel::GetNextExpiry() const
+{
+	if (pendingCount == 0) return -1;
+
+	// The next busy slot of wheel 0 until it turns round, else the next cascade
+	long tick = currentTick + 1;
+	for (; (tick & (TIMER_WHEEL_SLOTS - 1)) != 0; tick++)
+	{
+		if (heads[tick & (TIMER_WHEEL_SLOTS - 1)] >= 0) return tick * tickDuration;
+	}
+	return tick * tickDuration;
+}
+
+int TimerWheel::GetPendingCount() const
+{
+	return pendingCount;
+}
+
+int TimerWheel::GetCapacity() const
+{
+	return nodes.size();
+}
+
+int TimerWheel::GetSlot(long expiryTick) const
+{
+	// The lowest wheel whose range covers the timer; timers beyond the top wheel wait in it and cascade again
+	long delta = expiryTick - currentTick;
+	int level = 0;
+	while (level + 1 < TIMER_WHEEL_LEVELS && delta >= (1L << (TIMER_WHEEL_SLOT_BITS * (level + 1))))
+		level++;
+	return level * TIMER_WHEEL_SLOTS + ((expiryTick >> (TIMER_WHEEL_SLOT_BITS * level)) & (TIMER_WHEEL_SLOTS - 1));
+}
+
+void TimerWheel::Cascade(int level)
+{
+	int slot = level * TIMER_WHEEL_SLOTS + ((currentTick >> (TIMER_WHEEL_SLOT_BITS * level)) & (TIMER_WHEEL_SLOTS - 1));
+	int index = heads[slot];
+	heads[slot] = -1;
+	while (index >= 0)
+	{
+		int next = nodes[index].next;
+		levelCounts[level]--;
+		Link(index, GetSlot(nodes[index].expiryTick));
+		index = next;
+	}
+}
+
+void TimerWheel::Link(int index, int slot)
+{
+	TimerNode& node = nodes[index];
+	node.slot = slot;
+	node.previous = -1;
+	node.next = heads[slot];
+	if (node.next >= 0) nodes[node.next].previous = index;
+	heads[slot] = index;
+	levelCounts[slot >> TIMER_WHEEL_SLOT_BITS]++;
+}
+
+void TimerWheel::Unlink(int index)
+{
+	TimerNode& node = nodes[index];
+	if (node.previous >= 0) nodes[node.previous].next = node.next;
+	else heads[node.slot] = node.next;
+	if (node.next >= 0) nodes[node.next].previous = node.previous;
+	levelCounts[node.slot >> TIMER_WHEEL_SLOT_BITS]--;
+}
+
+void TimerWheel::Release(int index)
+{
+	TimerNode& node = nodes[index];
+	node.slot = FREE;
+	node.generation = (node.generation + 1) & 0x7FFFFFFF;
+	node.next = freeHead;
+	freeHead = index;
+	pendingCount--;
+}
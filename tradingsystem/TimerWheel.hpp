@@ -0,0 +1,124 @@
+/**
+ * TimerWheel.hpp
+ * Defines a hierarchical timer wheel scheduling callbacks in time.
+ *
+ * @author Jordan Wang
+ */
+
+#ifndef TimerWheel_hpp
+#define TimerWheel_hpp
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+
+
+
+const int TIMER_WHEEL_LEVELS = 4;						// # of wheels
+const int TIMER_WHEEL_SLOT_BITS = 8;					// log2 of the # of slots per wheel
+const int TIMER_WHEEL_SLOTS = 1 << TIMER_WHEEL_SLOT_BITS;
+
+
+
+
+/**
+ * Callback of a timer.
+ */
+class TimerListener
+{
+
+public:
+	// dtor
+	virtual ~TimerListener() = default;
+
+	// Callback when a timer expires, with the data it was scheduled with
+	virtual void ProcessTimeout(long data) = 0;
+};
+
+
+
+
+/**
+ * Hierarchical timer wheel with timers in a preallocated pool, shared by the time-driven services.
+ * Time is cut into ticks. Wheel 0 holds the timers due in the next 256 ticks, one slot per tick;
+ * wheel 1 holds those due in the next 256^2 ticks, one slot per 256 ticks, and so on. Each time a lower
+ * wheel turns round, the next slot of the wheel above is cascaded down, so a timer moves at most
+ * TIMER_WHEEL_LEVELS times before it fires. Scheduling and cancelling are O(1), advancing one tick
+ * only walks the timers due on that tick, and stretches of ticks with nothing due are skipped whole.
+ * Timers are linked by index in a pool allocated once, so scheduling a timer never allocates.
+ * The wheel is driven by its owner's clock through Advance; times are in milliseconds.
+ */
+class TimerWheel
+{
+
+public:
+	// ctor for a wheel of tickDuration ms ticks with room for capacity timers, starting at a time
+	TimerWheel(long _tickDuration, int _capacity, long _startTime);
+
+	// Schedule a callback at an expiry time, returning the timer identifier (-1 if the pool is full)
+	long Schedule(long expiryTime, TimerListener* listener, long data);
+
+	// Cancel a pending timer (false if it has already fired or been cancelled)
+	bool Cancel(long timerId);
+
+	// Advance the wheel to a time, firing every timer due by then in expiry tick order
+	int Advance(long now);
+
+	// Get the time the wheel has been advanced to
+	long GetTime() const;
+
+	// Get the earliest time the wheel has work to do, to wake its driver up (-1 if no timer is pending)
+	long GetNextExpiry() const;
+
+	// Get the # of pending timers
+	int GetPendingCount() const;
+
+	// Get the # of timers the pool has room for
+	int GetCapacity() const;
+
+private:
+	// Get the slot of a timer due at a tick, off the current tick
+	int GetSlot(long expiryTick) const;
+
+	// Move the timers of a slot of an upper wheel down to the lower wheels
+	void Cascade(int level);
+
+	// Link a timer at the head of the list of a slot
+	void Link(int index, int slot);
+
+	// Unlink a timer from the list of its slot
+	void Unlink(int index);
+
+	// Return a timer to the pool
+	void Release(int index);
+
+	struct TimerNode
+	{
+		long expiryTick;				// tick the timer is due at
+		TimerListener* listener;		// callback
+		long data;						// data passed back to the callback
+		int previous;					// previous timer in the slot (-1 at the head)
+		int next;						// next timer in the slot, or in the free list (-1 at the tail)
+		int slot;						// slot of the timer (FREE or FIRING when not in a slot)
+		int generation;					// bumped on every release, so stale identifiers do not cancel a reused timer
+	};
+
+	static const int FREE = -1;			// timer in the free list
+	static const int FIRING = -2;		// timer due in the current Advance
+
+	vector<TimerNode> nodes;			// timer pool
+	vector<int> heads;					// head timer of each slot of each wheel, wheel-major (-1 if empty)
+	vector<int> dueTimers;				// scratch list of the timers due in one tick
+	int levelCounts[TIMER_WHEEL_LEVELS];	// # of timers in each wheel
+	int freeHead;						// head of the free list
+	long tickDuration;					// ms per tick
+	long currentTick;					// last tick processed
+	int pendingCount;					// # of pending timers
+};
+
+
+
+
+#endif
@@ -0,0 +1,129 @@
+/**
+ * WorkStealingPool.cpp
+ * Defines a thread pool running chunked parallel loops with work stealing.
+ *
+ * @author Jordan Wang
+ */
+
+#include "WorkStealingPool.hpp"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+using namespace std;
+
+
+
+
+WorkStealingPool::WorkStealingPool(int _threadCount)
+{
+	threadCount = (_threadCount > 0) ? _threadCount : max(1, (int)thread::hardware_concurrency());
+	queues = vector<deque<pair<int, int>>>(threadCount);
+	for (int i = 0; i < threadCount; i++)
+		queueMutexes.push_back(unique_ptr<mutex>(new mutex()));
+	task = nullptr;
+	generation = 0;
+	activeWorkers = 0;
+	stopping = false;
+	
+	for (int i = 0; i < threadCount; i++)
+		threads.push_back(thread(&WorkStealingPool::Run, this, i));
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	{
+		lock_guard<mutex> lock(poolMutex);
+		stopping = true;
+	}
+	workReady.notify_all();
+	for (vector<thread>::iterator it = threads.begin(); it != threads.end(); it++)
+		it->join();
+}
+
+int WorkStealingPool::GetThreadCount() const
+{
+	return threadCount;
+}
+
+void WorkStealingPool::ParallelFor(int taskCount, int chunkSize, const function<void(int, int, int)>& _task)
+{
+	if (taskCount <= 0) return;
+	chunkSize = max(1, chunkSize);
+	
+	// Give each worker a contiguous share of the chunks
+	int chunkCount = (taskCount + chunkSize - 1) / chunkSize;
+	for (int chunk = 0; chunk < chunkCount; chunk++)
+	{
+		int worker = (long)chunk * threadCount / chunkCount;
+		lock_guard<mutex> lock(*queueMutexes[worker]);
+		queues[worker].push_back(make_pair(chunk * chunkSize, min(taskCount, (chunk + 1) * chunkSize)));
+	}
+	
+	unique_lock<mutex> lock(poolMutex);
+	task = &_task;
+	activeWorkers = threadCount;
+	generation++;
+	workReady.notify_all();
+	workDone.wait(lock, [this]{ return activeWorkers == 0; });
+	task = nullptr;
+}
+
+void WorkStealingPool::Run(int worker)
+{
+	long seenGeneration = 0;
+	while (true)
+	{
+		const function<void(int, int, int)>* currTask;
+		{
+			unique_lock<mutex> lock(poolMutex);
+			workReady.wait(lock, [this, seenGeneration]{ return stopping || generation != seenGeneration; });
+			if (stopping) return;
+			seenGeneration = generation;
+			currTask = task;
+		}
+		
+		int begin, end;
+		while (PopChunk(worker, begin, end))
+			(*currTask)(begin, end, worker);
+		
+		lock_guard<mutex> lock(poolMutex);
+		if (--activeWorkers == 0) workDone.notify_all();
+	}
+}
+
+bool WorkStealingPool::PopChunk(int worker, int &begin, int &end)
+{
+	// Own queue first, from the front
+	{
+		lock_guard<mutex> lock(*queueMutexes[worker]);
+		if (!queues[worker].empty())
+		{
+			begin = queues[worker].front().first;
+			end = queues[worker].front().second;
+			queues[worker].pop_front();
+			return true;
+		}
+	}
+	
+	// Then steal from the back of the other queues
+	for (int i = 1; i < threadCount; i++)
+	{
+		int victim = (worker + i) % threadCount;
+		lock_guard<mutex> lock(*queueMutexes[victim]);
+		if (!queues[victim].empty())
+		{
+			begin = queues[victim].back().first;
+			end = queues[victim].back().second;
+			queues[victim].pop_back();
+			return true;
+		}
+	}
+	return false;
+}
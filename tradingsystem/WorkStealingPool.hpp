@@ -0,0 +1,69 @@
+/**
+ * WorkStealingPool.hpp
+ * Defines a thread pool running chunked parallel loops with work stealing.
+ *
+ * @author Jordan Wang
+ */
+
+#ifndef WorkStealingPool_hpp
+#define WorkStealingPool_hpp
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+using namespace std;
+
+
+
+
+/**
+ * Thread pool for parallel loops over [0, taskCount).
+ * The loop is cut into chunks and each worker starts with a contiguous share of them in its own queue.
+ * A worker pops chunks from the front of its own queue and, once it runs dry, steals from the back
+ * of the other queues, so that uneven chunks do not leave workers idle.
+ */
+class WorkStealingPool
+{
+
+public:
+	// ctor for a pool of worker threads (0 for one per core)
+	WorkStealingPool(int _threadCount);
+
+	// dtor joining all the worker threads
+	~WorkStealingPool();
+
+	// Get the # of worker threads
+	int GetThreadCount() const;
+
+	// Run task(begin, end, worker) over chunks of [0, taskCount) and wait until all chunks are done
+	void ParallelFor(int taskCount, int chunkSize, const function<void(int, int, int)>& task);
+
+private:
+	// Worker thread loop
+	void Run(int worker);
+
+	// Pop a chunk from the worker's own queue, or steal one from another worker
+	bool PopChunk(int worker, int &begin, int &end);
+
+	int threadCount;
+	vector<thread> threads;
+	vector<deque<pair<int, int>>> queues;			// chunk queue of each worker
+	vector<unique_ptr<mutex>> queueMutexes;			// mutex guarding the queue of each worker
+	mutex poolMutex;
+	condition_variable workReady;
+	condition_variable workDone;
+	const function<void(int, int, int)>* task;		// task of the running loop
+	long generation;								// # of loops started
+	int activeWorkers;								// # of workers still busy on the running loop
+	bool stopping;
+};
+
+
+
+
+#endif
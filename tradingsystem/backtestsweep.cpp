@@ -0,0 +1,86 @@
+/**
+ * backtestsweep.cpp
+ * Sweeps the parameters of the algo execution and algo streaming strategies over recorded data, a backtest per core.
+ * Usage: backtestsweep [# of replays of the input data] [# of threads, 0 for one per core]
+ *
+ * @author Jordan Wang
+ */
+
+#include "soa.hpp"
+#include "products.hpp"
+#include "my functions.hpp"
+#include "Backtest.hpp"
+#include "WorkStealingPool.hpp"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+	int replays = argc > 1 ? atoi(argv[1]) : 1;
+	int threadCount = argc > 2 ? atoi(argv[2]) : 0;
+
+	// Read the data once, shared read-only by all the backtests
+	fstream marketDataStream("./input/marketdata.txt", ios::in);
+	fstream pricesStream("./input/prices.txt", ios::in);
+	vector<vector<string>> marketData = ReadDataStream(marketDataStream);
+	vector<vector<string>> prices = ReadDataStream(pricesStream);
+	if (marketData.empty() || prices.empty())
+	{
+		cout << "No data in ./input/marketdata.txt or ./input/prices.txt" << endl;
+		return 1;
+	}
+
+	// Grid of the widest spread aggressed at, by the quote sizes, by the alternation period of the execution algo
+	vector<double> minSpreads = { 1.0 / 256.0, 1.0 / 128.0, 2.0 / 128.0, 4.0 / 128.0 };
+	vector<pair<long, long>> visibleQuantities = { { 1000000, 2000000 }, { 10000000, 2000000 }, { 5000000, 5000000 } };
+	vector<double> hiddenRatios = { 0.0, 2.0 };
+	vector<int> alternationPeriods = { 1, 8 };
+	vector<BacktestParameters> grid;
+	for (vector<double>::iterator s_it = minSpreads.begin(); s_it != minSpreads.end(); s_it++)
+		for (vector<pair<long, long>>::iterator q_it = visibleQuantities.begin(); q_it != visibleQuantities.end(); q_it++)
+			for (vector<double>::iterator h_it = hiddenRatios.begin(); h_it != hiddenRatios.end(); h_it++)
+				for (vector<int>::iterator a_it = alternationPeriods.begin(); a_it != alternationPeriods.end(); a_it++)
+				{
+					stringstream name;
+					name << "spread " << *s_it * 256 << "/256 sizes " << q_it->first / 1000000 << "M/" << q_it->second / 1000000 << "M hidden x"
+						<< *h_it << " alt " << *a_it;
+					grid.push_back(BacktestParameters{ name.str(), *s_it, { q_it->first, q_it->second }, *h_it, *a_it });
+				}
+
+	// One backtest per task, each on its own service graph, so workers never share state
+	WorkStealingPool pool(threadCount);
+	vector<BacktestResult> results(grid.size());
+	cout << "Running " << grid.size() << " backtests over " << replays << " replays of " << marketData.size() << " market data and "
+		<< prices.size() << " price lines on " << pool.GetThreadCount() << " threads" << endl;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	pool.ParallelFor(grid.size(), 1, [&](int begin, int end, int worker)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			Backtest<Bond> backtest(grid[i]);
+			results[i] = backtest.Run(marketData, prices, replays);
+		}
+	});
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	cout << left << setw(44) << "parameters" << right << setw(10) << "executions" << setw(16) << "executed" << setw(16) << "slippage"
+		<< setw(16) << "exec P&L" << setw(10) << "quotes" << setw(10) << "fills" << setw(16) << "filled" << setw(16) << "stream P&L"
+		<< setw(10) << "seconds" << endl;
+	cout << fixed << setprecision(2);
+	for (int i = 0; i < (int)grid.size(); i++)
+	{
+		const BacktestResult& res = results[i];
+		cout << left << setw(44) << grid[i].name << right << setw(10) << res.executionCount << setw(16) << res.executedQuantity
+			<< setw(16) << res.executionSlippage << setw(16) << res.executionPnL << setw(10) << res.quoteCount << setw(10) << res.quoteFillCount
+			<< setw(16) << res.quoteFilledQuantity << setw(16) << res.streamingPnL << setw(10) << res.seconds << endl;
+	}
+	cout << "Swept " << grid.size() << " parameter sets in " << elapsed << "s" << endl;
+	return 0;
+}
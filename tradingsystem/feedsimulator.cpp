@@ -0,0 +1,251 @@
+/**
+ * feedsimulator.cpp
+ * Local feed simulator standing in for the exchange, replaying an input data file over a socket.
+ * Usage: feedsimulator [input file] [Unix socket path or loopback TCP port] [text, binary or sbe]
+ *        [messages per second, 0 for no limit] [# of replays] [drop rate]
+ * The sbe mode replays a file of binary market data messages written by marketdataconverter, numbered
+ * again per product across replays. It drops the given share of messages at random, as a lossy feed
+ * would, and answers the snapshot requests of the subscriber from the books of the messages sent.
+ *
+ * @author Jordan Wang
+ */
+
+#include "SocketConnector.hpp"
+#include "MarketDataMessage.hpp"
+#include "my functions.hpp"
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+using namespace std;
+
+// Book of a product as the simulated exchange holds it, to answer snapshot requests
+struct SimulatedBook
+{
+	unsigned long sequence;					// sequence number of the last message sent or dropped
+	vector<long> prices[2];					// price in ticks of each level, per side
+	vector<long> quantities[2];				// quantity of each level, per side
+};
+
+// Write a whole buffer to a blocking socket (false once the subscriber has gone)
+bool WriteAll(int fd, const char* data, long size)
+{
+	while (size > 0)
+	{
+		ssize_t bytes = write(fd, data, size);
+		if (bytes < 0 && errno == EINTR) continue;
+		if (bytes <= 0) return false;
+		data += bytes;
+		size -= bytes;
+	}
+	return true;
+}
+
+// Apply a level update or book snapshot to the book of its product
+void ApplyMessage(SimulatedBook& book, const char* message)
+{
+	MarketDataMessageView view(message);
+	if (view.GetTemplateId() == MARKET_DATA_LEVEL_UPDATE)
+	{
+		LevelUpdateView update(message);
+		int side = update.GetSide() ? 1 : 0;
+		if (update.GetLevel() >= (int)book.prices[side].size())
+		{
+			book.prices[side].resize(update.GetLevel() + 1, 0);
+			book.quantities[side].resize(update.GetLevel() + 1, 0);
+		}
+		book.prices[side][update.GetLevel()] = update.GetPriceTicks();
+		book.quantities[side][update.GetLevel()] = update.GetQuantity();
+	}
+	if (view.GetTemplateId() == MARKET_DATA_BOOK_SNAPSHOT)
+	{
+		BookSnapshotView snapshot(message);
+		for (int side = 0; side < 2; side++)
+		{
+			book.prices[side].clear();
+			book.quantities[side].clear();
+		}
+		for (int i = 0; i < snapshot.GetEntryCount(); i++)
+		{
+			int side = snapshot.GetEntrySide(i) ? 1 : 0;
+			book.prices[side].push_back((long)(snapshot.GetEntryPrice(i) * MARKET_DATA_TICKS));
+			book.quantities[side].push_back(snapshot.GetEntryQuantity(i));
+		}
+	}
+}
+
+// Answer the snapshot requests read so far with the current books (false once the subscriber has gone)
+bool AnswerRequests(int fd, vector<char>& requests, map<string, SimulatedBook>& books, long& answered)
+{
+	char buffer[MARKET_DATA_SNAPSHOT_REQUEST_SIZE * 64];
+	ssize_t bytes = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+	if (bytes == 0) return false;
+	if (bytes < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	requests.insert(requests.end(), buffer, buffer + bytes);
+	
+	long begin = 0;
+	vector<char> message(MARKET_DATA_MAX_SIZE);
+	while ((long)requests.size() - begin >= MARKET_DATA_SNAPSHOT_REQUEST_SIZE)
+	{
+		MarketDataMessageView request(&requests[begin]);
+		begin += MARKET_DATA_SNAPSHOT_REQUEST_SIZE;
+		if (request.GetTemplateId() != MARKET_DATA_SNAPSHOT_REQUEST) continue;
+		
+		// The snapshot is as of the last message of the product, sent or not
+		string productId = request.GetProductId();
+		SimulatedBook& book = books[productId];
+		int entryCount = book.prices[0].size() + book.prices[1].size();
+		int offset = EncodeBookSnapshot(&message[0], book.sequence, productId, MARKET_DATA_CONSOLIDATED, entryCount);
+		for (int side = 0; side < 2; side++)
+			for (int i = 0; i < (int)book.prices[side].size(); i++)
+				offset = EncodeBookSnapshotEntry(&message[0], offset, book.prices[side][i], book.quantities[side][i], side);
+		if (!WriteAll(fd, &message[0], offset)) return false;
+		answered++;
+	}
+	requests.erase(requests.begin(), requests.begin() + begin);
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	string inputFile = argc > 1 ? argv[1] : "./input/prices.txt";
+	string address = argc > 2 ? argv[2] : "/tmp/prices.sock";
+	bool binary = argc > 3 && string(argv[3]) == "binary";
+	bool sbe = argc > 3 && string(argv[3]) == "sbe";
+	long rate = argc > 4 ? atol(argv[4]) : 0;
+	int replays = argc > 5 ? atoi(argv[5]) : 1;
+	double dropRate = argc > 6 ? atof(argv[6]) : 0.0;
+	signal(SIGPIPE, SIG_IGN);
+
+	// Encode the whole feed up front, so that sending costs nothing but the writes
+	fstream data_stream(inputFile, ios::in | ios::binary);
+	string curr_line;
+	vector<char> feed;
+	vector<long> offsets(1, 0);			// offset of each message in the feed
+	char frame[DATA_FRAME_MAX_SIZE];
+	if (sbe)
+	{
+		// Already encoded: cut the file into messages by their lengths
+		feed.assign(istreambuf_iterator<char>(data_stream), istreambuf_iterator<char>());
+		while (offsets.back() + MARKET_DATA_HEADER_SIZE <= (long)feed.size())
+		{
+			long messageLength = MarketDataMessageView(&feed[offsets.back()]).GetMessageLength();
+			if (messageLength < MARKET_DATA_HEADER_SIZE || offsets.back() + messageLength > (long)feed.size()) break;
+			offsets.push_back(offsets.back() + messageLength);
+		}
+	}
+	while (!sbe && getline(data_stream, curr_line))
+	{
+		vector<string> words = ReadDataLine(curr_line);		// split as the connectors read it
+		if (words.empty()) continue;
+		if (binary)
+		{
+			int size = EncodeDataFrame(words, frame);
+			if (size < 0) continue;
+			feed.insert(feed.end(), frame, frame + size);
+		}
+		else
+		{
+			for (vector<string>::iterator it = words.begin(); it != words.end(); it++)
+			{
+				if (it != words.begin()) feed.push_back(' ');
+				feed.insert(feed.end(), it->begin(), it->end());
+			}
+			feed.push_back('\n');
+		}
+		offsets.push_back(feed.size());
+	}
+	long messageCount = offsets.size() - 1;
+	if (messageCount == 0)
+	{
+		cout << "No data in " << inputFile << endl;
+		return 1;
+	}
+
+	// A numeric address is a loopback TCP port, anything else a Unix socket path
+	bool tcp = address.find_first_not_of("0123456789") == string::npos;
+	int listenFd = tcp ? ListenLoopback(atoi(address.c_str())) : ListenUnixSocket(address);
+	if (listenFd < 0)
+	{
+		cout << "Cannot listen on " << address << endl;
+		return 1;
+	}
+	cout << "Serving " << messageCount << " messages of " << inputFile << " on " << address << (sbe ? " (sbe)" : binary ? " (binary)" : " (text)") << endl;
+	int fd = AcceptConnection(listenFd);
+
+	// Send in 1ms batches at the requested rate, or as fast as the subscriber takes it
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	map<string, SimulatedBook> books;		// a map of {product identifier -> book}, in sbe mode
+	vector<char> batch;						// messages of the batch not dropped, in sbe mode
+	vector<char> requests;					// snapshot requests read but not yet answered
+	mt19937 generator(42);
+	uniform_real_distribution<double> uniform(0.0, 1.0);
+	long dropped = 0;
+	long answered = 0;
+	long sent = 0;
+	long total = messageCount * replays;
+	bool connected = fd >= 0;
+	while (connected && sent < total)
+	{
+		long target = total;
+		if (rate > 0)
+		{
+			double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			target = min(total, (long)(elapsed * rate) + 1);
+			if (target <= sent)
+			{
+				this_thread::sleep_for(chrono::microseconds(100));
+				continue;
+			}
+		}
+
+		// Send up to the target without wrapping round the end of the feed in one write
+		long first = sent % messageCount;
+		long last = min(first + (target - sent), messageCount);
+		if (sbe)
+		{
+			// Number each message of a product on from the last, keep the books, and drop some of the messages
+			batch.clear();
+			for (long i = first; i < last; i++)
+			{
+				char* message = &feed[offsets[i]];
+				SimulatedBook& book = books[MarketDataMessageView(message).GetProductId()];
+				SetMessageSequence(message, ++book.sequence);
+				ApplyMessage(book, message);
+				if (dropRate > 0 && uniform(generator) < dropRate) dropped++;
+				else batch.insert(batch.end(), message, message + (offsets[i + 1] - offsets[i]));
+			}
+			connected = WriteAll(fd, batch.data(), batch.size()) && AnswerRequests(fd, requests, books, answered);
+		}
+		else connected = WriteAll(fd, &feed[offsets[first]], offsets[last] - offsets[first]);
+		sent += last - first;
+	}
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	
+	// Give the subscriber time to ask for the snapshots still missing
+	chrono::steady_clock::time_point lastRequest = chrono::steady_clock::now();
+	while (sbe && connected && chrono::steady_clock::now() - lastRequest < chrono::milliseconds(100))
+	{
+		long before = answered;
+		connected = AnswerRequests(fd, requests, books, answered);
+		if (answered > before) lastRequest = chrono::steady_clock::now();
+		this_thread::sleep_for(chrono::microseconds(100));
+	}
+	cout << "Sent " << sent << " messages in " << elapsed << "s (" << (long)(sent / max(elapsed, 1e-9)) << " messages/s)" << endl;
+	if (sbe) cout << "Dropped " << dropped << " messages, answered " << answered << " snapshot requests" << endl;
+
+	if (fd >= 0) close(fd);
+	close(listenFd);
+	if (!tcp) unlink(address.c_str());
+	return 0;
+}
@@ -0,0 +1,55 @@
+/**
+ * guireader.cpp
+ * Demo GUI process reading the latest prices GUIService writes to shared memory.
+ * Usage: guireader [segment name] [# of refreshes] [refresh interval in ms]
+ *
+ * @author Jordan Wang
+ */
+
+#include "SharedPriceTable.hpp"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+	string name = argc > 1 ? argv[1] : "/gui_prices";
+	int refreshes = argc > 2 ? atoi(argv[2]) : 10;
+	int interval = argc > 3 ? atoi(argv[3]) : 300;
+
+	// Wait for the trading process to create the table
+	SharedPriceReader* reader = new SharedPriceReader(name);
+	for (int i = 0; i < 100 && !reader->IsOpen(); i++)
+	{
+		delete reader;
+		this_thread::sleep_for(chrono::milliseconds(100));
+		reader = new SharedPriceReader(name);
+	}
+	if (!reader->IsOpen())
+	{
+		cout << "Cannot open shared memory " << name << endl;
+		delete reader;
+		return 1;
+	}
+
+	// Print a consistent snapshot of every product at each refresh
+	for (int i = 0; i < refreshes; i++)
+	{
+		vector<PriceSnapshot> snapshots = reader->ReadAll();
+		cout << "*** Refresh " << i << " (" << snapshots.size() << " products) ***" << endl;
+		for (vector<PriceSnapshot>::iterator it = snapshots.begin(); it != snapshots.end(); it++)
+		{
+			cout << setw(12) << it->productId << fixed << setprecision(6) << setw(14) << it->mid << setw(12) << it->bidOfferSpread
+				<< setw(10) << it->sequence / 2 << " updates" << endl;
+		}
+		this_thread::sleep_for(chrono::milliseconds(interval));
+	}
+
+	delete reader;
+	return 0;
+}
@@ -0,0 +1,262 @@
+/**
+ * lobbench.cpp
+ * Checks LimitOrderBook against a map-based reference book, then times MatchingSimulator replaying an L3 feed.
+ * Usage: lobbench [# of reference operations] [# of replayed events] [# of live orders]
+ *
+ * @author Jordan Wang
+ */
+
+#include "soa.hpp"
+#include "products.hpp"
+#include "my functions.hpp"
+#include "LimitOrderBook.hpp"
+#include "MatchingSimulator.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <unordered_map>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+using namespace std;
+
+const long LADDER_MIN = 25000;				// lowest price of the ladder in ticks (~97.66)
+const long LADDER_MAX = 26000;				// highest price of the ladder in ticks (~101.56)
+
+// Order of the reference book
+struct ReferenceOrder
+{
+	int side;								// side of the book (0 BID, 1 OFFER)
+	long price;								// price in ticks
+	long quantity;							// quantity left
+};
+
+// Straightforward book of ordered maps and lists that LimitOrderBook is checked against
+struct ReferenceBook
+{
+	map<long, list<long>> levels[2];		// order identifiers of each price, oldest first, per side
+	unordered_map<long, ReferenceOrder> orders;	// a map of {order identifier -> live order}
+
+	bool AddOrder(long orderId, int side, long price, long quantity)
+	{
+		if (price < LADDER_MIN || price > LADDER_MAX || quantity <= 0 || orders.count(orderId)) return false;
+		orders[orderId] = ReferenceOrder{ side, price, quantity };
+		levels[side][price].push_back(orderId);
+		return true;
+	}
+
+	long ReduceOrder(long orderId, long quantity)
+	{
+		unordered_map<long, ReferenceOrder>::iterator it = orders.find(orderId);
+		if (it == orders.end()) return 0;
+		long reduced = min(quantity, it->second.quantity);
+		it->second.quantity -= reduced;
+		if (it->second.quantity > 0) return reduced;
+
+		list<long>& level = levels[it->second.side][it->second.price];
+		level.remove(orderId);
+		if (level.empty()) levels[it->second.side].erase(it->second.price);
+		orders.erase(it);
+		return reduced;
+	}
+
+	long Match(int side, long limitPrice, long quantity, vector<pair<long, long>>& fills)
+	{
+		long filled = 0;
+		while (filled < quantity && !levels[side].empty())
+		{
+			long price = GetBestPrice(side);
+			if (limitPrice > 0 && (side == 0 ? price < limitPrice : price > limitPrice)) break;
+			long orderId = levels[side][price].front();
+			long fill = min(quantity - filled, orders[orderId].quantity);
+			fills.push_back(make_pair(orderId, fill));
+			ReduceOrder(orderId, fill);
+			filled += fill;
+		}
+		return filled;
+	}
+
+	long GetBestPrice(int side) const
+	{
+		if (levels[side].empty()) return -1;
+		return (side == 0) ? levels[side].rbegin()->first : levels[side].begin()->first;
+	}
+
+	long GetLevelQuantity(int side, long price) const
+	{
+		map<long, list<long>>::const_iterator it = levels[side].find(price);
+		if (it == levels[side].end()) return 0;
+		long quantity = 0;
+		for (list<long>::const_iterator o_it = it->second.begin(); o_it != it->second.end(); o_it++)
+			quantity += orders.at(*o_it).quantity;
+		return quantity;
+	}
+};
+
+// Collects the fills Match reports
+class FillRecorder : public BookFillListener
+{
+public:
+	vector<pair<long, long>> fills;			// {order identifier, quantity} of each fill
+
+	void ProcessFill(long orderId, long price, long quantity)
+	{
+		fills.push_back(make_pair(orderId, quantity));
+	}
+};
+
+// Event of the replayed L3 feed
+struct FeedEvent
+{
+	int type;								// 0 add, 1 cancel, 2 execute
+	long orderId;							// order identifier
+	int side;								// side of an add (0 BID, 1 OFFER)
+	long price;								// price of an add, in ticks
+	long quantity;							// quantity added, cancelled or executed
+};
+
+// Run random adds, cancels, executions and matches on both books, comparing what they return, the top of each
+// side and the # of live orders after every operation; returns the # of operations run before the first difference
+long CheckAgainstReference(long operationCount, int capacity, mt19937_64& generator)
+{
+	LimitOrderBook book(LADDER_MIN, LADDER_MAX, capacity);
+	ReferenceBook reference;
+	FillRecorder recorder;
+	vector<long> ids;
+	long nextId = 1;
+	uniform_int_distribution<int> operations(0, 99);
+	uniform_int_distribution<long> prices(LADDER_MIN - 10, LADDER_MAX + 10);
+	uniform_int_distribution<long> quantities(1, 50);
+	for (long i = 0; i < operationCount; i++)
+	{
+		int operation = operations(generator);
+		long orderId = ids.empty() ? 0 : ids[generator() % ids.size()];
+		bool matched = true;
+		if (operation < 45 || ids.empty())
+		{
+			// A few adds reuse a live identifier, and a few fall off the ladder
+			long id = (operation < 2 && !ids.empty()) ? orderId : nextId++;
+			int side = generator() % 2;
+			long price = prices(generator);
+			long quantity = quantities(generator);
+			bool added = book.AddOrder(id, side, price, quantity);
+			matched = added == ((int)reference.orders.size() < capacity && reference.AddOrder(id, side, price, quantity));
+			if (added) ids.push_back(id);
+			if (matched) matched = book.GetLevelQuantity(side, price) == reference.GetLevelQuantity(side, price);
+		}
+		else if (operation < 70)
+		{
+			long quantity = quantities(generator);
+			matched = book.CancelOrder(orderId, quantity) == reference.ReduceOrder(orderId, quantity);
+		}
+		else if (operation < 90)
+		{
+			long quantity = quantities(generator);
+			matched = book.ExecuteOrder(orderId, quantity) == reference.ReduceOrder(orderId, quantity);
+		}
+		else
+		{
+			int side = generator() % 2;
+			long limitPrice = (operation < 95) ? 0 : prices(generator);
+			long quantity = 4 * quantities(generator);
+			vector<pair<long, long>> fills;
+			recorder.fills.clear();
+			matched = book.Match(side, limitPrice, quantity, &recorder) == reference.Match(side, limitPrice, quantity, fills) && recorder.fills == fills;
+		}
+
+		// Forget the identifiers that have gone, then compare the tops of the books
+		for (size_t j = 0; j < ids.size();)
+		{
+			if (reference.orders.count(ids[j])) j++;
+			else
+			{
+				ids[j] = ids.back();
+				ids.pop_back();
+			}
+		}
+		for (int side = 0; side < 2 && matched; side++)
+		{
+			long best = reference.GetBestPrice(side);
+			matched = book.GetBestPrice(side) == best && (best < 0 || book.GetLevelQuantity(side, best) == reference.GetLevelQuantity(side, best));
+		}
+		if (matched) matched = book.GetOrderCount() == (int)reference.orders.size();
+		if (!matched) return i;
+	}
+	return operationCount;
+}
+
+// Generate a feed of adds, cancels and executions keeping about liveCount orders in the book
+vector<FeedEvent> GenerateFeed(long eventCount, int liveCount, mt19937_64& generator)
+{
+	vector<FeedEvent> events;
+	events.reserve(eventCount);
+	vector<FeedEvent> live;
+	long nextId = 1;
+	uniform_int_distribution<long> offsets(0, 40);
+	uniform_int_distribution<long> quantities(1, 50);
+	long mid = (LADDER_MIN + LADDER_MAX) / 2;
+	while ((long)events.size() < eventCount)
+	{
+		// Add below the working set, otherwise cancel or execute a live order, the executions near the touch
+		bool add = (int)live.size() < liveCount || generator() % 2 == 0;
+		if (add && (int)live.size() < liveCount + liveCount / 8)
+		{
+			int side = generator() % 2;
+			long price = (side == 0) ? mid - 1 - offsets(generator) : mid + 1 + offsets(generator);
+			FeedEvent event = FeedEvent{ 0, nextId++, side, price, quantities(generator) };
+			events.push_back(event);
+			live.push_back(event);
+			continue;
+		}
+		size_t index = generator() % live.size();
+		FeedEvent& order = live[index];
+		int type = (generator() % 3 == 0) ? 2 : 1;
+		long quantity = min(order.quantity, quantities(generator));
+		events.push_back(FeedEvent{ type, order.orderId, order.side, order.price, quantity });
+		order.quantity -= quantity;
+		if (order.quantity > 0) continue;
+		live[index] = live.back();
+		live.pop_back();
+	}
+	return events;
+}
+
+int main(int argc, char* argv[])
+{
+	long operationCount = argc > 1 ? atol(argv[1]) : 2000000;
+	long eventCount = argc > 2 ? atol(argv[2]) : 20000000;
+	int liveCount = argc > 3 ? atoi(argv[3]) : 10000;
+	mt19937_64 generator(9815);
+
+	long checked = CheckAgainstReference(operationCount, liveCount, generator);
+	if (checked < operationCount)
+	{
+		cout << "LimitOrderBook differs from the reference book at operation " << checked << endl;
+		return 1;
+	}
+	cout << "LimitOrderBook matches the reference book over " << operationCount << " operations" << endl;
+
+	// Replay the feed through a simulator sized to the working set, with a child resting at each touch
+	vector<FeedEvent> events = GenerateFeed(eventCount, liveCount, generator);
+	Bond bond = GetBond("91282CAX9");
+	MatchingSimulator<Bond> simulator(bond, (double)LADDER_MIN / MARKET_DATA_TICKS, (double)LADDER_MAX / MARKET_DATA_TICKS, 2 * liveCount);
+	long mid = (LADDER_MIN + LADDER_MAX) / 2;
+	simulator.SubmitOrder(ExecutionOrder<Bond>(bond, OFFER, "BENCHBID", LIMIT, (double)(mid - 1) / MARKET_DATA_TICKS, 1000000, 0, "", false));
+	simulator.SubmitOrder(ExecutionOrder<Bond>(bond, BID, "BENCHOFFER", LIMIT, (double)(mid + 1) / MARKET_DATA_TICKS, 1000000, 0, "", false));
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	long executed = 0;
+	for (vector<FeedEvent>::const_iterator it = events.begin(); it != events.end(); it++)
+	{
+		if (it->type == 0) simulator.OnAdd(it->orderId, it->side == 0 ? BID : OFFER, (double)it->price / MARKET_DATA_TICKS, it->quantity);
+		else if (it->type == 1) simulator.OnCancel(it->orderId, it->quantity);
+		else executed += simulator.OnExecute(it->orderId, it->quantity);
+	}
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	cout << "Replayed " << events.size() << " events with " << liveCount << " live orders in " << elapsed << "s ("
+		<< events.size() / elapsed / 1e6 << "M events/s), executed " << executed << ", child fills " << simulator.GetFillCount() << endl;
+	return 0;
+}
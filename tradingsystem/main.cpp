@@ -12,12 +12,19 @@
 #include "BondTradeBookingService.hpp"
 #include "BondPositionService.hpp"
 #include "BondRiskService.hpp"
+#include "BondCurveService.hpp"
+#include "BondScenarioService.hpp"
+#include "BondVaRService.hpp"
 #include "BondMarketDataService.hpp"
 #include "BondExecutionService.hpp"
 #include "BondStreamingService.hpp"
 #include "GUIService.hpp"
 #include "BondInquiryService.hpp"
 #include "BondHistoricalDataService.hpp"
+#include "TimerWheel.hpp"
+#include "EventLoop.hpp"
+#include "SocketConnector.hpp"
+#include "MarketDataMessage.hpp"
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -27,18 +34,26 @@
 #include <chrono>
 #include <map>
 #include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+#include <fcntl.h>
 using namespace std;
 
-int main()
+int main(int argc, char* argv[])
 {
 	// Initialize all services
 	cout << "*******************************" << endl;
 	cout << "*** Initialize all services ***" << endl;
 	cout << "*******************************" << endl;
+	TimerWheel timerWheel(1, 1 << 18, 0);		// 1ms ticks, shared by the time-driven services
 	PricingService<Bond> pricingService;
     TradeBookingService<Bond> tradeBookingService;
     PositionService<Bond> positionService;
     RiskService<Bond> riskService;
+    CurveService<Bond> curveService(GetBonds(), "UST");
+    ScenarioService<Bond> scenarioService(0);
+    VaRService<Bond> varService("TRSY", 250, 0.99);
     MarketDataService<Bond> marketDataService;
     AlgoExecutionService<Bond> algoExecutionService;
     AlgoStreamingService<Bond> algoStreamingService;	
@@ -46,11 +61,15 @@ int main()
     ExecutionService<Bond> executionService;
     StreamingService<Bond> streamingService;
     InquiryService<Bond> inquiryService;
-    HistoricalDataService<PriceStream<Bond>> historicalStreamingService(STREAMING);
+    HistoricalDataService<PriceStreamDelta<Bond>> historicalStreamingService(STREAMING);
     HistoricalDataService<ExecutionOrder<Bond>> historicalExecutionService(EXECUTION);
     HistoricalDataService<Position<Bond>> historicalPositionService(POSITION);
     HistoricalDataService<PV01<Bond>> historicalRiskService(RISK);
     HistoricalDataService<Inquiry<Bond>> historicalInquiryService(INQUIRY);
+    HistoricalDataService<ScenarioPnL> historicalScenarioService(SCENARIO);
+    HistoricalDataService<KeyRateLadder<Bond>> historicalLadderService(LADDER);
+    HistoricalDataService<OrderBook<Bond>> historicalBookService(ORDER_BOOK);
+    HistoricalDataService<ValueAtRisk> historicalVaRService(VAR);
 	cout << "*******************************" << endl;
 	cout << "*** Initialization complete ***" << endl; 
 	cout << "*******************************" << endl;
@@ -62,17 +81,64 @@ int main()
 	cout << "********************************" << endl;
     pricingService.AddListener(algoStreamingService.GetListener());
     pricingService.AddListener(guiService.GetListener());
+    pricingService.AddListener(riskService.GetPricingListener());
+    pricingService.AddListener(curveService.GetListener());
+    curveService.AddListener(riskService.GetCurveListener());
+    curveService.AddListener(scenarioService.GetCurveListener());
+    positionService.AddListener(scenarioService.GetListener());
     tradeBookingService.AddListener(positionService.GetListener());
     positionService.AddListener(riskService.GetListener());
     marketDataService.AddListener(algoExecutionService.GetListener());
     algoExecutionService.AddListener(executionService.GetListener());
     algoStreamingService.AddListener(streamingService.GetListener());
+    positionService.AddListener(algoStreamingService.GetPositionListener());
+    algoStreamingService.SetPositionService(&positionService);
+    algoStreamingService.SetMarketDataService(&marketDataService);
     executionService.AddListener(tradeBookingService.GetListener()); 
+    executionService.SetMarketDataService(&marketDataService);
+    executionService.AddListener(algoExecutionService.GetExecutionListener());
 	positionService.AddListener(historicalPositionService.GetListener());
     riskService.AddListener(historicalRiskService.GetListener());
+    riskService.AddListener(varService.GetListener());
+    varService.AddListener(historicalVaRService.GetListener());
+    riskService.AddLadderListener(historicalLadderService.GetListener());
     executionService.AddListener(historicalExecutionService.GetListener());
-    streamingService.AddListener(historicalStreamingService.GetListener());
+    streamingService.AddDeltaListener(historicalStreamingService.GetListener());
     inquiryService.AddListener(historicalInquiryService.GetListener());
+    scenarioService.AddListener(historicalScenarioService.GetListener());
+    marketDataService.AddConflatedListener(historicalBookService.GetListener());		// slow consumer of the books
+
+	// Schedule the time-driven services on the shared timer wheel
+	guiService.SetTimerWheel(&timerWheel);
+	algoExecutionService.SetTimerWheel(&timerWheel);
+	algoStreamingService.SetTimerWheel(&timerWheel);
+	inquiryService.SetTimerWheel(&timerWheel);
+	inquiryService.SetPricingService(&pricingService);
+	inquiryService.GetConnector()->SetClient(&timerWheel, 200, 4);		// the client answers in 200ms and lets every 4th quote lapse
+	
+	// Price the bonds as of the settlement date of the input data
+	riskService.SetSettlementDate(from_string("2020/12/21"));
+	curveService.SetSettlementDate(from_string("2020/12/21"));
+	scenarioService.SetSettlementDate(from_string("2020/12/21"));
+	
+	// Register the bucket sectors for bucketed risk
+	vector<Bond> frontEnd = { GetBond("91282CAX9"), GetBond("91282CBA8") };
+	vector<Bond> belly = { GetBond("91282CAZ4"), GetBond("91282CAY7"), GetBond("91282CAV3") };
+	vector<Bond> longEnd = { GetBond("912810ST6"), GetBond("912810SS8") };
+	riskService.AddBucketedSector(BucketedSector<Bond>(frontEnd, "FrontEnd"));
+	riskService.AddBucketedSector(BucketedSector<Bond>(belly, "Belly"));
+	riskService.AddBucketedSector(BucketedSector<Bond>(longEnd, "LongEnd"));
+	
+	// Fill the VaR window with the daily par yield changes (in bp) of the last year, oldest first
+	fstream yieldHistoryStream("./input/yieldhistory.txt");
+	vector<vector<string>> yieldHistory = ReadDataStream(yieldHistoryStream);
+	for (vector<vector<string>>::iterator it = yieldHistory.begin(); it != yieldHistory.end(); it++)
+	{
+		vector<double> yieldChanges;
+		for (vector<string>::iterator word_it = it->begin() + 1; word_it != it->end(); word_it++)
+			yieldChanges.push_back(stod(*word_it));
+		varService.AddYieldChanges(yieldChanges);
+	}
 	cout << "*******************************" << endl;
 	cout << "*** Initialization complete ***" << endl; 
 	cout << "*******************************" << endl;
@@ -82,16 +148,86 @@ int main()
 	cout << "*******************************" << endl;
 	cout << "*** Test the trading system ***" << endl;
 	cout << "*******************************" << endl;
-	// Load 4 input data files
-	fstream prices_txt("./input/prices.txt");
-	fstream marketdata_txt("./input/marketdata.txt");
-	fstream trades_txt("./input/trades.txt");
-	fstream inquiries_txt("./input/inquiries.txt");
-	// Read 4 input data files
-    pricingService.GetConnector()->Subscribe(prices_txt);
-    marketDataService.GetConnector()->Subscribe(marketdata_txt);
-    tradeBookingService.GetConnector()->Subscribe(trades_txt);
-    inquiryService.GetConnector()->Subscribe(inquiries_txt);
+	// Read 4 input data files together on the event loop, with the timers of the services,
+	// or subscribe 4 live feeds from feed simulators with: main [socket directory or base port] [text, binary or sbe]
+	// (a numeric address is the loopback TCP port of the prices feed, with market data, trades and inquiries on the
+	// next 3 ports; sbe takes binary market data messages and text for the other feeds)
+	bool live = argc > 1;
+	bool binary = argc > 2 && string(argv[2]) == "binary";
+	bool sbe = argc > 2 && string(argv[2]) == "sbe";
+	string address = live ? argv[1] : "";
+	bool tcp = live && address.find_first_not_of("0123456789") == string::npos;
+	int basePort = tcp ? atoi(address.c_str()) : 0;
+	EventLoop eventLoop(&timerWheel);
+	unique_ptr<EventListener> pricesSubscriber(binary ? (EventListener*)new FrameSubscriber<PricingConnector<Bond>>(pricingService.GetConnector())
+		: new LineSubscriber<PricingConnector<Bond>>(pricingService.GetConnector()));
+	unique_ptr<EventListener> marketDataSubscriber(sbe ? (EventListener*)new MarketDataMessageSubscriber<MarketDataConnector<Bond>>(marketDataService.GetConnector())
+		: binary ? (EventListener*)new FrameSubscriber<MarketDataConnector<Bond>>(marketDataService.GetConnector())
+		: new LineSubscriber<MarketDataConnector<Bond>>(marketDataService.GetConnector()));
+	unique_ptr<EventListener> tradesSubscriber(binary ? (EventListener*)new FrameSubscriber<TradeBookingConnector<Bond>>(tradeBookingService.GetConnector())
+		: new LineSubscriber<TradeBookingConnector<Bond>>(tradeBookingService.GetConnector()));
+	unique_ptr<EventListener> inquiriesSubscriber(binary ? (EventListener*)new FrameSubscriber<InquiryConnector<Bond>>(inquiryService.GetConnector())
+		: new LineSubscriber<InquiryConnector<Bond>>(inquiryService.GetConnector()));
+	string feeds[4] = { "prices", "marketdata", "trades", "inquiries" };
+	int feedFds[4];
+	for (int i = 0; i < 4; i++)
+		feedFds[i] = !live ? open(("./input/" + feeds[i] + ".txt").c_str(), O_RDONLY)
+			: tcp ? ConnectLoopback(basePort + i) : ConnectUnixSocket(address + "/" + feeds[i] + ".sock");
+	if (sbe) marketDataService.GetConnector()->SetRequestDescriptor(feedFds[1]);		// snapshot requests go back up the feed
+	eventLoop.AddReader(feedFds[0], pricesSubscriber.get());
+	eventLoop.AddReader(feedFds[1], marketDataSubscriber.get());
+	eventLoop.AddReader(feedFds[2], tradesSubscriber.get());
+	eventLoop.AddReader(feedFds[3], inquiriesSubscriber.get());
+	
+	// The books of each venue, which the order router splits execution orders across, are read from their own file
+	unique_ptr<EventListener> venueMarketDataSubscriber(new LineSubscriber<MarketDataConnector<Bond>>(marketDataService.GetConnector()));
+	if (!live) eventLoop.AddReader(open("./input/venuemarketdata.txt", O_RDONLY), venueMarketDataSubscriber.get());
+	
+	// The top of book is written by a slow consumer on its own thread, which takes only the latest book of each
+	// product every 100ms off the conflated listeners
+	atomic<bool> feedsDone(false);
+	thread bookWriter([&marketDataService, &feedsDone]()
+	{
+		while (!feedsDone.load())
+		{
+			this_thread::sleep_for(chrono::milliseconds(100));
+			marketDataService.DrainConflated();
+		}
+	});
+	eventLoop.Run();
+	feedsDone.store(true);
+	bookWriter.join();
+	marketDataService.DrainConflated();
+	
+	// Work sliced parent orders over the next hour on a simulated clock, in 1s steps from where the loop left the wheel,
+	// with limit children (buying the offers at up to 100-16, selling into the bids at down to 99-16), routed across
+	// the venues as a new book of every product on every venue comes in each minute
+	fstream venueStream("./input/venuemarketdata.txt");
+	vector<vector<string>> venueLines = ReadDataStream(venueStream);
+	long venueRoundSize = GetBonds().size() * MARKET_COUNT * 2 * marketDataService.GetOrderBookLevels();
+	long venueLine = 0;
+	long startTime = timerWheel.GetTime();
+	algoExecutionService.SubmitParentOrder(GetBond("91282CAX9"), OFFER, "TWAP1", 10000000, 100.5, TWAP, startTime, 3600000, 12);
+	algoExecutionService.SubmitParentOrder(GetBond("91282CAZ4"), BID, "VWAP1", 10000000, 99.5, VWAP, startTime, 3600000, 13);
+	algoExecutionService.SubmitParentOrder(GetBond("912810SS8"), OFFER, "ICEBERG1", 5000000, 100.5, ICEBERG, startTime, 3600000, 5);
+	for (long now = startTime; now <= startTime + 3600000; now += 1000)
+	{
+		for (long i = 0; (now - startTime) % 60000 == 0 && i < venueRoundSize && !venueLines.empty(); i++)
+			marketDataService.GetConnector()->SubscribeLine(venueLines[venueLine++ % venueLines.size()]);
+		timerWheel.Advance(now);
+	}
+	
+	// End-of-day stress run: parallel shifts, twists and butterflies of up to 100bp, and the day's historical move
+	// from the opening curve to the close, all published to the historical data service
+	vector<double> tenors = curveService.GetData("UST").GetTenors();
+	for (int bp = -100; bp <= 100; bp++)
+	{
+		scenarioService.AddScenario(GetParallelScenario("PARALLEL" + to_string(bp), tenors, bp * 0.0001));
+		scenarioService.AddScenario(GetTwistScenario("TWIST" + to_string(bp), tenors, -bp * 0.0001, bp * 0.0001));
+		scenarioService.AddScenario(GetButterflyScenario("BUTTERFLY" + to_string(bp), tenors, bp * 0.0001, -bp * 0.0001));
+	}
+	scenarioService.AddScenario(GetHistoricalScenario("HISTORICAL", scenarioService.GetOpeningCurve(), curveService.GetData("UST")));
+	scenarioService.RunScenarios();
 	cout << "*********************" << endl;
 	cout << "*** Test complete ***" << endl; 
 	cout << "*********************" << endl;
@@ -0,0 +1,99 @@
+/**
+ * marketdataconverter.cpp
+ * Converts a market data text file into the binary market data wire format.
+ * Usage: marketdataconverter [input text file] [output binary file] [update or snapshot] [# of book levels]
+ *
+ * @author Jordan Wang
+ */
+
+#include "MarketDataMessage.hpp"
+#include "my functions.hpp"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdlib>
+using namespace std;
+
+// Entry of a book being assembled from the text lines of a product
+struct PendingEntry
+{
+	long price;
+	long quantity;
+	int side;
+};
+
+int main(int argc, char* argv[])
+{
+	string inputFile = argc > 1 ? argv[1] : "./input/marketdata.txt";
+	string outputFile = argc > 2 ? argv[2] : "./input/marketdata.bin";
+	bool snapshots = argc > 3 && string(argv[3]) == "snapshot";
+	int orderBookLevels = argc > 4 ? atoi(argv[4]) : 5;
+	const string venueNames[] = { "BROKERTEC", "ESPEED", "CME" };
+
+	fstream data_stream(inputFile);
+	ofstream output(outputFile, ios::binary);
+	if (!data_stream.is_open() || !output.is_open())
+	{
+		cout << "Cannot open " << inputFile << " or " << outputFile << endl;
+		return 1;
+	}
+
+	map<string, unsigned long> sequences;			// a map of {product identifier -> last sequence number}
+	map<string, vector<PendingEntry>> books;		// a map of {product identifier -> entries of the book being assembled}
+	map<string, int> levels[2];						// a map of {product identifier -> next level} per side
+	vector<char> message(MARKET_DATA_MAX_SIZE);
+	long lineCount = 0;
+	long messageCount = 0;
+	long skippedCount = 0;
+
+	string curr_line;
+	while (getline(data_stream, curr_line))
+	{
+		// <product identifier> <price> <quantity> <BID or OFFER> [venue]
+		vector<string> words = ReadDataLine(curr_line);		// split as the connectors read it
+		if (words.empty()) continue;
+		lineCount++;
+
+		long price = words.size() >= 4 ? ParseTickPrice(words[1]) : -1;
+		if (price < 0)
+		{
+			skippedCount++;
+			continue;
+		}
+		string productId = words[0];
+		long quantity = atol(words[2].c_str());
+		int side = (words[3] == "BID") ? 0 : 1;
+		int venue = MARKET_DATA_CONSOLIDATED;
+		for (int i = 0; words.size() > 4 && i < 3; i++)
+			if (words[4] == venueNames[i]) venue = i;
+
+		int size = 0;
+		if (snapshots)
+		{
+			// One snapshot per product every 2 * levels lines of that product
+			vector<PendingEntry>& book = books[productId];
+			book.push_back(PendingEntry{ price, quantity, side });
+			if ((int)book.size() < 2 * orderBookLevels) continue;
+
+			int offset = EncodeBookSnapshot(&message[0], ++sequences[productId], productId, venue, book.size());
+			for (vector<PendingEntry>::iterator it = book.begin(); it != book.end(); it++)
+				offset = EncodeBookSnapshotEntry(&message[0], offset, it->price, it->quantity, it->side);
+			size = offset;
+			book.clear();
+		}
+		else
+		{
+			int& level = levels[side][productId];
+			size = EncodeLevelUpdate(&message[0], ++sequences[productId], productId, side, venue, level, price, quantity);
+			level = (level + 1) % orderBookLevels;
+		}
+		output.write(&message[0], size);
+		messageCount++;
+	}
+
+	cout << "Converted " << lineCount << " lines of " << inputFile << " into " << messageCount << (snapshots ? " snapshots" : " level updates")
+		<< " in " << outputFile << " (" << skippedCount << " lines skipped)" << endl;
+	return 0;
+}
@@ -37,8 +37,10 @@ enum Side 				{ BUY, SELL };
 enum PricingSide 		{ BID, OFFER };
 enum OrderType 			{ FOK, IOC, MARKET, LIMIT, STOP };
 enum Market 			{ BROKERTEC, ESPEED, CME };
+const int MARKET_COUNT = 3;		// # of venues in Market
+enum SlicingStrategy 	{ TWAP, VWAP, ICEBERG };
 enum InquiryState 		{ RECEIVED, QUOTED, DONE, REJECTED, CUSTOMER_REJECTED };
-enum HistoricalDataType { POSITION, RISK, EXECUTION, STREAMING, INQUIRY };
+enum HistoricalDataType { POSITION, RISK, EXECUTION, STREAMING, INQUIRY, SCENARIO, LADDER, ORDER_BOOK, VAR };
 
 
 
@@ -163,7 +165,6 @@ vector<string> GetExecutionOrder_eo2s(T product, PricingSide side, string orderI
 
 
 // Convert price stream order data -> vector<string> format
-template<typename T>
 vector<string> GetPriceStreamOrder_pso2s(double price, long visibleQuantity, long hiddenQuantity, PricingSide side)
 {
 	vector<string> res;
@@ -193,6 +194,46 @@ vector<string> GetPriceStream_ps2s(T product, vector<string> bidOrder, vector<st
 
 
 
+// Convert inquiry data -> vector<string> format
+template<typename T>
+vector<string> GetInquiry_i2s(T product, string inquiryId, Side side, long quantity, double price, InquiryState state)
+{
+	string stateName;
+	if (state == RECEIVED) stateName = "RECEIVED";
+	if (state == QUOTED) stateName = "QUOTED";
+	if (state == DONE) stateName = "DONE";
+	if (state == REJECTED) stateName = "REJECTED";
+	if (state == CUSTOMER_REJECTED) stateName = "CUSTOMER_REJECTED";
+	
+	vector<string> res;
+	res.push_back(inquiryId);									// Append inquiryId
+	res.push_back(product.GetProductId());						// Append productId
+	res.push_back((side == BUY) ? "BUY" : "SELL");				// Append side
+	res.push_back(to_string(quantity));							// Append quantity
+	res.push_back(GetPrice_d2s(price));							// Append price
+	res.push_back(stateName);									// Append state
+	return res;
+}
+
+
+
+
+// Convert top of book data -> vector<string> format
+template<typename T>
+vector<string> GetOrderBook_ob2s(T product, double bidPrice, long bidQuantity, double offerPrice, long offerQuantity)
+{
+	vector<string> res;
+	res.push_back(product.GetProductId());						// Append productId
+	res.push_back(GetPrice_d2s(bidPrice));						// Append bid price
+	res.push_back(to_string(bidQuantity));						// Append bid quantity
+	res.push_back(GetPrice_d2s(offerPrice));					// Append offer price
+	res.push_back(to_string(offerQuantity));					// Append offer quantity
+	return res;
+}
+
+
+
+
 // Search bonds by CUSIP
 Bond GetBond(string _cusip)
 {
@@ -209,6 +250,41 @@ Bond GetBond(string _cusip)
 
 
 
+// Get all the bonds in the registry behind GetBond
+vector<Bond> GetBonds()
+{
+	vector<string> cusips = { "91282CAX9", "91282CBA8", "91282CAZ4", "91282CAY7", "91282CAV3", "912810ST6", "912810SS8" };
+	vector<Bond> res;
+	for (vector<string>::iterator it = cusips.begin(); it != cusips.end(); it++)
+		res.push_back(GetBond(*it));
+	return res;
+}
+
+
+
+
+// Search market by venue name
+Market GetMarket(string _venue)
+{
+	if (_venue == "ESPEED") return ESPEED;
+	if (_venue == "CME") return CME;
+	return BROKERTEC;
+}
+
+
+
+
+// Get the venue name of a market
+string GetMarket_m2s(Market _market)
+{
+	if (_market == ESPEED) return "ESPEED";
+	if (_market == CME) return "CME";
+	return "BROKERTEC";
+}
+
+
+
+
 // Search PV01 value by CUSIP
 double GetPV01(string _cusip)
 {
@@ -225,6 +301,23 @@ double GetPV01(string _cusip)
 
 
 
+// Read the words of one line of data
+vector<string> ReadDataLine(const string& curr_line)
+{
+	stringstream line_stream(curr_line);
+	string curr_word;
+	vector<string> curr_line_of_words;
+	while (getline(line_stream, curr_word, ' '))		// get each word from the line stream
+	{
+		trim(curr_word);								// trim off blanks
+		curr_line_of_words.push_back(curr_word);
+	}
+	return curr_line_of_words;
+}
+
+
+
+
 // Read data from an input stream
 vector<vector<string>> ReadDataStream(fstream& data_stream)
 {
@@ -232,17 +325,7 @@ vector<vector<string>> ReadDataStream(fstream& data_stream)
 	
 	string curr_line;
 	while (getline(data_stream, curr_line))				// get each line from data stream
-	{
-		stringstream line_stream(curr_line);
-		string curr_word;
-		vector<string> curr_line_of_words;
-		while (getline(line_stream, curr_word, ' '))	// get each word from the line stream
-		{
-			trim(curr_word);							// trim off blanks
-			curr_line_of_words.push_back(curr_word);
-		}
-		res.push_back(curr_line_of_words);
-	}
+		res.push_back(ReadDataLine(curr_line));
 	
 	return res;
 }
@@ -251,7 +334,6 @@ vector<vector<string>> ReadDataStream(fstream& data_stream)
 
 
 // Output data to an output stream
-template<typename T>
 void OutputDataStream(string fileName, vector<string> data)
 {
 	fstream file;
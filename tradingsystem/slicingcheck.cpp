@@ -0,0 +1,80 @@
+/**
+ * slicingcheck.cpp
+ * Checks the slicing of parent orders by AlgoExecutionService on a simulated clock, including parents smaller
+ * than their # of slices, which send nothing on some slices and must still run out on schedule.
+ * Usage: slicingcheck
+ *
+ * @author Jordan Wang
+ */
+
+#include "soa.hpp"
+#include "products.hpp"
+#include "my functions.hpp"
+#include "BondExecutionService.hpp"
+#include "TimerWheel.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+using namespace std;
+
+// Listener adding up the child orders of each parent
+struct ChildCounter : public ServiceListener<AlgoExecution<Bond>>
+{
+	map<string, long> childCounts;			// a map of {parent order identifier -> # of child orders}
+	map<string, long> childQuantities;		// a map of {parent order identifier -> quantity sent}
+
+	void ProcessAdd(AlgoExecution<Bond>& _data)
+	{
+		ExecutionOrder<Bond>* order = _data.GetExecutionOrder();
+		childCounts[order->GetParentOrderId()]++;
+		childQuantities[order->GetParentOrderId()] += order->GetVisibleQuantity() + order->GetHiddenQuantity();
+	}
+
+	void ProcessRemove(AlgoExecution<Bond>& _data) {}
+
+	void ProcessUpdate(AlgoExecution<Bond>& _data) {}
+};
+
+// Work a parent order unfilled over twice its schedule, and check what it sent and that it expired on time
+bool CheckParent(SlicingStrategy strategy, string parentOrderId, long quantity, long duration, int sliceCount)
+{
+	TimerWheel timerWheel(1, 1 << 12, 0);
+	AlgoExecutionService<Bond> algoExecutionService;
+	ChildCounter counter;
+	algoExecutionService.SetTimerWheel(&timerWheel);
+	algoExecutionService.AddListener(&counter);
+	if (!algoExecutionService.SubmitParentOrder(GetBond("91282CAX9"), BID, parentOrderId, quantity, 0.0, strategy, 0, duration, sliceCount))
+	{
+		cout << parentOrderId << ": rejected" << endl;
+		return false;
+	}
+
+	// Past the schedule (and the tick a timer due at the current time waits for), an expired parent has no timer left to fire
+	long lateFirings = 0;
+	for (long now = 1; now <= 2 * duration; now++)
+	{
+		int fired = timerWheel.Advance(now);
+		if (now > duration + 1) lateFirings += fired;
+	}
+
+	long childCount = counter.childCounts[parentOrderId];
+	long sentQuantity = counter.childQuantities[parentOrderId];
+	bool passed = sentQuantity == quantity && childCount <= sliceCount && lateFirings == 0
+		&& algoExecutionService.GetParentOrderState(parentOrderId) == nullptr && algoExecutionService.GetExpiredParentCount() == 1;
+	cout << parentOrderId << ": " << childCount << " children, " << sentQuantity << " of " << quantity << " sent, "
+		<< lateFirings << " timers past the schedule, " << (passed ? "expired on schedule" : "FAILED") << endl;
+	return passed;
+}
+
+int main(int argc, char* argv[])
+{
+	bool passed = true;
+	passed &= CheckParent(TWAP, "TWAP", 10000000, 1000, 12);
+	passed &= CheckParent(VWAP, "VWAP", 10000000, 1000, 13);
+	passed &= CheckParent(TWAP, "SMALLTWAP", 3, 1000, 10);
+	passed &= CheckParent(VWAP, "SMALLVWAP", 3, 1000, 10);
+	passed &= CheckParent(TWAP, "ONETWAP", 1, 1000, 1000);
+	cout << (passed ? "All parent orders sliced as scheduled" : "Some parent orders were not sliced as scheduled") << endl;
+	return passed ? 0 : 1;
+}